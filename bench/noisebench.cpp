@@ -0,0 +1,837 @@
+/*
+MIT License
+
+Copyright (c) 2016 Gaetan Guidet
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Noise kernels micro-benchmark.
+//
+// Measures ns/sample and samples/s of the noise kernels, the fBm
+// specializations and the Voronoi cell search over coherent (scanline) and
+// incoherent (random) point streams, and writes the results as JSON.
+//
+// Usage: noisebench [options]
+//   -samples <n>      number of points per stream (default 262144)
+//   -repeat <n>       runs per measurement, the fastest is kept (default 5)
+//   -octaves <list>   comma separated fBm octave counts (default 1,4,8)
+//   -filter <str>     only run kernels whose name contains str
+//   -output <path>    JSON output path (default stdout)
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "kernels/fbm.h"
+#include "kernels/fractal.h"
+#include "kernels/voronoi.h"
+#include "kernels/distort_point.h"
+#include "kernels/curl_noise.h"
+#include "stegu/sdnoise1234.h"
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <sys/time.h>
+#endif
+
+// Timer
+
+class Timer
+{
+public:
+   
+   Timer()
+   {
+      start();
+   }
+   
+   void start()
+   {
+      _start = now();
+   }
+   
+   // in seconds
+   double elapsed() const
+   {
+      return now() - _start;
+   }
+   
+private:
+   
+   static double now()
+   {
+#ifdef _WIN32
+      LARGE_INTEGER freq, count;
+      QueryPerformanceFrequency(&freq);
+      QueryPerformanceCounter(&count);
+      return double(count.QuadPart) / double(freq.QuadPart);
+#else
+      struct timeval tv;
+      gettimeofday(&tv, NULL);
+      return double(tv.tv_sec) + 1.0e-6 * double(tv.tv_usec);
+#endif
+   }
+   
+   double _start;
+};
+
+// Point streams
+
+struct Stream
+{
+   std::string name;
+   std::vector<float> x;
+   std::vector<float> y;
+   std::vector<float> z;
+};
+
+// Scanlines over a regular grid, consecutive points are close to each
+// other, as for neighbouring camera rays
+void MakeCoherentStream(size_t n, Stream &s)
+{
+   size_t width = 1;
+   while (width * width < n)
+   {
+      ++width;
+   }
+   
+   s.name = "coherent";
+   s.x.resize(n);
+   s.y.resize(n);
+   s.z.resize(n);
+   
+   for (size_t i=0; i<n; ++i)
+   {
+      s.x[i] = 0.01f * float(i % width);
+      s.y[i] = 0.01f * float(i / width);
+      s.z[i] = 0.5f;
+   }
+}
+
+// Uniformly distributed points in [-100, 100]^3 from a fixed seed
+void MakeIncoherentStream(size_t n, Stream &s)
+{
+   unsigned int state = 0x12345678u;
+   
+   s.name = "incoherent";
+   s.x.resize(n);
+   s.y.resize(n);
+   s.z.resize(n);
+   
+   for (size_t i=0; i<n; ++i)
+   {
+      float *c[3] = {&s.x[i], &s.y[i], &s.z[i]};
+      for (int j=0; j<3; ++j)
+      {
+         state = state * 1664525u + 1013904223u;
+         *(c[j]) = 200.0f * (float(state >> 8) / 16777216.0f) - 100.0f;
+      }
+   }
+}
+
+// Kernels
+//
+// Each kernel provides run(stream) that evaluates all the points and returns
+// the sum of the values so that the compiler can't discard the evaluation.
+// PointKernel implements it for kernels evaluating one point at a time.
+
+template <typename Derived>
+struct PointKernel
+{
+   float run(const Stream &s)
+   {
+      Derived &kernel = static_cast<Derived&>(*this);
+      float sum = 0.0f;
+      for (size_t i=0; i<s.x.size(); ++i)
+      {
+         sum += kernel.eval(s.x[i], s.y[i], s.z[i]);
+      }
+      return sum;
+   }
+};
+
+struct ValueCoherentKernel : public PointKernel<ValueCoherentKernel>
+{
+   noise::NoiseQuality quality;
+   
+   ValueCoherentKernel(noise::NoiseQuality q) : quality(q) {}
+   
+   inline float eval(float x, float y, float z)
+   {
+      return float(noise::ValueCoherentNoise3D(x, y, z, 0, quality));
+   }
+};
+
+struct GradientCoherentKernel : public PointKernel<GradientCoherentKernel>
+{
+   noise::NoiseQuality quality;
+   
+   GradientCoherentKernel(noise::NoiseQuality q) : quality(q) {}
+   
+   inline float eval(float x, float y, float z)
+   {
+      return float(noise::GradientCoherentNoise3D(x, y, z, 0, quality));
+   }
+};
+
+template <noise::NoiseQuality Q>
+struct ValueCoherentFKernel : public PointKernel< ValueCoherentFKernel<Q> >
+{
+   inline float eval(float x, float y, float z)
+   {
+      return noise::ValueCoherentNoise3DF<Q>(x, y, z, 0);
+   }
+};
+
+template <noise::NoiseQuality Q>
+struct GradientCoherentFKernel : public PointKernel< GradientCoherentFKernel<Q> >
+{
+   inline float eval(float x, float y, float z)
+   {
+      return noise::GradientCoherentNoise3DF<Q>(x, y, z, 0);
+   }
+};
+
+struct SimplexKernel : public PointKernel<SimplexKernel>
+{
+   inline float eval(float x, float y, float z)
+   {
+      return SimplexNoise1234::noise(x, y, z);
+   }
+};
+
+struct SimplexBatchKernel
+{
+   std::vector<float> out;
+   
+   float run(const Stream &s)
+   {
+      size_t n = s.x.size();
+      out.resize(n);
+      SimplexNoise1234::noise(int(n), &s.x[0], &s.y[0], &s.z[0], &out[0]);
+      float sum = 0.0f;
+      for (size_t i=0; i<n; ++i)
+      {
+         sum += out[i];
+      }
+      return sum;
+   }
+};
+
+struct SRDNoise3Kernel : public PointKernel<SRDNoise3Kernel>
+{
+   inline float eval(float x, float y, float z)
+   {
+      float dx, dy, dz;
+      return srdnoise3(x, y, z, 0.0f, &dx, &dy, &dz);
+   }
+};
+
+struct SDNoise3Kernel : public PointKernel<SDNoise3Kernel>
+{
+   inline float eval(float x, float y, float z)
+   {
+      float dx, dy, dz;
+      return sdnoise3(x, y, z, &dx, &dy, &dz);
+   }
+};
+
+struct SDNoise3x3Kernel : public PointKernel<SDNoise3x3Kernel>
+{
+   inline float eval(float x, float y, float z)
+   {
+      float n[3], dn[9];
+      sdnoise3x3(x, y, z, SimplexNoise1234::permutation(), n, dn);
+      return n[0] + n[1] + n[2] + dn[0] + dn[4] + dn[8];
+   }
+};
+
+// fBm parameters use the fractal shader defaults
+
+template <typename TNoise>
+void SetupNoise(typename TNoise::Params &)
+{
+}
+template <>
+void SetupNoise<ValueNoise>(ValueNoise::Params &params)
+{
+   params.seed = 0;
+   params.quality = NQ_std;
+}
+template <>
+void SetupNoise<PerlinNoise>(PerlinNoise::Params &params)
+{
+   params.seed = 0;
+   params.quality = NQ_std;
+}
+template <>
+void SetupNoise<FlowNoise>(FlowNoise::Params &params)
+{
+   params.power = 0.25f;
+   params.t = 0.0f;
+}
+
+template <typename TModifier>
+void SetupModifier(typename TModifier::Params &)
+{
+}
+template <>
+void SetupModifier<TurbulenceModifier>(TurbulenceModifier::Params &params)
+{
+   params.offset = -0.5f;
+   params.scale = 2.0f;
+}
+template <>
+void SetupModifier<RidgeModifier>(RidgeModifier::Params &params)
+{
+   params.offset = 1.0f;
+   params.gain = 2.0f;
+   params.exponent = 0.0f;
+}
+template <>
+void SetupModifier< CombineModifier<TurbulenceModifier, RidgeModifier> >(CombineModifier<TurbulenceModifier, RidgeModifier>::Params &params)
+{
+   SetupModifier<TurbulenceModifier>(params.mod1);
+   SetupModifier<RidgeModifier>(params.mod2);
+}
+
+template <typename TNoise, typename TModifier>
+struct fBmKernel : public PointKernel< fBmKernel<TNoise, TModifier> >
+{
+   fBm<TNoise, TModifier> fbm;
+   
+   fBmKernel(int octaves)
+      : fbm(octaves, 1.0f, 0.5f, 1.0f, 2.0f)
+   {
+      SetupNoise<TNoise>(fbm.noise_params);
+      SetupModifier<TModifier>(fbm.modifier_params);
+      fbm.prepare();
+   }
+   
+   inline float eval(float x, float y, float z)
+   {
+      return fbm.eval(Vec3(x, y, z));
+   }
+};
+
+// Same as fBmKernel along with the gradient (fractal_bump), returns the sum
+// of the value and the gradient components
+template <typename TNoise, typename TModifier>
+struct fBmGradientKernel : public PointKernel< fBmGradientKernel<TNoise, TModifier> >
+{
+   fBm<TNoise, TModifier> fbm;
+   
+   fBmGradientKernel(int octaves)
+      : fbm(octaves, 1.0f, 0.5f, 1.0f, 2.0f)
+   {
+      SetupNoise<TNoise>(fbm.noise_params);
+      SetupModifier<TModifier>(fbm.modifier_params);
+      fbm.prepare();
+   }
+   
+   inline float eval(float x, float y, float z)
+   {
+      Vec3 grad;
+      float rv = fbm.eval(Vec3(x, y, z), grad);
+      return rv + grad.x + grad.y + grad.z;
+   }
+};
+
+// Same as fBmKernel through the batch entry point
+template <typename TNoise, typename TModifier>
+struct fBmBatchKernel
+{
+   fBm<TNoise, TModifier> fbm;
+   std::vector<float> out;
+   
+   fBmBatchKernel(int octaves)
+      : fbm(octaves, 1.0f, 0.5f, 1.0f, 2.0f)
+   {
+      SetupNoise<TNoise>(fbm.noise_params);
+      SetupModifier<TModifier>(fbm.modifier_params);
+      fbm.prepare();
+   }
+   
+   float run(const Stream &s)
+   {
+      size_t n = s.x.size();
+      out.resize(n);
+      fbm.eval(n, &s.x[0], &s.y[0], &s.z[0], &out[0]);
+      float sum = 0.0f;
+      for (size_t i=0; i<n; ++i)
+      {
+         sum += out[i];
+      }
+      return sum;
+   }
+};
+
+template <typename Metric, typename TCells>
+struct VoronoiKernel : public PointKernel< VoronoiKernel<Metric, TCells> >
+{
+   int count;
+   TCells *cells;
+   
+   VoronoiKernel(int c)
+      : count(c), cells(new TCells())
+   {
+   }
+   
+   ~VoronoiKernel()
+   {
+      delete cells;
+   }
+   
+   inline float eval(float x, float y, float z)
+   {
+      Vec3 P(x, y, z);
+      Vec3 Pf[4] = {P, P, P, P};
+      float f[4] = {2147483647.0f, 2147483647.0f, 2147483647.0f, 2147483647.0f};
+      FindFeatures<Metric>(*cells, P, 0, Pf, f);
+      return f[count - 1];
+   }
+   
+private:
+   
+   VoronoiKernel(const VoronoiKernel&);
+   VoronoiKernel& operator=(const VoronoiKernel&);
+};
+
+// Vector kernels return the sum of the components
+
+struct DistortPointKernel : public PointKernel<DistortPointKernel>
+{
+   fBm3<SimplexNoise> fbm;
+   DistortPointValues values;
+   
+   DistortPointKernel(int octaves)
+      : fbm(octaves, 1.0f, 0.5f, 1.0f, 2.0f)
+   {
+      values.power = 1.0f;
+      values.filter_width = 0.0f;
+      fbm.prepare();
+   }
+   
+   inline float eval(float x, float y, float z)
+   {
+      Vec3 P = DistortPoint(fbm, values, Vec3(x, y, z));
+      return P.x + P.y + P.z;
+   }
+};
+
+struct CurlNoiseKernel : public PointKernel<CurlNoiseKernel>
+{
+   CurlfBm fbm;
+   
+   CurlNoiseKernel(int octaves)
+      : fbm(octaves, 1.0f, 0.5f, 1.0f, 2.0f)
+   {
+      fbm.prepare();
+   }
+   
+   inline float eval(float x, float y, float z)
+   {
+      Vec3 curl = fbm.eval(Vec3(x, y, z), false);
+      return curl.x + curl.y + curl.z;
+   }
+};
+
+// Shades each point at several motion blur time samples of a slow
+// deformation, evaluating all of them or reusing the first one (see
+// FractalSampleReuse)
+
+static const int MotionTimeSamples = 4;
+
+template <bool Reuse>
+struct MotionSamplesKernel : public PointKernel< MotionSamplesKernel<Reuse> >
+{
+   FractalValues values;
+   FractalEvaluator *evaluator;
+   FractalSampleReuse reuse;
+   float distance;
+   
+   MotionSamplesKernel(NoiseType type, int octaves)
+      : evaluator(CreateEvaluator(type, 0))
+   {
+      memset(&values, 0, sizeof(values));
+      values.amplitude = 1.0f;
+      values.frequency = 1.0f;
+      values.octaves = float(octaves);
+      values.persistence = 0.5f;
+      values.lacunarity = 2.0f;
+      values.dampen_output = true;
+      evaluator->setup(values);
+      distance = ReuseDistance(values, FRACTAL_REUSE_DEFAULT_DISTANCE);
+   }
+   
+   ~MotionSamplesKernel()
+   {
+      delete evaluator;
+   }
+   
+   inline float eval(float x, float y, float z)
+   {
+      // the point's identity only needs to differ from the previous one
+      ShadingPointKey key = {this, 0, x, y, 0, 0, 0};
+      float sum = 0.0f;
+      bool reused = false;
+      
+      for (int t=0; t<MotionTimeSamples; ++t)
+      {
+         Vec3 P(x + 0.25f * distance * float(t), y, z);
+         float time = float(t) / float(MotionTimeSamples - 1);
+         sum += (Reuse ? reuse.eval(evaluator, key, time, P, distance, reused) : evaluator->eval(P, 0.0f));
+      }
+      
+      return sum;
+   }
+   
+private:
+   
+   MotionSamplesKernel(const MotionSamplesKernel&);
+   MotionSamplesKernel& operator=(const MotionSamplesKernel&);
+};
+
+// Benchmark driver
+
+struct Options
+{
+   size_t samples;
+   int repeat;
+   std::vector<int> octaves;
+   std::string filter;
+   std::string output;
+};
+
+struct Result
+{
+   std::string kernel;
+   std::string stream;
+   int octaves;
+   double nsPerSample;
+   double samplesPerSecond;
+};
+
+static volatile float gSink = 0.0f;
+
+class Benchmark
+{
+public:
+   
+   Benchmark(const Options &opts, const std::vector<Stream> &streams)
+      : _opts(opts), _streams(streams)
+   {
+   }
+   
+   // octaves is 0 for kernels without octaves
+   template <typename Kernel>
+   void run(const std::string &name, int octaves, Kernel &kernel)
+   {
+      if (_opts.filter.length() > 0 && name.find(_opts.filter) == std::string::npos)
+      {
+         return;
+      }
+      
+      for (size_t i=0; i<_streams.size(); ++i)
+      {
+         const Stream &s = _streams[i];
+         double best = -1.0;
+         
+         // warm up caches and lazily initialized dispatch
+         gSink = gSink + kernel.run(s);
+         
+         for (int r=0; r<_opts.repeat; ++r)
+         {
+            Timer timer;
+            float sum = kernel.run(s);
+            double t = timer.elapsed();
+            gSink = gSink + sum;
+            if (best < 0.0 || t < best)
+            {
+               best = t;
+            }
+         }
+         
+         Result result;
+         result.kernel = name;
+         result.stream = s.name;
+         result.octaves = octaves;
+         result.nsPerSample = 1.0e9 * best / double(s.x.size());
+         result.samplesPerSecond = (best > 0.0 ? double(s.x.size()) / best : 0.0);
+         _results.push_back(result);
+         
+         fprintf(stderr, "%-40s %-10s %2d octave(s): %10.2f ns/sample\n", name.c_str(), s.name.c_str(), octaves, result.nsPerSample);
+      }
+   }
+   
+   const std::vector<Result>& results() const
+   {
+      return _results;
+   }
+   
+private:
+   
+   const Options &_opts;
+   const std::vector<Stream> &_streams;
+   std::vector<Result> _results;
+};
+
+template <typename TNoise, typename TModifier>
+void RunfBm(Benchmark &bench, const Options &opts, const std::string &name)
+{
+   for (size_t i=0; i<opts.octaves.size(); ++i)
+   {
+      fBmKernel<TNoise, TModifier> kernel(opts.octaves[i]);
+      bench.run(name, opts.octaves[i], kernel);
+   }
+}
+
+template <typename TNoise>
+void RunfBm(Benchmark &bench, const Options &opts, const std::string &noiseName)
+{
+   RunfBm<TNoise, DefaultModifier>(bench, opts, "fbm/" + noiseName + "/default");
+   RunfBm<TNoise, TurbulenceModifier>(bench, opts, "fbm/" + noiseName + "/turbulence");
+   RunfBm<TNoise, RidgeModifier>(bench, opts, "fbm/" + noiseName + "/ridge");
+   RunfBm<TNoise, CombineModifier<TurbulenceModifier, RidgeModifier> >(bench, opts, "fbm/" + noiseName + "/turbulence+ridge");
+   
+   for (size_t i=0; i<opts.octaves.size(); ++i)
+   {
+      fBmBatchKernel<TNoise, DefaultModifier> kernel(opts.octaves[i]);
+      bench.run("fbm/" + noiseName + "/default_batch", opts.octaves[i], kernel);
+      fBmGradientKernel<TNoise, DefaultModifier> gradKernel(opts.octaves[i]);
+      bench.run("fbm/" + noiseName + "/default_gradient", opts.octaves[i], gradKernel);
+   }
+}
+
+template <typename Metric>
+void RunVoronoi(Benchmark &bench, const std::string &metricName)
+{
+   static const char *FeatureNames[] = {"f1", "f2", "f3", "f4"};
+   
+   // with and without the feature cache, which only helps coherent streams
+   for (int count=1; count<=4; ++count)
+   {
+      VoronoiKernel<Metric, FeaturePoints> kernel(count);
+      bench.run("voronoi/" + metricName + "/" + FeatureNames[count - 1], 0, kernel);
+      VoronoiKernel<Metric, FeatureCache> cachedKernel(count);
+      bench.run("voronoi/" + metricName + "/" + FeatureNames[count - 1] + "_cached", 0, cachedKernel);
+   }
+}
+
+void RunAll(Benchmark &bench, const Options &opts)
+{
+   static const NoiseType NoiseTypes[] = {NT_value, NT_perlin, NT_simplex, NT_flow, NT_simplex4d};
+   static const char *NoiseTypeNames[] = {"value", "perlin", "simplex", "flow", "simplex4d"};
+   static const noise::NoiseQuality Qualities[] = {noise::QUALITY_FAST, noise::QUALITY_STD, noise::QUALITY_BEST};
+   static const char *QualityNames[] = {"fast", "std", "best"};
+   
+   for (int q=0; q<3; ++q)
+   {
+      ValueCoherentKernel vk(Qualities[q]);
+      bench.run(std::string("libnoise/value/") + QualityNames[q], 0, vk);
+      
+      GradientCoherentKernel gk(Qualities[q]);
+      bench.run(std::string("libnoise/gradient/") + QualityNames[q], 0, gk);
+   }
+   
+   ValueCoherentFKernel<noise::QUALITY_FAST> vfk0;
+   bench.run("libnoise/value_f/fast", 0, vfk0);
+   ValueCoherentFKernel<noise::QUALITY_STD> vfk1;
+   bench.run("libnoise/value_f/std", 0, vfk1);
+   ValueCoherentFKernel<noise::QUALITY_BEST> vfk2;
+   bench.run("libnoise/value_f/best", 0, vfk2);
+   
+   GradientCoherentFKernel<noise::QUALITY_FAST> gfk0;
+   bench.run("libnoise/gradient_f/fast", 0, gfk0);
+   GradientCoherentFKernel<noise::QUALITY_STD> gfk1;
+   bench.run("libnoise/gradient_f/std", 0, gfk1);
+   GradientCoherentFKernel<noise::QUALITY_BEST> gfk2;
+   bench.run("libnoise/gradient_f/best", 0, gfk2);
+   
+   SimplexKernel sk;
+   bench.run("stegu/simplex", 0, sk);
+   SimplexBatchKernel sbk;
+   bench.run("stegu/simplex_batch", 0, sbk);
+   SRDNoise3Kernel srdk;
+   bench.run("stegu/srdnoise3", 0, srdk);
+   SDNoise3Kernel sdk;
+   bench.run("stegu/sdnoise3", 0, sdk);
+   SDNoise3x3Kernel sd3k;
+   bench.run("stegu/sdnoise3x3", 0, sd3k);
+   
+   RunfBm<ValueNoise>(bench, opts, "value");
+   RunfBm<PerlinNoise>(bench, opts, "perlin");
+   RunfBm<SimplexNoise>(bench, opts, "simplex");
+   RunfBm<FlowNoise>(bench, opts, "flow");
+   RunfBm<Simplex4DNoise>(bench, opts, "simplex4d");
+   
+   for (size_t i=0; i<opts.octaves.size(); ++i)
+   {
+      DistortPointKernel dk(opts.octaves[i]);
+      bench.run("distort_point/simplex", opts.octaves[i], dk);
+      CurlNoiseKernel ck(opts.octaves[i]);
+      bench.run("curl_noise", opts.octaves[i], ck);
+      
+      for (int t=0; t<5; ++t)
+      {
+         std::string prefix = std::string("fractal/") + NoiseTypeNames[t];
+         MotionSamplesKernel<false> mk(NoiseTypes[t], opts.octaves[i]);
+         bench.run(prefix + "/motion_samples", opts.octaves[i], mk);
+         MotionSamplesKernel<true> mrk(NoiseTypes[t], opts.octaves[i]);
+         bench.run(prefix + "/motion_reuse", opts.octaves[i], mrk);
+      }
+   }
+   
+   RunVoronoi<EuclidianMetric>(bench, "euclidian");
+   RunVoronoi<ManhattanMetric>(bench, "manhattan");
+   RunVoronoi<ChebyshevMetric>(bench, "chebyshev");
+}
+
+void WriteJSON(FILE *f, const Options &opts, const std::vector<Result> &results)
+{
+   fprintf(f, "{\n");
+   fprintf(f, "  \"samples\": %lu,\n", (unsigned long) opts.samples);
+   fprintf(f, "  \"repeat\": %d,\n", opts.repeat);
+   fprintf(f, "  \"results\": [");
+   for (size_t i=0; i<results.size(); ++i)
+   {
+      const Result &r = results[i];
+      fprintf(f, "%s\n    {\"kernel\": \"%s\", \"stream\": \"%s\", \"octaves\": %d, \"ns_per_sample\": %.4f, \"samples_per_second\": %.1f}",
+              (i > 0 ? "," : ""), r.kernel.c_str(), r.stream.c_str(), r.octaves, r.nsPerSample, r.samplesPerSecond);
+   }
+   fprintf(f, "\n  ]\n}\n");
+}
+
+void Usage()
+{
+   fprintf(stderr, "Usage: noisebench [-samples n] [-repeat n] [-octaves 1,4,8] [-filter str] [-output path]\n");
+}
+
+bool ParseOctaves(const char *str, std::vector<int> &octaves)
+{
+   octaves.clear();
+   
+   while (*str != '\0')
+   {
+      char *end = 0;
+      long o = strtol(str, &end, 10);
+      if (end == str || o <= 0)
+      {
+         return false;
+      }
+      octaves.push_back(int(o));
+      str = end;
+      if (*str == ',')
+      {
+         ++str;
+      }
+      else if (*str != '\0')
+      {
+         return false;
+      }
+   }
+   
+   return (octaves.size() > 0);
+}
+
+int main(int argc, char **argv)
+{
+   Options opts;
+   opts.samples = 262144;
+   opts.repeat = 5;
+   opts.octaves.push_back(1);
+   opts.octaves.push_back(4);
+   opts.octaves.push_back(8);
+   
+   for (int i=1; i<argc; ++i)
+   {
+      bool hasValue = (i + 1 < argc);
+      
+      if (!strcmp(argv[i], "-samples") && hasValue)
+      {
+         long n = atol(argv[++i]);
+         if (n <= 0)
+         {
+            Usage();
+            return 1;
+         }
+         opts.samples = size_t(n);
+      }
+      else if (!strcmp(argv[i], "-repeat") && hasValue)
+      {
+         opts.repeat = atoi(argv[++i]);
+         if (opts.repeat <= 0)
+         {
+            Usage();
+            return 1;
+         }
+      }
+      else if (!strcmp(argv[i], "-octaves") && hasValue)
+      {
+         if (!ParseOctaves(argv[++i], opts.octaves))
+         {
+            Usage();
+            return 1;
+         }
+      }
+      else if (!strcmp(argv[i], "-filter") && hasValue)
+      {
+         opts.filter = argv[++i];
+      }
+      else if (!strcmp(argv[i], "-output") && hasValue)
+      {
+         opts.output = argv[++i];
+      }
+      else
+      {
+         Usage();
+         return 1;
+      }
+   }
+   
+   std::vector<Stream> streams(2);
+   MakeCoherentStream(opts.samples, streams[0]);
+   MakeIncoherentStream(opts.samples, streams[1]);
+   
+   Benchmark bench(opts, streams);
+   RunAll(bench, opts);
+   
+   FILE *f = stdout;
+   if (opts.output.length() > 0)
+   {
+      f = fopen(opts.output.c_str(), "w");
+      if (!f)
+      {
+         fprintf(stderr, "Could not open '%s' for writing\n", opts.output.c_str());
+         return 1;
+      }
+   }
+   
+   WriteJSON(f, opts, bench.results());
+   
+   if (f != stdout)
+   {
+      fclose(f);
+   }
+   
+   return 0;
+}
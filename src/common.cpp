@@ -23,10 +23,18 @@ SOFTWARE.
 */
 
 #include "common.h"
+#include "kernels/atomic.h"
+#include <cstdio>
+#include <cstring>
+#include <set>
 
 namespace SSTR
 {
    extern AtString Pref;
+   extern AtString simplex_seed;
+   extern AtString flow_seed;
+   extern AtString noise_stats;
+   extern AtString noise_stats_file;
 }
 
 const char* NoiseQualityNames[] = 
@@ -37,6 +45,13 @@ const char* NoiseQualityNames[] =
    NULL
 };
 
+const char* NoiseHashNames[] = 
+{
+   "legacy",
+   "xxhash",
+   NULL
+};
+
 const char* InputNames[] =
 {
    "P",
@@ -52,9 +67,56 @@ const char* NoiseTypeNames[] =
    "perlin",
    "simplex",
    "flow",
+   "simplex4d",
    NULL
 };
 
+// Shapes without Pref user data.
+//
+// The first sample of such a shape warns and records it, later ones find it
+// in their thread's small direct mapped cache and skip the user data lookup.
+// The shared set is only used when a thread first meets a shape.
+
+#define MISSING_PREF_CACHE_SIZE 16
+
+struct MissingPrefCache
+{
+   const AtNode *shapes[MISSING_PREF_CACHE_SIZE];
+   
+   inline const AtNode*& slot(const AtNode *shape)
+   {
+      size_t h = size_t(shape) / sizeof(void*);
+      return shapes[(h ^ (h >> 4)) % MISSING_PREF_CACHE_SIZE];
+   }
+};
+
+static SpinLock gMissingPrefLock;
+static std::set<const AtNode*> gMissingPref;
+static MissingPrefCache gMissingPrefCaches[AI_MAX_THREADS];
+
+static void AddMissingPref(AtShaderGlobals *sg)
+{
+   bool added = false;
+   {
+      ScopedSpinLock guard(gMissingPrefLock);
+      added = gMissingPref.insert(sg->Op).second;
+   }
+   
+   if (added)
+   {
+      AiMsgWarning("[noise] %s: Pref not defined, defaults to P", (sg->Op ? AiNodeGetName(sg->Op) : "<unknown>"));
+   }
+   
+   gMissingPrefCaches[sg->tid].slot(sg->Op) = sg->Op;
+}
+
+void ResetMissingPref()
+{
+   ScopedSpinLock guard(gMissingPrefLock);
+   gMissingPref.clear();
+   memset(gMissingPrefCaches, 0, sizeof(gMissingPrefCaches));
+}
+
 AtVector GetInput(Input which, AtShaderGlobals *sg, AtNode *)
 {
    AtVector P;
@@ -68,9 +130,13 @@ AtVector GetInput(Input which, AtShaderGlobals *sg, AtNode *)
       P = sg->Po;
       break;
    case I_Pref:
-      if (!AiUDataGetVec(SSTR::Pref, P))
+      if (sg->Op != 0 && gMissingPrefCaches[sg->tid].slot(sg->Op) == sg->Op)
       {
-         AiMsgWarning("Pref node defined, defaults to P");
+         P = sg->P;
+      }
+      else if (!AiUDataGetVec(SSTR::Pref, P))
+      {
+         AddMissingPref(sg);
          P = sg->P;
       }
       break;
@@ -87,3 +153,163 @@ AtVector GetInput(Input which, AtShaderGlobals *sg, AtNode *)
    
    return P;
 }
+
+float GetInputFilterWidth(Input which, AtShaderGlobals *sg)
+{
+   switch (which)
+   {
+   case I_Po:
+      {
+         AtVector dPodx = AiM4VectorByMatrixMult(sg->Minv, sg->dPdx);
+         AtVector dPody = AiM4VectorByMatrixMult(sg->Minv, sg->dPdy);
+         return std::max(AiV3Length(dPodx), AiV3Length(dPody));
+      }
+   case I_UV:
+      return std::max(sqrtf(sg->dudx * sg->dudx + sg->dvdx * sg->dvdx),
+                      sqrtf(sg->dudy * sg->dudy + sg->dvdy * sg->dvdy));
+   case I_Pref:
+      // Pref derivatives are not available, assume Pref is close to P
+   case I_P:
+   default:
+      return std::max(AiV3Length(sg->dPdx), AiV3Length(sg->dPdy));
+   }
+}
+
+const PermutationTable* AcquireNoisePermutation(AtNode *node, NoiseType type)
+{
+   int seed = 0;
+   
+   switch (type)
+   {
+   case NT_simplex:
+   case NT_simplex4d:
+      seed = AiNodeGetInt(node, SSTR::simplex_seed);
+      break;
+   case NT_flow:
+      seed = AiNodeGetInt(node, SSTR::flow_seed);
+      break;
+   default:
+      break;
+   }
+   
+   // the reference permutation doesn't need a table
+   return (seed != 0 ? AcquirePermutationTable(seed) : 0);
+}
+
+// Shading statistics
+
+// Serializes JSON records of nodes sharing the same file
+static SpinLock gStatsFileLock;
+
+static std::string JSONString(const char *str)
+{
+   std::string out = "\"";
+   
+   for (; *str != '\0'; ++str)
+   {
+      if (*str == '"' || *str == '\\')
+      {
+         out += '\\';
+         out += *str;
+      }
+      else if ((unsigned char) *str < 0x20)
+      {
+         char escaped[8];
+         sprintf(escaped, "\\u%04x", (unsigned int) *str);
+         out += escaped;
+      }
+      else
+      {
+         out += *str;
+      }
+   }
+   
+   return out + "\"";
+}
+
+ShaderStats::ShaderStats()
+   : _enabled(false)
+   , _startCycles(0)
+   , _startTime(0)
+{
+   memset(_counters, 0, sizeof(_counters));
+}
+
+void ShaderStats::update(const char *shader, AtNode *node)
+{
+   report(shader, node);
+   
+   AtNode *options = AiUniverseGetOptions();
+   
+   const AtUserParamEntry *param = AiNodeLookUpUserParameter(options, SSTR::noise_stats);
+   _enabled = (param != 0 && AiUserParamGetType(param) == AI_TYPE_BOOLEAN && AiNodeGetBool(options, SSTR::noise_stats));
+   
+   param = AiNodeLookUpUserParameter(options, SSTR::noise_stats_file);
+   _file = ((_enabled && param != 0 && AiUserParamGetType(param) == AI_TYPE_STRING) ? AiNodeGetStr(options, SSTR::noise_stats_file).c_str() : "");
+   
+   _startCycles = ReadCycleCounter();
+   _startTime = AiMsgUtilGetElapsedTime();
+   
+   memset(_counters, 0, sizeof(_counters));
+}
+
+void ShaderStats::report(const char *shader, AtNode *node) const
+{
+   if (!_enabled)
+   {
+      return;
+   }
+   
+   ShaderCounters total;
+   memset(&total, 0, sizeof(total));
+   
+   for (int i=0; i<AI_MAX_THREADS; ++i)
+   {
+      total.samples += _counters[i].samples;
+      total.octaves += _counters[i].octaves;
+      total.cells += _counters[i].cells;
+      total.timedSamples += _counters[i].timedSamples;
+      total.cycles += _counters[i].cycles;
+   }
+   
+   if (total.samples == 0)
+   {
+      return;
+   }
+   
+   double samples = double(total.samples);
+   double cyclesPerSample = (total.timedSamples > 0 ? double(total.cycles) / double(total.timedSamples) : 0.0);
+   
+   // cycle counter ticks per microsecond since the last update, 0 if unknown
+   unsigned int elapsed = AiMsgUtilGetElapsedTime() - _startTime;
+   double ticksPerUs = (elapsed > 0 ? double(ReadCycleCounter() - _startCycles) / (1000.0 * double(elapsed)) : 0.0);
+   double usPerSample = (ticksPerUs > 0.0 ? cyclesPerSample / ticksPerUs : 0.0);
+   
+   AiMsgInfo("[%s] %s: %llu samples, %.2f octaves/sample, %.2f cells/sample, %.0f cycles/sample (%.3f us, %llu timed samples)",
+             shader, AiNodeGetName(node), (unsigned long long) total.samples,
+             double(total.octaves) / samples, double(total.cells) / samples,
+             cyclesPerSample, usPerSample, (unsigned long long) total.timedSamples);
+   
+   if (_file.empty())
+   {
+      return;
+   }
+   
+   ScopedSpinLock guard(gStatsFileLock);
+   
+   FILE *f = fopen(_file.c_str(), "a");
+   if (!f)
+   {
+      AiMsgWarning("[%s] %s: could not open '%s' to write statistics", shader, AiNodeGetName(node), _file.c_str());
+      return;
+   }
+   
+   fprintf(f, "{\"shader\": %s, \"node\": %s, \"samples\": %llu, \"octaves\": %llu, \"cells\": %llu, "
+              "\"timed_samples\": %llu, \"cycles\": %llu, \"cycles_per_sample\": %.1f, \"us_per_sample\": %.4f}\n",
+           JSONString(shader).c_str(), JSONString(AiNodeGetName(node)).c_str(),
+           (unsigned long long) total.samples, (unsigned long long) total.octaves, (unsigned long long) total.cells,
+           (unsigned long long) total.timedSamples, (unsigned long long) total.cycles,
+           cyclesPerSample, usPerSample);
+   
+   fclose(f);
+}
@@ -27,19 +27,20 @@ SOFTWARE.
 
 #include <ai.h>
 #include <algorithm>
-#include "libnoise/noisegen.h"
-#include "stegu/simplexnoise1234.h"
-#include "stegu/srdnoise23.h"
-
-enum NoiseQuality
-{
-   NQ_fast = 0,
-   NQ_std,
-   NQ_best
-};
+#include <string>
+#include <stdint.h>
+#include "kernels/fbm.h"
+
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#  include <x86intrin.h>
+#endif
 
 extern const char* NoiseQualityNames[];
 
+extern const char* NoiseHashNames[];
+
 
 enum Input
 {
@@ -52,383 +53,171 @@ enum Input
 extern const char* InputNames[];
 
 
-enum NoiseType
-{
-   NT_value = 0,
-   NT_perlin,
-   NT_simplex,
-   NT_flow
-};
-
 extern const char* NoiseTypeNames[];
 
 
+// Input point of the shading sample. Pref falls back to P on shapes without
+// Pref user data, with a single warning per shape
 AtVector GetInput(Input which, AtShaderGlobals *sg, AtNode *node);
 
+// Forget shapes found without Pref, called on node updates as shapes may
+// have been edited since
+void ResetMissingPref();
 
-class fBmBase
-{
-public:
-   
-   struct Params
-   {
-      int octaves;
-      float amplitude;
-      float persistence;
-      float frequency;
-      float lacunarity;
-   };
-   
-   struct Context
-   {
-      int octave;
-      float amplitude;
-      float frequency;
-   };
-   
-   Params params;
-   
-   fBmBase(int octaves, float amplitude, float persistence, float frequency, float lacunarity)
-   {
-      params.octaves = octaves;
-      params.amplitude = amplitude;
-      params.persistence = persistence;
-      params.frequency = frequency;
-      params.lacunarity = lacunarity;
-   }
-   
-   ~fBmBase()
-   {   
-   }
-};
+// Footprint of the shading sample in the space of the given input, from the
+// ray differentials. Used to band-limit fractal octaves
+float GetInputFilterWidth(Input which, AtShaderGlobals *sg);
 
-template <typename Noise, typename Modifier>
-class fBm : public fBmBase
-{
-private:
-   
-   Noise _noise;
-   Modifier _modifier;
-   
-public:
-   
-   typename Noise::Params noise_params;
-   typename Modifier::Params modifier_params;
+// Permutation table for the node's simplex_seed or flow_seed, depending on
+// the noise type. 0 when the reference permutation is used, otherwise to be
+// released with ReleasePermutationTable
+const PermutationTable* AcquireNoisePermutation(AtNode *node, NoiseType type);
 
-public:
-   
-   fBm(int octaves, float amplitude, float persistence, float frequency, float lacunarity)
-      : fBmBase(octaves, amplitude, persistence, frequency, lacunarity)
-   {
-   }
-   
-   float eval(const AtVector &inP, bool dampen=true)
-   {
-      Context ctx;
-      
-      ctx.amplitude = params.amplitude;
-      ctx.frequency = params.frequency;
-      ctx.octave = 0;
-      
-      float out = 0.0f;
-      // use to dampen fractal output
-      float tmp = 1.0f;
-      float dampfactor = 0.0f;
-      
-      AtVector P = inP * params.frequency;
-      
-      _noise.prepare(params, noise_params);
-      _modifier.prepare(params, modifier_params);
-      
-      for (; ctx.octave<params.octaves; ctx.octave++)
-      {
-         out += ctx.amplitude * _modifier.apply(ctx, _noise.value(ctx, P.x, P.y, P.z));
-         
-         // Prepare the next octave.
-         dampfactor += tmp;
-         
-         ctx.amplitude *= params.persistence;
-         ctx.frequency *= params.lacunarity;
-         
-         tmp *= params.persistence;
-         P *= params.lacunarity;
-      }
-      
-      if (dampen)
-      {
-         out /= dampfactor;
-      }
-      
-      _modifier.cleanup();
-      _noise.cleanup();
-      
-      return out;
-   }
-};
 
-struct ValueNoise
+// Per thread cache lookup counters, padded to avoid false sharing
+struct CacheCounters
 {
-   struct Params
-   {
-      int seed;
-      NoiseQuality quality;
-   };
-   
-   Params _params;
-   
-   inline ValueNoise()
-   {
-      _params.seed = 0;
-      _params.quality = NQ_std;
-   }
-   
-   inline void prepare(const fBmBase::Params &, const Params &inParams)
-   {
-      _params = inParams;
-   }
-   
-   inline float value(const fBmBase::Context &ctx, float x, float y, float z)
-   {
-      // Make sure that these floating-point values have the same range as a 32-
-      // bit integer so that we can pass them to the coherent-noise functions.
-      float nx = float(noise::MakeInt32Range(x));
-      float ny = float(noise::MakeInt32Range(y));
-      float nz = float(noise::MakeInt32Range(z));
-      _params.seed = (_params.seed + ctx.octave) & 0xFFFFFFFF;
-      return float(noise::ValueCoherentNoise3D(nx, ny, nz, _params.seed, (noise::NoiseQuality)_params.quality));
-   }
-   
-   inline void cleanup()
-   {
-   }
+   uint64_t hits;
+   uint64_t misses;
+   char pad[64 - 2 * sizeof(uint64_t)];
 };
 
-struct PerlinNoise
+// Per thread shading counters (see ShaderStats), padded to avoid false sharing
+struct ShaderCounters
 {
-   struct Params
-   {
-      int seed;
-      NoiseQuality quality;
-   };
-   
-   Params _params;
-   
-   inline PerlinNoise()
-   {
-      _params.seed = 0;
-      _params.quality = NQ_std;
-   }
-   
-   inline void prepare(const fBmBase::Params &, const Params &inParams)
-   {
-      _params = inParams;
-   }
-   
-   inline float value(const fBmBase::Context &ctx, float x, float y, float z)
-   {
-      // Make sure that these floating-point values have the same range as a 32-
-      // bit integer so that we can pass them to the coherent-noise functions.
-      float nx = float(noise::MakeInt32Range(x));
-      float ny = float(noise::MakeInt32Range(y));
-      float nz = float(noise::MakeInt32Range(z));
-      _params.seed = (_params.seed + ctx.octave) & 0xFFFFFFFF;
-      return float(noise::GradientCoherentNoise3D(nx, ny, nz, _params.seed, (noise::NoiseQuality)_params.quality));
-   }
-   
-   inline void cleanup()
-   {
-   }
+   uint64_t samples;
+   // fBm octaves and voronoi cells evaluated by all samples
+   uint64_t octaves;
+   uint64_t cells;
+   // samples timed and their total duration in CPU cycles
+   uint64_t timedSamples;
+   uint64_t cycles;
+   char pad[64 - 5 * sizeof(uint64_t)];
 };
 
-struct SimplexNoise
+// CPU cycle counter, 0 when not available
+inline uint64_t ReadCycleCounter()
 {
-   struct Params
-   {
-   };
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+   return __rdtsc();
+#elif defined(__x86_64__) || defined(__i386__)
+   return __rdtsc();
+#elif defined(__aarch64__)
+   uint64_t count;
+   __asm__ __volatile__ ("mrs %0, cntvct_el0" : "=r" (count));
+   return count;
+#else
+   return 0;
+#endif
+}
+
+// Optional shading statistics, enabled by a 'noise_stats' BOOL user
+// parameter on the options node.
+//
+// Counters are per thread (indexed by sg->tid) and only reduced when
+// reporting. One in TimingInterval samples is timed with the CPU cycle
+// counter. The report is logged and, when the options node has a
+// 'noise_stats_file' STRING user parameter, appended to that file as one
+// JSON object per line.
+class ShaderStats
+{
+public:
    
-   Params _params;
+   static const uint64_t TimingInterval = 64;
    
-   inline void prepare(const fBmBase::Params &, const Params &)
-   {
-   }
+   ShaderStats();
    
-   inline float value(const fBmBase::Context &, float x, float y, float z)
-   {
-      return SimplexNoise1234::noise(x, y, z);
-   }
+   // Report the counters so far, then read the render options and reset
+   void update(const char *shader, AtNode *node);
    
-   inline void cleanup()
-   {
-   }
-};
-
-struct FlowNoise
-{
-   struct Params
-   {
-      float t;
-      float power;
-   };
+   // Summary of the counters since the last update
+   void report(const char *shader, AtNode *node) const;
    
-   Params _params;
-   float _dx;
-   float _dy;
-   float _dz;
-   float _power;
-   float _persistence;
-   
-   inline FlowNoise()
-      : _dx(0.0f), _dy(0.0f), _dz(0.0f), _power(0.0f), _persistence(1.0f)
+   inline bool enabled() const
    {
-      _params.t = 0.0f;
-      _params.power = 0.25f;
+      return _enabled;
    }
    
-   inline void prepare(const fBmBase::Params &fbmparams, const Params &params)
+   inline ShaderCounters& counters(int tid)
    {
-      _params = params;
-      _power = params.power;
-      _persistence = fbmparams.persistence;
-      _dx = 0.0f;
-      _dy = 0.0f;
-      _dz = 0.0f;
+      return _counters[tid];
    }
    
-   inline float value(const fBmBase::Context &, float x, float y, float z)
-   {
-      // the new derivatives
-      float dx = 0.0f;
-      float dy = 0.0f;
-      float dz = 0.0f;
-      
-      float rv = srdnoise3(x+_dx, y+_dy, z+_dz, _params.t, &dx, &dy, &dz);
-      
-      // update derivatives
-      _dx += _power * dx;
-      _dy += _power * dy;
-      _dz += _power * dz;
-      _power *= _persistence;
-      
-      return rv;
-   }
+private:
    
-   inline void cleanup()
-   {
-   }
+   bool _enabled;
+   std::string _file;
+   // cycle counter frequency is estimated from the render elapsed time
+   uint64_t _startCycles;
+   unsigned int _startTime;
+   ShaderCounters _counters[AI_MAX_THREADS];
 };
 
-template <typename M1, typename M2>
-struct CombineModifier
+// Counts, and every ShaderStats::TimingInterval samples times, the shading
+// sample it is scoped to. Does nothing when statistics are disabled
+class ShaderSample
 {
-   struct Params
-   {
-      typename M1::Params mod1;
-      typename M2::Params mod2;
-   };
-   
-   M1 _mod1;
-   M2 _mod2;
-   
-   inline void prepare(const fBmBase::Params &fbmparams, const Params &params)
-   {
-      _mod1.prepare(fbmparams, params.mod1);
-      _mod2.prepare(fbmparams, params.mod2);
-   }
+public:
    
-   inline float apply(const fBmBase::Context &ctx, float noise_value) const
+   inline ShaderSample(ShaderStats &stats, int tid)
+      : _counters(stats.enabled() ? &stats.counters(tid) : 0)
+      , _start(0)
    {
-      return _mod2.apply(ctx, _mod1.apply(ctx, noise_value));
+      if (_counters && (_counters->samples++ % ShaderStats::TimingInterval) == 0)
+      {
+         _start = ReadCycleCounter();
+      }
    }
    
-   inline void cleanup()
+   inline ~ShaderSample()
    {
+      if (_start != 0)
+      {
+         _counters->cycles += ReadCycleCounter() - _start;
+         ++_counters->timedSamples;
+      }
    }
-};
-
-struct DefaultModifier
-{
-   struct Params
-   {
-   };
    
-   inline void prepare(const fBmBase::Params &, const Params &)
+   // addOctaves and addCells may only be called when counting
+   inline bool counting() const
    {
+      return (_counters != 0);
    }
    
-   inline float apply(const fBmBase::Context &, float noise_value) const
+   inline void addOctaves(uint64_t count)
    {
-      return noise_value;
+      _counters->octaves += count;
    }
    
-   inline void cleanup()
+   inline void addCells(uint64_t count)
    {
+      _counters->cells += count;
    }
-};
-
-struct TurbulenceModifier
-{
-   struct Params
-   {
-      float offset;
-      float scale;
-   };
-   
-   Params _params;
    
-   inline void prepare(const fBmBase::Params &, const Params &params)
-   {
-      _params = params;
-   }
+private:
    
-   inline float apply(const fBmBase::Context &, float noise_value) const
-   {
-      return (_params.scale * (_params.offset + fabsf(noise_value)));
-   }
+   ShaderSample(const ShaderSample&);
+   ShaderSample& operator=(const ShaderSample&);
    
-   inline void cleanup()
-   {
-   }
+   ShaderCounters *_counters;
+   uint64_t _start;
 };
 
-struct RidgeModifier
+
+// Conversions between Arnold and noise kernels vector types
+
+inline Vec3 ToVec3(const AtVector &v)
 {
-   struct Params
-   {
-      float offset;
-      float gain;
-      float exponent;
-   };
-   
-   Params _params;
-   mutable float _weight;
-   
-   inline RidgeModifier()
-      : _weight(1.0f)
-   {
-   }
-   
-   void prepare(const fBmBase::Params &, const Params &params)
-   {
-      _params = params;
-      _weight = 1.0f;
-   }
-   
-   float apply(const fBmBase::Context &ctx, float noise_value) const
-   {
-      float s = _params.offset - noise_value;
-      
-      s *= s * _weight;
-      
-      // update weight for next octave
-      _weight = AiClamp(s * _params.gain, 0.0f, 1.0f);
-      
-      // apply octave spectral weight
-      return (s * powf(ctx.frequency, -_params.exponent));
-   }
-   
-   inline void cleanup()
-   {
-   }
-};
+   return Vec3(v.x, v.y, v.z);
+}
+
+inline AtVector ToAtVector(const Vec3 &v)
+{
+   AtVector rv;
+   rv.x = v.x;
+   rv.y = v.y;
+   rv.z = v.z;
+   return rv;
+}
 
 #endif
@@ -0,0 +1,186 @@
+/*
+MIT License
+
+Copyright (c) 2016 Gaetan Guidet
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "common.h"
+#include "kernels/curl_noise.h"
+
+AI_SHADER_NODE_EXPORT_METHODS(CurlNoiseMtd);
+
+enum CurlNoiseParams
+{
+   p_input = 0,
+   p_custom_input,
+   p_frequency,
+   p_power,
+   p_roughness,
+   p_auto_octaves,
+   p_auto_octaves_scale,
+   p_simplex_seed,
+   p_output
+};
+
+enum CurlOutput
+{
+   CO_curl = 0,
+   CO_distorted_point
+};
+
+static const char *CurlOutputNames[] =
+{
+   "curl",
+   "distorted_point",
+   NULL
+};
+
+namespace SSTR
+{
+   extern AtString input;
+   extern AtString custom_input;
+   extern AtString auto_octaves;
+   extern AtString auto_octaves_scale;
+   extern AtString frequency;
+   extern AtString power;
+   extern AtString roughness;
+   extern AtString simplex_seed;
+   extern AtString output;
+}
+
+node_parameters
+{
+   AiParameterEnum(SSTR::input, I_P, InputNames);
+   AiParameterVec(SSTR::custom_input, 0.0f, 0.0f, 0.0f);
+   
+   AiParameterFlt(SSTR::frequency, 1.0f);
+   AiParameterFlt(SSTR::power, 1.0f);
+   AiParameterInt(SSTR::roughness, 3);
+   
+   AiParameterBool(SSTR::auto_octaves, false);
+   AiParameterFlt(SSTR::auto_octaves_scale, 1.0f);
+   AiParameterInt(SSTR::simplex_seed, 0);
+   AiParameterEnum(SSTR::output, CO_curl, CurlOutputNames);
+}
+
+struct CurlNoiseData
+{
+   Input input;
+   bool evalCustomInput;
+   bool autoOctaves;
+   float autoOctavesScale;
+   CurlOutput output;
+   // seeded permutation (see AcquireNoisePermutation)
+   const PermutationTable *permutation;
+   ShaderStats stats;
+   
+   CurlNoiseData()
+      : permutation(0)
+   {
+   }
+   
+   ~CurlNoiseData()
+   {
+      ReleasePermutationTable(permutation);
+   }
+};
+
+node_initialize
+{
+   AiNodeSetLocalData(node, new CurlNoiseData());
+}
+
+node_update
+{
+   CurlNoiseData *data = (CurlNoiseData*) AiNodeGetLocalData(node);
+   data->evalCustomInput = AiNodeIsLinked(node, SSTR::custom_input);
+   data->input = (Input) AiNodeGetInt(node, SSTR::input);
+   
+   if (data->input == I_Pref && !data->evalCustomInput)
+   {
+      ResetMissingPref();
+   }
+   
+   data->autoOctaves = AiNodeGetBool(node, SSTR::auto_octaves);
+   data->autoOctavesScale = AiNodeGetFlt(node, SSTR::auto_octaves_scale);
+   data->output = (CurlOutput) AiNodeGetInt(node, SSTR::output);
+   
+   // simplex_seed is not linkable, its permutation table is built once and
+   // shared with other nodes
+   const PermutationTable *permutation = AcquireNoisePermutation(node, NT_simplex);
+   ReleasePermutationTable(data->permutation);
+   data->permutation = permutation;
+   
+   data->stats.update("curl_noise", node);
+}
+
+node_finish
+{
+   CurlNoiseData *data = (CurlNoiseData*) AiNodeGetLocalData(node);
+   data->stats.report("curl_noise", node);
+   delete data;
+}
+
+shader_evaluate
+{
+   CurlNoiseData *data = (CurlNoiseData*) AiNodeGetLocalData(node);
+   ShaderSample sample(data->stats, sg->tid);
+   
+   AtVector P;
+   if (data->evalCustomInput)
+   {
+      P = AiShaderEvalParamVec(p_custom_input);
+   }
+   else
+   {
+      P = GetInput(data->input, sg, node);
+   }
+   
+   CurlNoiseValues values;
+   
+   values.frequency = AiShaderEvalParamFlt(p_frequency);
+   values.power = AiShaderEvalParamFlt(p_power);
+   values.roughness = AiShaderEvalParamInt(p_roughness);
+   values.filter_width = 0.0f;
+   values.permutation = data->permutation;
+   
+   if (data->autoOctaves)
+   {
+      // custom input derivatives are unknown, assume they match P's
+      values.filter_width = data->autoOctavesScale * GetInputFilterWidth(data->evalCustomInput ? I_P : data->input, sg);
+   }
+   
+   if (sample.counting())
+   {
+      sample.addOctaves(EvaluatedOctaves(values));
+   }
+   
+   Vec3 curl = CurlNoise(values, ToVec3(P));
+   
+   if (data->output == CO_distorted_point)
+   {
+      sg->out.VEC() = ToAtVector(ToVec3(P) + curl);
+   }
+   else
+   {
+      sg->out.VEC() = ToAtVector(curl);
+   }
+}
@@ -23,6 +23,7 @@ SOFTWARE.
 */
 
 #include "common.h"
+#include "kernels/distort_point.h"
 
 AI_SHADER_NODE_EXPORT_METHODS(DistortPointMtd);
 
@@ -37,7 +38,15 @@ enum DistortPointParams
    p_value_seed,
    p_perlin_seed,
    p_flow_power,
-   p_flow_time
+   p_flow_time,
+   p_auto_octaves,
+   p_auto_octaves_scale,
+   p_volume_cache,
+   p_volume_cache_memory,
+   p_simplex_seed,
+   p_flow_seed,
+   p_lattice_hash,
+   p_time
 };
 
 namespace SSTR
@@ -46,6 +55,60 @@ namespace SSTR
    extern AtString custom_input;
    extern AtString linkable;
    extern AtString base_noise;
+   extern AtString auto_octaves;
+   extern AtString auto_octaves_scale;
+   extern AtString frequency;
+   extern AtString power;
+   extern AtString roughness;
+   extern AtString value_seed;
+   extern AtString perlin_seed;
+   extern AtString flow_power;
+   extern AtString flow_time;
+   extern AtString volume_cache;
+   extern AtString volume_cache_memory;
+   extern AtString simplex_seed;
+   extern AtString flow_seed;
+   extern AtString lattice_hash;
+   extern AtString time;
+}
+
+inline uint32_t ParamBit(DistortPointParams p)
+{
+   return (uint32_t(1) << p);
+}
+
+// Read parameter value and keep track of whether it is linked or not
+
+static inline void UpdateParam(AtNode *node, const AtString &name, DistortPointParams p, float &value, uint32_t &linked)
+{
+   value = AiNodeGetFlt(node, name);
+   if (AiNodeIsLinked(node, name))
+   {
+      linked |= ParamBit(p);
+   }
+}
+
+static inline void UpdateParam(AtNode *node, const AtString &name, DistortPointParams p, int &value, uint32_t &linked)
+{
+   value = AiNodeGetInt(node, name);
+   if (AiNodeIsLinked(node, name))
+   {
+      linked |= ParamBit(p);
+   }
+}
+
+// Only re-evaluate linked parameters at shading time
+
+static inline void EvalLinkedParams(AtNode *node, AtShaderGlobals *sg, uint32_t linked, DistortPointValues &values)
+{
+   if (linked & ParamBit(p_frequency)) values.frequency = AiShaderEvalParamFlt(p_frequency);
+   if (linked & ParamBit(p_power)) values.power = AiShaderEvalParamFlt(p_power);
+   if (linked & ParamBit(p_roughness)) values.roughness = AiShaderEvalParamInt(p_roughness);
+   if (linked & ParamBit(p_value_seed)) values.value_seed = AiShaderEvalParamInt(p_value_seed);
+   if (linked & ParamBit(p_perlin_seed)) values.perlin_seed = AiShaderEvalParamInt(p_perlin_seed);
+   if (linked & ParamBit(p_flow_power)) values.flow_power = AiShaderEvalParamFlt(p_flow_power);
+   if (linked & ParamBit(p_flow_time)) values.flow_time = AiShaderEvalParamFlt(p_flow_time);
+   if (linked & ParamBit(p_time)) values.time = AiShaderEvalParamFlt(p_time);
 }
 
 node_parameters
@@ -62,6 +125,14 @@ node_parameters
    AiParameterInt("perlin_seed", 0);
    AiParameterFlt("flow_power", 0.25f);
    AiParameterFlt("flow_time", 0.0f);
+   AiParameterBool(SSTR::auto_octaves, false);
+   AiParameterFlt(SSTR::auto_octaves_scale, 1.0f);
+   AiParameterBool(SSTR::volume_cache, false);
+   AiParameterFlt(SSTR::volume_cache_memory, 512.0f);
+   AiParameterInt(SSTR::simplex_seed, 0);
+   AiParameterInt(SSTR::flow_seed, 0);
+   AiParameterEnum(SSTR::lattice_hash, NH_legacy, NoiseHashNames);
+   AiParameterFlt(SSTR::time, 0.0f);
 }
 
 struct DistortPointData
@@ -69,8 +140,79 @@ struct DistortPointData
    Input input;
    bool evalCustomInput;
    NoiseType type;
+   bool autoOctaves;
+   float autoOctavesScale;
+   NoiseHash latticeHash;
+   // simplex and flow noises seeded permutation (see AcquireNoisePermutation)
+   const PermutationTable *permutation;
+   // sparse cache of the offset around the shaded points, only when all
+   // the noise parameters are constant (see node_update)
+   BrickCache *bricks;
+   // parameter values resolved at update time
+   DistortPointValues values;
+   // bit mask of the noise parameters that need to be evaluated per sample
+   uint32_t linked;
+   // bound to the update time parameter values, only when none is linked
+   DistortPointEvaluator *evaluator;
+   DistortPointBakeSource bakeSource;
+   // indexed by sg->tid
+   CacheCounters cacheCounters[AI_MAX_THREADS];
+   ShaderStats stats;
+   
+   DistortPointData()
+      : permutation(0)
+      , bricks(0)
+      , linked(0)
+      , evaluator(0)
+   {
+   }
+   
+   ~DistortPointData()
+   {
+      reset();
+      ReleasePermutationTable(permutation);
+   }
+   
+   void reset()
+   {
+      delete bricks;
+      bricks = 0;
+      delete evaluator;
+      evaluator = 0;
+      for (int i=0; i<AI_MAX_THREADS; ++i)
+      {
+         cacheCounters[i].hits = 0;
+         cacheCounters[i].misses = 0;
+      }
+   }
 };
 
+static void ReportCacheStats(AtNode *node, const DistortPointData *data)
+{
+   if (!data->bricks)
+   {
+      return;
+   }
+   
+   uint64_t hits = 0;
+   uint64_t misses = 0;
+   
+   for (int i=0; i<AI_MAX_THREADS; ++i)
+   {
+      hits += data->cacheCounters[i].hits;
+      misses += data->cacheCounters[i].misses;
+   }
+   
+   if (hits + misses > 0)
+   {
+      AiMsgInfo("[distort_point] %s: volume cache %llu hits, %llu misses (%.2f%% hit rate), %llu/%llu bricks, %.2f MB",
+                AiNodeGetName(node), (unsigned long long) hits, (unsigned long long) misses,
+                100.0 * double(hits) / double(hits + misses),
+                (unsigned long long) data->bricks->bricks(), (unsigned long long) data->bricks->maxBricks(),
+                double(data->bricks->bytes()) / (1024.0 * 1024.0));
+   }
+}
+
 node_initialize
 {
    AiNodeSetLocalData(node, new DistortPointData());
@@ -81,28 +223,107 @@ node_update
    DistortPointData *data = (DistortPointData*) AiNodeGetLocalData(node);
    data->evalCustomInput = AiNodeIsLinked(node, SSTR::custom_input);
    data->input = (Input) AiNodeGetInt(node, SSTR::input);
+   
+   if (data->input == I_Pref && !data->evalCustomInput)
+   {
+      ResetMissingPref();
+   }
+   
    data->type = (NoiseType) AiNodeGetInt(node, SSTR::base_noise);
+   data->autoOctaves = AiNodeGetBool(node, SSTR::auto_octaves);
+   data->autoOctavesScale = AiNodeGetFlt(node, SSTR::auto_octaves_scale);
+   data->latticeHash = (NoiseHash) AiNodeGetInt(node, SSTR::lattice_hash);
+   
+   // simplex and flow seeds are not linkable, their permutation tables are
+   // built once and shared with other nodes
+   const PermutationTable *permutation = AcquireNoisePermutation(node, data->type);
+   ReleasePermutationTable(data->permutation);
+   data->permutation = permutation;
+   
+   ReportCacheStats(node, data);
+   data->reset();
+   data->stats.update("distort_point", node);
+   
+   // only the parameters of the selected noise type are tracked
+   DistortPointValues &values = data->values;
+   uint32_t linked = 0;
+   
+   UpdateParam(node, SSTR::frequency, p_frequency, values.frequency, linked);
+   UpdateParam(node, SSTR::power, p_power, values.power, linked);
+   UpdateParam(node, SSTR::roughness, p_roughness, values.roughness, linked);
+   values.filter_width = 0.0f;
+   values.value_seed = 0;
+   values.perlin_seed = 0;
+   values.lattice_hash = data->latticeHash;
+   values.flow_power = 0.0f;
+   values.flow_time = 0.0f;
+   values.time = 0.0f;
+   values.permutation = data->permutation;
+   
+   switch (data->type)
+   {
+   case NT_value:
+      UpdateParam(node, SSTR::value_seed, p_value_seed, values.value_seed, linked);
+      break;
+   case NT_perlin:
+      UpdateParam(node, SSTR::perlin_seed, p_perlin_seed, values.perlin_seed, linked);
+      break;
+   case NT_flow:
+      UpdateParam(node, SSTR::flow_power, p_flow_power, values.flow_power, linked);
+      UpdateParam(node, SSTR::flow_time, p_flow_time, values.flow_time, linked);
+      break;
+   case NT_simplex4d:
+      UpdateParam(node, SSTR::time, p_time, values.time, linked);
+      break;
+   case NT_simplex:
+   default:
+      break;
+   }
+   
+   data->linked = linked;
+   
+   if (linked == 0)
+   {
+      data->evaluator = CreateDistortPointEvaluator(data->type);
+      data->evaluator->setup(values);
+   }
+   
+   if (AiNodeGetBool(node, SSTR::volume_cache))
+   {
+      if (linked != 0 || data->autoOctaves)
+      {
+         AiMsgWarning("[distort_point] %s: volume cache requires constant noise parameters and auto_octaves off. Evaluating directly.",
+                      AiNodeGetName(node));
+      }
+      else
+      {
+         size_t maxBytes = size_t(std::max(0.0f, AiNodeGetFlt(node, SSTR::volume_cache_memory)) * 1024.0f * 1024.0f);
+         
+         data->bakeSource.bind(data->type, values);
+         data->bricks = new BrickCache(3, BakeSpacing(values), maxBytes);
+         
+         if (!data->bricks->valid())
+         {
+            AiMsgWarning("[distort_point] %s: invalid volume cache memory budget. Evaluating directly.", AiNodeGetName(node));
+            delete data->bricks;
+            data->bricks = 0;
+         }
+      }
+   }
 }
 
 node_finish
 {
    DistortPointData *data = (DistortPointData*) AiNodeGetLocalData(node);
+   ReportCacheStats(node, data);
+   data->stats.report("distort_point", node);
    delete data;
 }
 
 shader_evaluate
 {
-   static float x0 = (12414.0f / 65536.0f);
-   static float y0 = (65124.0f / 65536.0f);
-   static float z0 = (31337.0f / 65536.0f);
-   static float x1 = (26519.0f / 65536.0f);
-   static float y1 = (18128.0f / 65536.0f);
-   static float z1 = (60493.0f / 65536.0f);
-   static float x2 = (53820.0f / 65536.0f);
-   static float y2 = (11213.0f / 65536.0f);
-   static float z2 = (44845.0f / 65536.0f);
-   
    DistortPointData *data = (DistortPointData*) AiNodeGetLocalData(node);
+   ShaderSample sample(data->stats, sg->tid);
    
    AtVector P;
    if (data->evalCustomInput)
@@ -114,70 +335,57 @@ shader_evaluate
       P = GetInput(data->input, sg, node);
    }
    
-   float frequency = AiShaderEvalParamFlt(p_frequency);
-   float power = AiShaderEvalParamFlt(p_power);
-   int roughness = AiShaderEvalParamInt(p_roughness);
-   
-   AtVector P0, P1, P2;
-   
-   P0.x = P.x + x0;
-   P0.y = P.y + y0;
-   P0.z = P.z + z0;
-   
-   P1.x = P.x + x1;
-   P1.y = P.y + y1;
-   P1.z = P.z + z1;
-   
-   P2.x = P.x + x2;
-   P2.y = P.y + y2;
-   P2.z = P.z + z2;
-   
-   switch (data->type)
+   if (data->bricks)
    {
-   case NT_value:
+      Vec3 Pv = ToVec3(P);
+      float offset[3];
+      
+      if (data->bricks->lookup(data->bakeSource, Pv, offset))
       {
-         int seed = AiShaderEvalParamInt(p_value_seed);
-         fBm<ValueNoise, DefaultModifier> fbm(roughness, 1.0f, 0.5f, frequency, 2.0f);
-         fbm.noise_params.quality = NQ_std;
-         fbm.noise_params.seed = seed + 0;
-         sg->out.VEC().x = P.x + power * fbm.eval(P0, false);
-         fbm.noise_params.seed = seed + 1;
-         sg->out.VEC().y = P.y + power * fbm.eval(P1, false);
-         fbm.noise_params.seed = seed + 2;
-         sg->out.VEC().z = P.z + power * fbm.eval(P2, false);
+         ++data->cacheCounters[sg->tid].hits;
+         sg->out.VEC() = ToAtVector(Pv + Vec3(offset[0], offset[1], offset[2]));
       }
-      break;
-   case NT_perlin:
+      else
       {
-         int seed = AiShaderEvalParamInt(p_perlin_seed);
-         fBm<PerlinNoise, DefaultModifier> fbm(roughness, 1.0f, 0.5f, frequency, 2.0f);
-         fbm.noise_params.quality = NQ_std;
-         fbm.noise_params.seed = seed + 0;
-         sg->out.VEC().x = P.x + power * fbm.eval(P0, false);
-         fbm.noise_params.seed = seed + 1;
-         sg->out.VEC().y = P.y + power * fbm.eval(P1, false);
-         fbm.noise_params.seed = seed + 2;
-         sg->out.VEC().z = P.z + power * fbm.eval(P2, false);
+         ++data->cacheCounters[sg->tid].misses;
+         if (sample.counting())
+         {
+            sample.addOctaves(EvaluatedOctaves(data->values));
+         }
+         sg->out.VEC() = ToAtVector(data->evaluator->eval(Pv, 0.0f));
       }
-      break;
-   case NT_flow:
-      {
-         fBm<FlowNoise, DefaultModifier> fbm(roughness, 1.0f, 0.5f, frequency, 2.0f);
-         fbm.noise_params.power = AiShaderEvalParamFlt(p_flow_power);
-         fbm.noise_params.t = AiShaderEvalParamFlt(p_flow_time);
-         sg->out.VEC().x = P.x + power * fbm.eval(P0, false);
-         sg->out.VEC().y = P.y + power * fbm.eval(P1, false);
-         sg->out.VEC().z = P.z + power * fbm.eval(P2, false);
-      }
-      break;
-   case NT_simplex:
-   default:
+      return;
+   }
+   
+   float filterWidth = 0.0f;
+   
+   if (data->autoOctaves)
+   {
+      // custom input derivatives are unknown, assume they match P's
+      filterWidth = data->autoOctavesScale * GetInputFilterWidth(data->evalCustomInput ? I_P : data->input, sg);
+   }
+   
+   if (data->linked == 0)
+   {
+      if (sample.counting())
       {
-         fBm<SimplexNoise, DefaultModifier> fbm(roughness, 1.0f, 0.5f, frequency, 2.0f);
-         sg->out.VEC().x = P.x + power * fbm.eval(P0, false);
-         sg->out.VEC().y = P.y + power * fbm.eval(P1, false);
-         sg->out.VEC().z = P.z + power * fbm.eval(P2, false);
+         DistortPointValues values = data->values;
+         values.filter_width = filterWidth;
+         sample.addOctaves(EvaluatedOctaves(values));
       }
-      break;
+      sg->out.VEC() = ToAtVector(data->evaluator->eval(ToVec3(P), filterWidth));
+      return;
    }
+   
+   DistortPointValues values = data->values;
+   
+   EvalLinkedParams(node, sg, data->linked, values);
+   values.filter_width = filterWidth;
+   
+   if (sample.counting())
+   {
+      sample.addOctaves(EvaluatedOctaves(values));
+   }
+   
+   sg->out.VEC() = ToAtVector(DistortPoint(data->type, values, ToVec3(P)));
 }
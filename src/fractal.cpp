@@ -22,221 +22,231 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
-#include "common.h"
+#include "fractal_common.h"
 
 AI_SHADER_NODE_EXPORT_METHODS(FractalMtd);
 
-enum FractalParams
+enum FractalCacheParams
 {
-   p_input = 0,
-   p_custom_input,
+   p_bake = p_fractal_last,
+   p_bake_bound_min,
+   p_bake_bound_max,
+   p_bake_interpolation,
+   p_bake_memory,
    
-   // fBm parameters
-   p_amplitude,
-   p_frequency,
-   p_octaves,
-   p_persistence,
-   p_lacunarity,
+   p_volume_cache,
+   p_volume_cache_memory,
    
-   p_base_noise,
-   // value noise parameters
-   p_value_seed,
-   p_value_quality,
-   // perlin noise parameters
-   p_perlin_seed,
-   p_perlin_quality,
-   // flow noise parameters
-   p_flow_power,
-   p_flow_time,
-   
-   p_turbulent,
-   // turbulence params
-   p_turbulence_offset,
-   p_turbulence_scale,
-   
-   p_ridged,
-   // ridge params
-   p_ridge_offset,
-   p_ridge_gain,
-   p_ridge_exponent,
-   
-   p_dampen_output,
-   
-   p_remap_output,
-   p_fractal_min,
-   p_fractal_max,
-   p_output_min,
-   p_output_max,
-   p_clamp_output
+   p_motion_reuse,
+   p_motion_reuse_distance
 };
 
-template <typename TNoise, typename TModifier>
-void SetupNoise(AtNode *, AtShaderGlobals *, fBm<TNoise, TModifier> &)
+static const char *BakeInterpolationNames[] =
 {
-}
-template <typename TModifier>
-void SetupNoise(AtNode *node, AtShaderGlobals *sg, fBm<ValueNoise, TModifier> &fbm)
-{
-   fbm.noise_params.seed = AiShaderEvalParamInt(p_value_seed);
-   fbm.noise_params.quality = (NoiseQuality) AiShaderEvalParamInt(p_value_quality);
-}
-template <typename TModifier>
-void SetupNoise(AtNode *node, AtShaderGlobals *sg, fBm<PerlinNoise, TModifier> &fbm)
-{
-   fbm.noise_params.seed = AiShaderEvalParamInt(p_perlin_seed);
-   fbm.noise_params.quality = (NoiseQuality) AiShaderEvalParamInt(p_perlin_quality);
-}
-template <typename TModifier>
-void SetupNoise(AtNode *node, AtShaderGlobals *sg, fBm<FlowNoise, TModifier> &fbm)
-{
-   fbm.noise_params.t = AiShaderEvalParamFlt(p_flow_time);
-   fbm.noise_params.power = AiShaderEvalParamFlt(p_flow_power);
-}
+   "linear",
+   "cubic",
+   NULL
+};
 
-template <typename TNoise, typename TModifier>
-void SetupModifier(AtNode *, AtShaderGlobals *, fBm<TNoise, TModifier> &)
-{
-}
-template <typename TNoise>
-void SetupModifier(AtNode *node, AtShaderGlobals *sg, fBm<TNoise, TurbulenceModifier> &fbm)
+namespace SSTR
 {
-   fbm.modifier_params.offset = AiShaderEvalParamFlt(p_turbulence_offset);
-   fbm.modifier_params.scale = AiShaderEvalParamFlt(p_turbulence_scale);
+   extern AtString bake;
+   extern AtString bake_bound_min;
+   extern AtString bake_bound_max;
+   extern AtString bake_interpolation;
+   extern AtString bake_memory;
+   extern AtString volume_cache;
+   extern AtString volume_cache_memory;
+   extern AtString motion_reuse;
+   extern AtString motion_reuse_distance;
 }
-template <typename TNoise>
-void SetupModifier(AtNode *node, AtShaderGlobals *sg, fBm<TNoise, RidgeModifier> &fbm)
+
+node_parameters
 {
-   fbm.modifier_params.offset = AiShaderEvalParamFlt(p_ridge_offset);
-   fbm.modifier_params.gain = AiShaderEvalParamFlt(p_ridge_gain);
-   fbm.modifier_params.exponent = AiShaderEvalParamFlt(p_ridge_exponent);
+   DeclareFractalParameters(params);
+   
+   AiParameterBool(SSTR::bake, false);
+   AiParameterVec(SSTR::bake_bound_min, -1.0f, -1.0f, -1.0f);
+   AiParameterVec(SSTR::bake_bound_max, 1.0f, 1.0f, 1.0f);
+   AiParameterEnum(SSTR::bake_interpolation, BI_linear, BakeInterpolationNames);
+   AiParameterFlt(SSTR::bake_memory, 256.0f);
+   AiParameterBool(SSTR::volume_cache, false);
+   AiParameterFlt(SSTR::volume_cache_memory, 512.0f);
+   AiParameterBool(SSTR::motion_reuse, false);
+   AiParameterFlt(SSTR::motion_reuse_distance, FRACTAL_REUSE_DEFAULT_DISTANCE);
 }
-template <typename TNoise>
-void SetupModifier(AtNode *node, AtShaderGlobals *sg, fBm<TNoise, CombineModifier<TurbulenceModifier, RidgeModifier> > &fbm)
+
+// Per thread reused sample, padded to avoid false sharing
+struct ThreadSampleReuse
 {
-   fbm.modifier_params.mod1.offset = AiShaderEvalParamFlt(p_turbulence_offset);
-   fbm.modifier_params.mod1.scale = AiShaderEvalParamFlt(p_turbulence_scale);
-   fbm.modifier_params.mod2.offset = AiShaderEvalParamFlt(p_ridge_offset);
-   fbm.modifier_params.mod2.gain = AiShaderEvalParamFlt(p_ridge_gain);
-   fbm.modifier_params.mod2.exponent = AiShaderEvalParamFlt(p_ridge_exponent);
-}
+   FractalSampleReuse sample;
+   char pad[64 - sizeof(FractalSampleReuse) % 64];
+};
 
-template <typename TNoise>
-float EvalNoise(AtNode *node, AtShaderGlobals *sg, const AtVector &P)
+struct FractalData : public FractalNodeData
 {
-   float amplitude = AiShaderEvalParamFlt(p_amplitude);
-   float frequency = AiShaderEvalParamFlt(p_frequency);
-   int octaves = AiShaderEvalParamInt(p_octaves);
-   float persistence = AiShaderEvalParamFlt(p_persistence);
-   float lacunarity = AiShaderEvalParamFlt(p_lacunarity);
-   bool turbulent = AiShaderEvalParamBool(p_turbulent);
-   bool ridged = AiShaderEvalParamBool(p_ridged);
-   bool damp = AiShaderEvalParamBool(p_dampen_output);
-   bool remap_output = AiShaderEvalParamBool(p_remap_output);
+   // pre-evaluated output over the bake bounds, only when the output only
+   // depends on the object space position (see node_update)
+   BakedGrid *grid;
+   // sparse cache of the output around the shaded points, same conditions
+   // as the baked grid but for any input (volumes)
+   BrickCache *bricks;
+   FractalBakeSource bakeSource;
+   BakeInterpolation bakeInterpolation;
+   // largest input offset from the last sample evaluated by a thread for it
+   // to be reused, 0 when disabled (see node_update)
+   float reuseDistance;
+   ThreadSampleReuse reuse[AI_MAX_THREADS];
+   // grid, bricks or reused samples lookups, indexed by sg->tid
+   CacheCounters cacheCounters[AI_MAX_THREADS];
    
-   float out = 0.0f;
+   FractalData()
+      : grid(0)
+      , bricks(0)
+      , bakeInterpolation(BI_linear)
+      , reuseDistance(0.0f)
+   {
+   }
+   
+   ~FractalData()
+   {
+      resetCache();
+   }
    
-   if (turbulent)
+   void resetCache()
    {
-      if (ridged)
+      delete grid;
+      grid = 0;
+      delete bricks;
+      bricks = 0;
+      reuseDistance = 0.0f;
+      for (int i=0; i<AI_MAX_THREADS; ++i)
       {
-         fBm<TNoise, CombineModifier<TurbulenceModifier, RidgeModifier> > fbm(octaves, amplitude, persistence, frequency, lacunarity);
-         SetupNoise(node, sg, fbm);
-         SetupModifier(node, sg, fbm);
-         out = fbm.eval(P, damp);
+         reuse[i].sample.reset();
+         cacheCounters[i].hits = 0;
+         cacheCounters[i].misses = 0;
+      }
+   }
+   
+   inline bool cached() const
+   {
+      return (grid != 0 || bricks != 0);
+   }
+   
+   inline bool reusing() const
+   {
+      return (reuseDistance > 0.0f);
+   }
+   
+   inline float cachedEval(int tid, const Vec3 &P)
+   {
+      float out = 0.0f;
+      bool hit = false;
+      
+      if (grid)
+      {
+         if (grid->contains(P))
+         {
+            out = grid->lookup(bakeSource, P, bakeInterpolation);
+            hit = true;
+         }
       }
       else
       {
-         fBm<TNoise, TurbulenceModifier> fbm(octaves, amplitude, persistence, frequency, lacunarity);
-         SetupNoise(node, sg, fbm);
-         SetupModifier(node, sg, fbm);
-         out = fbm.eval(P, damp);
+         hit = bricks->lookup(bakeSource, P, &out);
       }
-   }
-   else
-   {
-      if (ridged)
+      
+      if (hit)
       {
-         fBm<TNoise, RidgeModifier> fbm(octaves, amplitude, persistence, frequency, lacunarity);
-         SetupNoise(node, sg, fbm);
-         SetupModifier(node, sg, fbm);
-         out = fbm.eval(P, damp);
+         ++cacheCounters[tid].hits;
       }
       else
       {
-         fBm<TNoise, DefaultModifier> fbm(octaves, amplitude, persistence, frequency, lacunarity);
-         SetupNoise(node, sg, fbm);
-         SetupModifier(node, sg, fbm);
-         out = fbm.eval(P, damp);
+         ++cacheCounters[tid].misses;
+         out = evaluator->eval(P, 0.0f);
       }
+      
+      return out;
    }
    
-   if (remap_output)
+   inline float reusedEval(const AtShaderGlobals *sg, const Vec3 &P, ShaderSample &sample)
    {
-      float fractal_min = AiShaderEvalParamFlt(p_fractal_min);
-      float fractal_max = AiShaderEvalParamFlt(p_fractal_max);
-      float output_min = AiShaderEvalParamFlt(p_output_min);
-      float output_max = AiShaderEvalParamFlt(p_output_max);
-      bool clamp_output = AiShaderEvalParamBool(p_clamp_output);
+      int tid = sg->tid;
+      ShadingPointKey key;
+      bool reused = false;
       
-      out = output_min + (output_max - output_min) * (out - fractal_min) / (fractal_max - fractal_min);
+      key.object = sg->Op;
+      key.primitive = sg->fi;
+      key.bu = sg->bu;
+      key.bv = sg->bv;
+      key.x = sg->x;
+      key.y = sg->y;
+      key.sample = sg->si;
       
-      if (clamp_output)
+      float out = reuse[tid].sample.eval(evaluator, key, sg->time, P, reuseDistance, reused);
+      
+      if (reused)
+      {
+         ++cacheCounters[tid].hits;
+      }
+      else
       {
-         out = AiClamp(out, output_min, output_max);
+         ++cacheCounters[tid].misses;
+         if (sample.counting())
+         {
+            sample.addOctaves(EvaluatedOctaves(values, 0.0f));
+         }
       }
+      
+      return out;
    }
-   
-   return out;
-}
-
-namespace SSTR
-{
-   extern AtString input;
-   extern AtString custom_input;
-   extern AtString base_noise;
-   extern AtString linkable;
-}
+};
 
-node_parameters
+static void ReportCacheStats(AtNode *node, const FractalData *data)
 {
-   AiParameterEnum(SSTR::input, I_P, InputNames);
-   AiParameterVec(SSTR::custom_input, 0.0f, 0.0f, 0.0f);
+   if (!data->cached() && !data->reusing())
+   {
+      return;
+   }
+   
+   uint64_t hits = 0;
+   uint64_t misses = 0;
+   
+   for (int i=0; i<AI_MAX_THREADS; ++i)
+   {
+      hits += data->cacheCounters[i].hits;
+      misses += data->cacheCounters[i].misses;
+   }
+   
+   if (hits + misses == 0)
+   {
+      return;
+   }
    
-   AiParameterFlt("amplitude", 1.0f);
-   AiParameterFlt("frequency", 1.0f);
-   AiParameterInt("octaves", 6);
-   AiParameterFlt("persistence", 0.5f);
-   AiParameterFlt("lacunarity", 2.0f);
-   AiParameterEnum(SSTR::base_noise, NT_simplex, NoiseTypeNames);
-   AiParameterInt("value_seed", 0);
-   AiParameterEnum("value_quality", NQ_std, NoiseQualityNames);
-   AiParameterInt("perlin_seed", 0);
-   AiParameterEnum("perlin_quality", NQ_std, NoiseQualityNames);
-   AiParameterFlt("flow_power", 0.25f);
-   AiParameterFlt("flow_time", 0.0f);
-   AiParameterBool("turbulent", false);
-   AiParameterFlt("turbulence_offset", -0.5f);
-   AiParameterFlt("turbulence_scale", 2.0f);
-   AiParameterBool("ridged", false);
-   AiParameterFlt("ridge_offset", 1.0f);
-   AiParameterFlt("ridge_gain", 2.0f);
-   AiParameterFlt("ridge_exponent", 0.0f);
-   AiParameterBool("dampen_output", true);
-   AiParameterBool("remap_output", true);
-   AiParameterFlt("fractal_min", -1.0f);
-   AiParameterFlt("fractal_max", 1.0f);
-   AiParameterFlt("output_min", 0.0f);
-   AiParameterFlt("output_max", 1.0f);
-   AiParameterBool("clamp_output", true);
+   if (data->grid)
+   {
+      AiMsgInfo("[fractal] %s: baked grid %llu hits, %llu out of bounds (%.2f%% hit rate), %llu/%llu tiles, %.2f MB",
+                AiNodeGetName(node), (unsigned long long) hits, (unsigned long long) misses,
+                100.0 * double(hits) / double(hits + misses),
+                (unsigned long long) data->grid->populatedTiles(), (unsigned long long) data->grid->tiles(),
+                double(data->grid->bytes()) / (1024.0 * 1024.0));
+   }
+   else if (data->bricks)
+   {
+      AiMsgInfo("[fractal] %s: volume cache %llu hits, %llu misses (%.2f%% hit rate), %llu/%llu bricks, %.2f MB",
+                AiNodeGetName(node), (unsigned long long) hits, (unsigned long long) misses,
+                100.0 * double(hits) / double(hits + misses),
+                (unsigned long long) data->bricks->bricks(), (unsigned long long) data->bricks->maxBricks(),
+                double(data->bricks->bytes()) / (1024.0 * 1024.0));
+   }
+   else
+   {
+      AiMsgInfo("[fractal] %s: motion reuse %llu reused, %llu evaluated (%.2f%% reuse rate)",
+                AiNodeGetName(node), (unsigned long long) hits, (unsigned long long) misses,
+                100.0 * double(hits) / double(hits + misses));
+   }
 }
 
-struct FractalData
-{
-   Input input;
-   bool evalCustomInput;
-   NoiseType type;
-};
-
 node_initialize
 {
    AiNodeSetLocalData(node, new FractalData());
@@ -245,48 +255,174 @@ node_initialize
 node_update
 {
    FractalData *data = (FractalData*) AiNodeGetLocalData(node);
-
-   data->input = (Input) AiNodeGetInt(node, SSTR::input);
-   data->evalCustomInput = AiNodeIsLinked(node, SSTR::custom_input);
-   data->type = (NoiseType) AiNodeGetInt(node, SSTR::base_noise);
+   
+   ReportCacheStats(node, data);
+   data->resetCache();
+   data->stats.update("fractal", node);
+   data->update(node);
+   
+   const FractalValues &values = data->values;
+   uint64_t linked = data->linked;
+   
+   // Bake the fractal output when it is a static function of the object
+   // space position, remapping is still applied per sample
+   if (AiNodeGetBool(node, SSTR::bake))
+   {
+      if ((linked & ~RemapParamsMask) != 0 || data->evalCustomInput ||
+          (data->input != I_Po && data->input != I_Pref) || data->autoOctaves)
+      {
+         AiMsgWarning("[fractal] %s: baking requires constant fractal parameters, Po or Pref input and auto_octaves off. Evaluating directly.",
+                      AiNodeGetName(node));
+      }
+      else
+      {
+         float spacing = BakeSpacing(values);
+         size_t maxBytes = size_t(std::max(0.0f, AiNodeGetFlt(node, SSTR::bake_memory)) * 1024.0f * 1024.0f);
+         
+         data->bakeSource.bind(data->evaluator);
+         data->bakeInterpolation = (BakeInterpolation) AiNodeGetInt(node, SSTR::bake_interpolation);
+         data->grid = new BakedGrid(ToVec3(AiNodeGetVec(node, SSTR::bake_bound_min)),
+                                    ToVec3(AiNodeGetVec(node, SSTR::bake_bound_max)),
+                                    spacing, maxBytes);
+         
+         if (!data->grid->valid())
+         {
+            AiMsgWarning("[fractal] %s: invalid bake bounds or memory budget. Evaluating directly.", AiNodeGetName(node));
+            delete data->grid;
+            data->grid = 0;
+         }
+         else
+         {
+            if (data->grid->spacing() > spacing)
+            {
+               AiMsgWarning("[fractal] %s: bake memory budget too small to resolve the finest octaves (spacing %f instead of %f)",
+                            AiNodeGetName(node), data->grid->spacing(), spacing);
+            }
+            AiMsgInfo("[fractal] %s: baking %dx%dx%d samples on demand (%.2f MB when fully populated)",
+                      AiNodeGetName(node), data->grid->resolution(0), data->grid->resolution(1), data->grid->resolution(2),
+                      double(data->grid->tiles() * (BakedGrid::TileBytes + sizeof(float*))) / (1024.0 * 1024.0));
+         }
+      }
+   }
+   
+   // Otherwise cache the output in bricks around the shaded points, the
+   // output doesn't need to be a static function of the object space
+   // position, only of the input
+   if (!data->grid && AiNodeGetBool(node, SSTR::volume_cache))
+   {
+      if ((linked & ~RemapParamsMask) != 0 || data->autoOctaves)
+      {
+         AiMsgWarning("[fractal] %s: volume cache requires constant fractal parameters and auto_octaves off. Evaluating directly.",
+                      AiNodeGetName(node));
+      }
+      else
+      {
+         size_t maxBytes = size_t(std::max(0.0f, AiNodeGetFlt(node, SSTR::volume_cache_memory)) * 1024.0f * 1024.0f);
+         
+         data->bakeSource.bind(data->evaluator);
+         data->bricks = new BrickCache(1, BakeSpacing(values), maxBytes);
+         
+         if (!data->bricks->valid())
+         {
+            AiMsgWarning("[fractal] %s: invalid volume cache memory budget. Evaluating directly.", AiNodeGetName(node));
+            delete data->bricks;
+            data->bricks = 0;
+         }
+      }
+   }
+   
+   // Otherwise reuse the last sample of each thread when the same vertex
+   // is displaced at another motion key (see FractalSampleReuse). Only the
+   // output gradient is needed, so the same constraints as the volume cache
+   // apply, and the gradient must be cheap enough to pay for itself.
+   if (!data->cached() && AiNodeGetBool(node, SSTR::motion_reuse))
+   {
+      if ((linked & ~RemapParamsMask) != 0 || data->autoOctaves)
+      {
+         AiMsgWarning("[fractal] %s: motion reuse requires constant fractal parameters and auto_octaves off. Evaluating directly.",
+                      AiNodeGetName(node));
+      }
+      else if (!data->evaluator->analyticGradient())
+      {
+         AiMsgWarning("[fractal] %s: motion reuse requires a noise with an analytic gradient (value, perlin or simplex). Evaluating directly.",
+                      AiNodeGetName(node));
+      }
+      else
+      {
+         data->reuseDistance = ReuseDistance(values, AiNodeGetFlt(node, SSTR::motion_reuse_distance));
+         
+         if (data->reuseDistance <= 0.0f)
+         {
+            AiMsgWarning("[fractal] %s: invalid motion reuse distance. Evaluating directly.", AiNodeGetName(node));
+         }
+      }
+   }
 }
 
 node_finish
 {
    FractalData *data = (FractalData*) AiNodeGetLocalData(node);
+   ReportCacheStats(node, data);
+   data->stats.report("fractal", node);
    delete data;
 }
 
 shader_evaluate
 {
    FractalData *data = (FractalData*) AiNodeGetLocalData(node);
+   ShaderSample sample(data->stats, sg->tid);
    
-   AtVector P;
-   if (data->evalCustomInput)
+   AtVector P = data->evalInput(node, sg);
+   
+   // motion keys are only shaded for the same point in displacement
+   if (data->cached() || (data->reusing() && sg->sc == AI_CONTEXT_DISPLACEMENT))
    {
-      P = AiShaderEvalParamVec(p_custom_input);
+      float out = (data->cached() ? data->cachedEval(sg->tid, ToVec3(P))
+                                  : data->reusedEval(sg, ToVec3(P), sample));
+      
+      if (data->linked == 0)
+      {
+         sg->out.FLT() = Remap(data->values, out);
+      }
+      else
+      {
+         // only remap parameters can be linked
+         FractalValues values = data->values;
+         EvalLinkedParams(node, sg, data->linked, values);
+         sg->out.FLT() = Remap(values, out);
+      }
+      return;
    }
-   else
+   
+   float filterWidth = data->filterWidth(sg);
+   
+   if (data->linked == 0)
    {
-      P = GetInput(data->input, sg, node);
+      if (sample.counting())
+      {
+         sample.addOctaves(EvaluatedOctaves(data->values, filterWidth));
+      }
+      sg->out.FLT() = Remap(data->values, data->evaluator->eval(ToVec3(P), filterWidth));
    }
-   
-   switch (data->type)
+   else
    {
-   case NT_value:
-      sg->out.FLT() = EvalNoise<ValueNoise>(node, sg, P);
-      break;
-   case NT_perlin:
-      sg->out.FLT() = EvalNoise<PerlinNoise>(node, sg, P);
-      break;
-   case NT_flow:
-      sg->out.FLT() = EvalNoise<FlowNoise>(node, sg, P);
-      break;
-   case NT_simplex:
-   default:
-      sg->out.FLT() = EvalNoise<SimplexNoise>(node, sg, P);
-      break;
+      FractalValues values = data->values;
+      
+      EvalLinkedParams(node, sg, data->linked, values);
+      
+      if (sample.counting())
+      {
+         sample.addOctaves(EvaluatedOctaves(values, filterWidth));
+      }
+      
+      if ((data->linked & ~RemapParamsMask) == 0)
+      {
+         sg->out.FLT() = Remap(values, data->evaluator->eval(ToVec3(P), filterWidth));
+      }
+      else
+      {
+         const FractalEvaluator *evaluator = data->evaluators[ModifierIndex(values.turbulent, values.ridged)];
+         sg->out.FLT() = Remap(values, evaluator->eval(values, ToVec3(P), filterWidth));
+      }
    }
 }
-
-
@@ -0,0 +1,188 @@
+/*
+MIT License
+
+Copyright (c) 2016 Gaetan Guidet
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "fractal_common.h"
+
+AI_SHADER_NODE_EXPORT_METHODS(FractalBumpMtd);
+
+// Bump maps with the fractal output gradient, computed along with the output
+// in a single evaluation (see fBm::eval)
+
+enum FractalBumpParams
+{
+   p_bump_height = p_fractal_last,
+   p_output
+};
+
+enum BumpOutput
+{
+   BO_normal = 0,
+   BO_gradient
+};
+
+static const char *BumpOutputNames[] =
+{
+   "normal",
+   "gradient",
+   NULL
+};
+
+namespace SSTR
+{
+   extern AtString bump_height;
+   extern AtString output;
+}
+
+node_parameters
+{
+   DeclareFractalParameters(params);
+   
+   AiParameterFlt(SSTR::bump_height, 1.0f);
+   AiParameterEnum(SSTR::output, BO_normal, BumpOutputNames);
+}
+
+struct FractalBumpData : public FractalNodeData
+{
+   float bumpHeight;
+   bool evalBumpHeight;
+   BumpOutput output;
+};
+
+// Gradient of the output with respect to the input to world space
+static AtVector InputGradientToWorld(const FractalBumpData *data, AtShaderGlobals *sg, const Vec3 &grad)
+{
+   AtVector G = ToAtVector(grad);
+   
+   if (data->evalCustomInput)
+   {
+      // unknown input space, assume world
+      return G;
+   }
+   
+   switch (data->input)
+   {
+   case I_Po:
+      // Po = Minv * P, the gradient transforms as a normal
+      return AiM4VectorByMatrixTMult(sg->Minv, G);
+   case I_UV:
+      {
+         // exact for orthogonal dPdu and dPdv
+         float lu = AiV3Dot(sg->dPdu, sg->dPdu);
+         float lv = AiV3Dot(sg->dPdv, sg->dPdv);
+         AtVector W(0.0f, 0.0f, 0.0f);
+         if (lu > 0.0f)
+         {
+            W += sg->dPdu * (G.x / lu);
+         }
+         if (lv > 0.0f)
+         {
+            W += sg->dPdv * (G.y / lv);
+         }
+         return W;
+      }
+   case I_Pref:
+      // Pref to world transform is unknown, assume it is close to P
+   case I_P:
+   default:
+      return G;
+   }
+}
+
+node_initialize
+{
+   AiNodeSetLocalData(node, new FractalBumpData());
+}
+
+node_update
+{
+   FractalBumpData *data = (FractalBumpData*) AiNodeGetLocalData(node);
+   
+   data->stats.update("fractal_bump", node);
+   data->update(node);
+   
+   data->bumpHeight = AiNodeGetFlt(node, SSTR::bump_height);
+   data->evalBumpHeight = AiNodeIsLinked(node, SSTR::bump_height);
+   data->output = (BumpOutput) AiNodeGetInt(node, SSTR::output);
+}
+
+node_finish
+{
+   FractalBumpData *data = (FractalBumpData*) AiNodeGetLocalData(node);
+   data->stats.report("fractal_bump", node);
+   delete data;
+}
+
+shader_evaluate
+{
+   FractalBumpData *data = (FractalBumpData*) AiNodeGetLocalData(node);
+   ShaderSample sample(data->stats, sg->tid);
+   
+   Vec3 P = ToVec3(data->evalInput(node, sg));
+   float filterWidth = data->filterWidth(sg);
+   Vec3 grad;
+   
+   if (data->linked == 0)
+   {
+      if (sample.counting())
+      {
+         sample.addOctaves(EvaluatedOctaves(data->values, filterWidth));
+      }
+      Remap(data->values, data->evaluator->eval(P, filterWidth, grad), grad);
+   }
+   else
+   {
+      FractalValues values = data->values;
+      
+      EvalLinkedParams(node, sg, data->linked, values);
+      
+      if (sample.counting())
+      {
+         sample.addOctaves(EvaluatedOctaves(values, filterWidth));
+      }
+      
+      if ((data->linked & ~RemapParamsMask) == 0)
+      {
+         Remap(values, data->evaluator->eval(P, filterWidth, grad), grad);
+      }
+      else
+      {
+         const FractalEvaluator *evaluator = data->evaluators[ModifierIndex(values.turbulent, values.ridged)];
+         Remap(values, evaluator->eval(values, P, filterWidth, grad), grad);
+      }
+   }
+   
+   float height = (data->evalBumpHeight ? AiShaderEvalParamFlt(p_bump_height) : data->bumpHeight);
+   AtVector G = height * InputGradientToWorld(data, sg, grad);
+   
+   if (data->output == BO_gradient)
+   {
+      sg->out.VEC() = G;
+   }
+   else
+   {
+      // Offsetting the surface by height * output along N tilts the normal by
+      // the tangential part of the gradient
+      sg->out.VEC() = AiV3Normalize(sg->N - (G - AiV3Dot(G, sg->N) * sg->N));
+   }
+}
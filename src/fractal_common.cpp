@@ -0,0 +1,227 @@
+/*
+MIT License
+
+Copyright (c) 2016 Gaetan Guidet
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "fractal_common.h"
+
+// Read parameter value and keep track of whether it is linked or not
+
+static inline void UpdateParam(AtNode *node, const AtString &name, FractalParams p, float &value, uint64_t &linked)
+{
+   value = AiNodeGetFlt(node, name);
+   if (AiNodeIsLinked(node, name))
+   {
+      linked |= ParamBit(p);
+   }
+}
+
+static inline void UpdateParam(AtNode *node, const AtString &name, FractalParams p, int &value, uint64_t &linked)
+{
+   value = AiNodeGetInt(node, name);
+   if (AiNodeIsLinked(node, name))
+   {
+      linked |= ParamBit(p);
+   }
+}
+
+static inline void UpdateParam(AtNode *node, const AtString &name, FractalParams p, bool &value, uint64_t &linked)
+{
+   value = AiNodeGetBool(node, name);
+   if (AiNodeIsLinked(node, name))
+   {
+      linked |= ParamBit(p);
+   }
+}
+
+void DeclareFractalParameters(AtList *params)
+{
+   AiParameterEnum(SSTR::input, I_P, InputNames);
+   AiParameterVec(SSTR::custom_input, 0.0f, 0.0f, 0.0f);
+   
+   AiParameterFlt(SSTR::amplitude, 1.0f);
+   AiParameterFlt(SSTR::frequency, 1.0f);
+   AiParameterFlt(SSTR::octaves, 6.0f);
+   AiParameterFlt(SSTR::persistence, 0.5f);
+   AiParameterFlt(SSTR::lacunarity, 2.0f);
+   AiParameterEnum(SSTR::base_noise, NT_simplex, NoiseTypeNames);
+   AiParameterInt(SSTR::value_seed, 0);
+   AiParameterEnum(SSTR::value_quality, NQ_std, NoiseQualityNames);
+   AiParameterInt(SSTR::perlin_seed, 0);
+   AiParameterEnum(SSTR::perlin_quality, NQ_std, NoiseQualityNames);
+   AiParameterFlt(SSTR::flow_power, 0.25f);
+   AiParameterFlt(SSTR::flow_time, 0.0f);
+   AiParameterBool(SSTR::turbulent, false);
+   AiParameterFlt(SSTR::turbulence_offset, -0.5f);
+   AiParameterFlt(SSTR::turbulence_scale, 2.0f);
+   AiParameterBool(SSTR::ridged, false);
+   AiParameterFlt(SSTR::ridge_offset, 1.0f);
+   AiParameterFlt(SSTR::ridge_gain, 2.0f);
+   AiParameterFlt(SSTR::ridge_exponent, 0.0f);
+   AiParameterBool(SSTR::dampen_output, true);
+   AiParameterBool(SSTR::remap_output, true);
+   AiParameterFlt(SSTR::fractal_min, -1.0f);
+   AiParameterFlt(SSTR::fractal_max, 1.0f);
+   AiParameterFlt(SSTR::output_min, 0.0f);
+   AiParameterFlt(SSTR::output_max, 1.0f);
+   AiParameterBool(SSTR::clamp_output, true);
+   AiParameterBool(SSTR::auto_octaves, false);
+   AiParameterFlt(SSTR::auto_octaves_scale, 1.0f);
+   AiParameterFlt(SSTR::amplitude_threshold, 0.0f);
+   AiParameterInt(SSTR::simplex_seed, 0);
+   AiParameterInt(SSTR::flow_seed, 0);
+   AiParameterEnum(SSTR::lattice_hash, NH_legacy, NoiseHashNames);
+   AiParameterFlt(SSTR::time, 0.0f);
+}
+
+FractalNodeData::FractalNodeData()
+   : evaluator(0)
+   , permutation(0)
+{
+   for (int i=0; i<4; ++i)
+   {
+      evaluators[i] = 0;
+   }
+}
+
+FractalNodeData::~FractalNodeData()
+{
+   resetEvaluators();
+   ReleasePermutationTable(permutation);
+}
+
+void FractalNodeData::resetEvaluators()
+{
+   for (int i=0; i<4; ++i)
+   {
+      delete evaluators[i];
+      evaluators[i] = 0;
+   }
+   evaluator = 0;
+}
+
+void FractalNodeData::update(AtNode *node)
+{
+   uint64_t linked = 0;
+   
+   input = (Input) AiNodeGetInt(node, SSTR::input);
+   evalCustomInput = AiNodeIsLinked(node, SSTR::custom_input);
+   
+   if (input == I_Pref && !evalCustomInput)
+   {
+      ResetMissingPref();
+   }
+   
+   type = (NoiseType) AiNodeGetInt(node, SSTR::base_noise);
+   autoOctaves = AiNodeGetBool(node, SSTR::auto_octaves);
+   autoOctavesScale = AiNodeGetFlt(node, SSTR::auto_octaves_scale);
+   
+   UpdateParam(node, SSTR::amplitude, p_amplitude, values.amplitude, linked);
+   UpdateParam(node, SSTR::frequency, p_frequency, values.frequency, linked);
+   UpdateParam(node, SSTR::octaves, p_octaves, values.octaves, linked);
+   UpdateParam(node, SSTR::persistence, p_persistence, values.persistence, linked);
+   UpdateParam(node, SSTR::lacunarity, p_lacunarity, values.lacunarity, linked);
+   UpdateParam(node, SSTR::value_seed, p_value_seed, values.value_seed, linked);
+   UpdateParam(node, SSTR::perlin_seed, p_perlin_seed, values.perlin_seed, linked);
+   UpdateParam(node, SSTR::flow_power, p_flow_power, values.flow_power, linked);
+   UpdateParam(node, SSTR::flow_time, p_flow_time, values.flow_time, linked);
+   UpdateParam(node, SSTR::time, p_time, values.time, linked);
+   UpdateParam(node, SSTR::turbulent, p_turbulent, values.turbulent, linked);
+   UpdateParam(node, SSTR::turbulence_offset, p_turbulence_offset, values.turbulence_offset, linked);
+   UpdateParam(node, SSTR::turbulence_scale, p_turbulence_scale, values.turbulence_scale, linked);
+   UpdateParam(node, SSTR::ridged, p_ridged, values.ridged, linked);
+   UpdateParam(node, SSTR::ridge_offset, p_ridge_offset, values.ridge_offset, linked);
+   UpdateParam(node, SSTR::ridge_gain, p_ridge_gain, values.ridge_gain, linked);
+   UpdateParam(node, SSTR::ridge_exponent, p_ridge_exponent, values.ridge_exponent, linked);
+   UpdateParam(node, SSTR::dampen_output, p_dampen_output, values.dampen_output, linked);
+   UpdateParam(node, SSTR::remap_output, p_remap_output, values.remap_output, linked);
+   UpdateParam(node, SSTR::fractal_min, p_fractal_min, values.fractal_min, linked);
+   UpdateParam(node, SSTR::fractal_max, p_fractal_max, values.fractal_max, linked);
+   UpdateParam(node, SSTR::output_min, p_output_min, values.output_min, linked);
+   UpdateParam(node, SSTR::output_max, p_output_max, values.output_max, linked);
+   UpdateParam(node, SSTR::clamp_output, p_clamp_output, values.clamp_output, linked);
+   UpdateParam(node, SSTR::amplitude_threshold, p_amplitude_threshold, values.amplitude_threshold, linked);
+   
+   // quality parameters are not linkable
+   values.value_quality = (NoiseQuality) AiNodeGetInt(node, SSTR::value_quality);
+   values.perlin_quality = (NoiseQuality) AiNodeGetInt(node, SSTR::perlin_quality);
+   values.lattice_hash = (NoiseHash) AiNodeGetInt(node, SSTR::lattice_hash);
+   
+   // neither are simplex and flow seeds, their permutation tables are built
+   // once and shared with other nodes
+   const PermutationTable *newPermutation = AcquireNoisePermutation(node, type);
+   ReleasePermutationTable(permutation);
+   permutation = newPermutation;
+   values.permutation = newPermutation;
+   
+   // Don't bother evaluating parameters that won't be used
+   if (type != NT_value)
+   {
+      linked &= ~ParamBit(p_value_seed);
+   }
+   if (type != NT_perlin)
+   {
+      linked &= ~ParamBit(p_perlin_seed);
+   }
+   if (type != NT_flow)
+   {
+      linked &= ~(ParamBit(p_flow_power) | ParamBit(p_flow_time));
+   }
+   if (type != NT_simplex4d)
+   {
+      linked &= ~ParamBit(p_time);
+   }
+   if (!values.turbulent && !(linked & ParamBit(p_turbulent)))
+   {
+      linked &= ~(ParamBit(p_turbulence_offset) | ParamBit(p_turbulence_scale));
+   }
+   if (!values.ridged && !(linked & ParamBit(p_ridged)))
+   {
+      linked &= ~(ParamBit(p_ridge_offset) | ParamBit(p_ridge_gain) | ParamBit(p_ridge_exponent));
+   }
+   if (!values.remap_output && !(linked & ParamBit(p_remap_output)))
+   {
+      linked &= ~(ParamBit(p_fractal_min) | ParamBit(p_fractal_max) | ParamBit(p_output_min) | ParamBit(p_output_max) | ParamBit(p_clamp_output));
+   }
+   
+   this->linked = linked;
+   
+   // Bind fBm specialization(s)
+   resetEvaluators();
+   
+   if (linked & (ParamBit(p_turbulent) | ParamBit(p_ridged)))
+   {
+      for (int i=0; i<4; ++i)
+      {
+         evaluators[i] = CreateEvaluator(type, i);
+         evaluators[i]->setup(values);
+      }
+   }
+   else
+   {
+      int i = ModifierIndex(values.turbulent, values.ridged);
+      evaluators[i] = CreateEvaluator(type, i);
+      evaluators[i]->setup(values);
+   }
+   
+   evaluator = evaluators[ModifierIndex(values.turbulent, values.ridged)];
+}
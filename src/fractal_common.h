@@ -0,0 +1,230 @@
+/*
+MIT License
+
+Copyright (c) 2016 Gaetan Guidet
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __noise_fractal_common_h__
+#define __noise_fractal_common_h__
+
+// Parameters and update logic shared by the fractal and fractal_bump nodes
+
+#include "common.h"
+#include "kernels/fractal.h"
+
+enum FractalParams
+{
+   p_input = 0,
+   p_custom_input,
+   
+   // fBm parameters
+   p_amplitude,
+   p_frequency,
+   p_octaves,
+   p_persistence,
+   p_lacunarity,
+   
+   p_base_noise,
+   // value noise parameters
+   p_value_seed,
+   p_value_quality,
+   // perlin noise parameters
+   p_perlin_seed,
+   p_perlin_quality,
+   // flow noise parameters
+   p_flow_power,
+   p_flow_time,
+   
+   p_turbulent,
+   // turbulence params
+   p_turbulence_offset,
+   p_turbulence_scale,
+   
+   p_ridged,
+   // ridge params
+   p_ridge_offset,
+   p_ridge_gain,
+   p_ridge_exponent,
+   
+   p_dampen_output,
+   
+   p_remap_output,
+   p_fractal_min,
+   p_fractal_max,
+   p_output_min,
+   p_output_max,
+   p_clamp_output,
+   
+   p_auto_octaves,
+   p_auto_octaves_scale,
+   p_amplitude_threshold,
+   
+   p_simplex_seed,
+   p_flow_seed,
+   
+   p_lattice_hash,
+   
+   // simplex4d noise parameters
+   p_time,
+   
+   // first parameter specific to a node
+   p_fractal_last
+};
+
+namespace SSTR
+{
+   extern AtString input;
+   extern AtString custom_input;
+   extern AtString base_noise;
+   extern AtString linkable;
+   extern AtString amplitude;
+   extern AtString frequency;
+   extern AtString octaves;
+   extern AtString persistence;
+   extern AtString lacunarity;
+   extern AtString value_seed;
+   extern AtString value_quality;
+   extern AtString perlin_seed;
+   extern AtString perlin_quality;
+   extern AtString flow_power;
+   extern AtString flow_time;
+   extern AtString turbulent;
+   extern AtString turbulence_offset;
+   extern AtString turbulence_scale;
+   extern AtString ridged;
+   extern AtString ridge_offset;
+   extern AtString ridge_gain;
+   extern AtString ridge_exponent;
+   extern AtString dampen_output;
+   extern AtString remap_output;
+   extern AtString fractal_min;
+   extern AtString fractal_max;
+   extern AtString output_min;
+   extern AtString output_max;
+   extern AtString clamp_output;
+   extern AtString auto_octaves;
+   extern AtString auto_octaves_scale;
+   extern AtString amplitude_threshold;
+   extern AtString simplex_seed;
+   extern AtString flow_seed;
+   extern AtString lattice_hash;
+   extern AtString time;
+}
+
+inline uint64_t ParamBit(FractalParams p)
+{
+   return (uint64_t(1) << p);
+}
+
+// Parameters only used when remapping fractal output
+static const uint64_t RemapParamsMask = ParamBit(p_remap_output) |
+                                        ParamBit(p_fractal_min) |
+                                        ParamBit(p_fractal_max) |
+                                        ParamBit(p_output_min) |
+                                        ParamBit(p_output_max) |
+                                        ParamBit(p_clamp_output);
+
+// Declare the FractalParams parameters, in enum order
+void DeclareFractalParameters(AtList *params);
+
+// Only re-evaluate linked parameters at shading time
+
+inline void EvalLinkedParams(AtNode *node, AtShaderGlobals *sg, uint64_t linked, FractalValues &values)
+{
+   if (linked & ParamBit(p_amplitude)) values.amplitude = AiShaderEvalParamFlt(p_amplitude);
+   if (linked & ParamBit(p_frequency)) values.frequency = AiShaderEvalParamFlt(p_frequency);
+   if (linked & ParamBit(p_octaves)) values.octaves = AiShaderEvalParamFlt(p_octaves);
+   if (linked & ParamBit(p_persistence)) values.persistence = AiShaderEvalParamFlt(p_persistence);
+   if (linked & ParamBit(p_lacunarity)) values.lacunarity = AiShaderEvalParamFlt(p_lacunarity);
+   if (linked & ParamBit(p_value_seed)) values.value_seed = AiShaderEvalParamInt(p_value_seed);
+   if (linked & ParamBit(p_perlin_seed)) values.perlin_seed = AiShaderEvalParamInt(p_perlin_seed);
+   if (linked & ParamBit(p_flow_power)) values.flow_power = AiShaderEvalParamFlt(p_flow_power);
+   if (linked & ParamBit(p_flow_time)) values.flow_time = AiShaderEvalParamFlt(p_flow_time);
+   if (linked & ParamBit(p_time)) values.time = AiShaderEvalParamFlt(p_time);
+   if (linked & ParamBit(p_turbulent)) values.turbulent = AiShaderEvalParamBool(p_turbulent);
+   if (linked & ParamBit(p_turbulence_offset)) values.turbulence_offset = AiShaderEvalParamFlt(p_turbulence_offset);
+   if (linked & ParamBit(p_turbulence_scale)) values.turbulence_scale = AiShaderEvalParamFlt(p_turbulence_scale);
+   if (linked & ParamBit(p_ridged)) values.ridged = AiShaderEvalParamBool(p_ridged);
+   if (linked & ParamBit(p_ridge_offset)) values.ridge_offset = AiShaderEvalParamFlt(p_ridge_offset);
+   if (linked & ParamBit(p_ridge_gain)) values.ridge_gain = AiShaderEvalParamFlt(p_ridge_gain);
+   if (linked & ParamBit(p_ridge_exponent)) values.ridge_exponent = AiShaderEvalParamFlt(p_ridge_exponent);
+   if (linked & ParamBit(p_dampen_output)) values.dampen_output = AiShaderEvalParamBool(p_dampen_output);
+   if (linked & ParamBit(p_remap_output)) values.remap_output = AiShaderEvalParamBool(p_remap_output);
+   if (linked & ParamBit(p_fractal_min)) values.fractal_min = AiShaderEvalParamFlt(p_fractal_min);
+   if (linked & ParamBit(p_fractal_max)) values.fractal_max = AiShaderEvalParamFlt(p_fractal_max);
+   if (linked & ParamBit(p_output_min)) values.output_min = AiShaderEvalParamFlt(p_output_min);
+   if (linked & ParamBit(p_output_max)) values.output_max = AiShaderEvalParamFlt(p_output_max);
+   if (linked & ParamBit(p_clamp_output)) values.clamp_output = AiShaderEvalParamBool(p_clamp_output);
+   if (linked & ParamBit(p_amplitude_threshold)) values.amplitude_threshold = AiShaderEvalParamFlt(p_amplitude_threshold);
+}
+
+// Node local data common to fractal shaders
+struct FractalNodeData
+{
+   Input input;
+   bool evalCustomInput;
+   NoiseType type;
+   // fade out octaves above the sample footprint's Nyquist limit
+   bool autoOctaves;
+   float autoOctavesScale;
+   // parameter values resolved at update time
+   FractalValues values;
+   // bit mask of the parameters that need to be evaluated per sample
+   uint64_t linked;
+   // fBm specializations indexed by ModifierIndex, all four are only
+   // allocated when either turbulent or ridged is linked
+   FractalEvaluator *evaluators[4];
+   // evaluator bound to the update time parameter values
+   FractalEvaluator *evaluator;
+   // simplex and flow noises seeded permutation (see AcquireNoisePermutation)
+   const PermutationTable *permutation;
+   ShaderStats stats;
+   
+   FractalNodeData();
+   ~FractalNodeData();
+   
+   // Read the FractalParams parameters and bind the fBm specialization(s)
+   void update(AtNode *node);
+   
+   void resetEvaluators();
+   
+   // Input point of the shading sample
+   inline AtVector evalInput(AtNode *node, AtShaderGlobals *sg) const
+   {
+      if (evalCustomInput)
+      {
+         return AiShaderEvalParamVec(p_custom_input);
+      }
+      else
+      {
+         return GetInput(input, sg, node);
+      }
+   }
+   
+   // Footprint of the shading sample when auto_octaves is on, 0 otherwise
+   inline float filterWidth(AtShaderGlobals *sg) const
+   {
+      // custom input derivatives are unknown, assume they match P's
+      return (autoOctaves ? autoOctavesScale * GetInputFilterWidth(evalCustomInput ? I_P : input, sg) : 0.0f);
+   }
+};
+
+#endif
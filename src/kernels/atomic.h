@@ -0,0 +1,156 @@
+/*
+MIT License
+
+Copyright (c) 2016 Gaetan Guidet
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __noise_kernels_atomic_h__
+#define __noise_kernels_atomic_h__
+
+// Minimal atomic operations used by the shared caches. Nothing in here
+// depends on Arnold.
+
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#endif
+
+// Cache slots are filled at most once and read without locking
+
+inline float* LoadSlot(float* volatile *slot)
+{
+#if defined(_MSC_VER)
+   float *data = *slot;
+   _ReadWriteBarrier();
+   return data;
+#else
+   return __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+#endif
+}
+
+// Returns false if another thread filled the slot first
+inline bool PublishSlot(float* volatile *slot, float *data)
+{
+#if defined(_MSC_VER)
+   return (_InterlockedCompareExchangePointer((void* volatile*)slot, data, 0) == 0);
+#else
+   return __sync_bool_compare_and_swap(slot, (float*)0, data);
+#endif
+}
+
+inline uint64_t LoadKey(volatile uint64_t *key)
+{
+#if defined(_MSC_VER)
+   uint64_t k = *key;
+   _ReadWriteBarrier();
+   return k;
+#else
+   return __atomic_load_n(key, __ATOMIC_ACQUIRE);
+#endif
+}
+
+// Returns false if the key isn't 0 anymore
+inline bool ClaimKey(volatile uint64_t *key, uint64_t k)
+{
+#if defined(_MSC_VER)
+   return (_InterlockedCompareExchange64((volatile __int64*)key, (__int64)k, 0) == 0);
+#else
+   return __sync_bool_compare_and_swap(key, (uint64_t)0, k);
+#endif
+}
+
+// Returns the incremented value
+inline uint64_t AtomicIncrement(volatile uint64_t *value)
+{
+#if defined(_MSC_VER)
+   return (uint64_t) _InterlockedIncrement64((volatile __int64*)value);
+#else
+   return __sync_add_and_fetch(value, (uint64_t)1);
+#endif
+}
+
+// Busy waiting lock, for short and infrequent critical sections
+class SpinLock
+{
+public:
+   
+   SpinLock()
+      : _locked(0)
+   {
+   }
+   
+   inline void lock()
+   {
+#if defined(_MSC_VER)
+      while (_InterlockedExchange(&_locked, 1) != 0)
+#else
+      while (__sync_lock_test_and_set(&_locked, 1) != 0)
+#endif
+      {
+         while (_locked != 0)
+         {
+         }
+      }
+   }
+   
+   inline void unlock()
+   {
+#if defined(_MSC_VER)
+      _InterlockedExchange(&_locked, 0);
+#else
+      __sync_lock_release(&_locked);
+#endif
+   }
+   
+private:
+   
+   SpinLock(const SpinLock&);
+   SpinLock& operator=(const SpinLock&);
+   
+   volatile long _locked;
+};
+
+// Lock for the lifetime of the object
+class ScopedSpinLock
+{
+public:
+   
+   ScopedSpinLock(SpinLock &lock)
+      : _lock(lock)
+   {
+      _lock.lock();
+   }
+   
+   ~ScopedSpinLock()
+   {
+      _lock.unlock();
+   }
+   
+private:
+   
+   ScopedSpinLock(const ScopedSpinLock&);
+   ScopedSpinLock& operator=(const ScopedSpinLock&);
+   
+   SpinLock &_lock;
+};
+
+#endif
@@ -0,0 +1,609 @@
+/*
+MIT License
+
+Copyright (c) 2016 Gaetan Guidet
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __noise_kernels_bake_h__
+#define __noise_kernels_bake_h__
+
+// Lazily populated caches of pre-evaluated noise values. Nothing in here
+// depends on Arnold.
+
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <stdint.h>
+#include "vec3.h"
+#include "atomic.h"
+
+enum BakeInterpolation
+{
+   BI_linear = 0,
+   BI_cubic
+};
+
+// What gets cached
+class BakeSource
+{
+public:
+   
+   virtual ~BakeSource()
+   {
+   }
+   
+   // Write the cache components count values at P to out
+   virtual void value(const Vec3 &P, float *out) const = 0;
+   
+   // Same for n points given as x, y and z arrays, components values per
+   // point. Caches populate through this, a tile or brick at a time
+   virtual void values(size_t n, const float *x, const float *y, const float *z, float *out) const = 0;
+};
+
+// Regular grid of single component samples over a bounding box, split in
+// tiles of 8x8x8 samples that are only evaluated when a lookup first touches
+// them.
+//
+// Shared by all shading threads: a tile evaluated concurrently by two threads
+// is simply computed twice and one of the copies discarded.
+class BakedGrid
+{
+public:
+   
+   static const int TileBits = 3;
+   static const int TileSize = (1 << TileBits);
+   static const int TileSamples = TileSize * TileSize * TileSize;
+   static const size_t TileBytes = TileSamples * sizeof(float);
+   
+   // spacing is the desired distance between samples, it is increased as
+   // needed for the fully populated grid to fit in maxBytes
+   BakedGrid(const Vec3 &bmin, const Vec3 &bmax, float spacing, size_t maxBytes)
+      : _min(bmin)
+      , _max(bmax)
+      , _spacing(0.0f)
+      , _invSpacing(0.0f)
+      , _numTiles(0)
+      , _tiles(0)
+   {
+      _count[0] = _count[1] = _count[2] = 0;
+      _tileCount[0] = _tileCount[1] = _tileCount[2] = 0;
+      
+      Vec3 extent = bmax - bmin;
+      
+      if (!(extent.x > 0.0f && extent.y > 0.0f && extent.z > 0.0f && spacing > 0.0f))
+      {
+         return;
+      }
+      
+      // never go below one tile per axis
+      float maxExtent = std::max(std::max(extent.x, extent.y), extent.z);
+      spacing = std::min(spacing, maxExtent / float(TileSize - 1));
+      
+      while (true)
+      {
+         size_t n[3] = {Count(extent.x, spacing), Count(extent.y, spacing), Count(extent.z, spacing)};
+         size_t tiles = ((n[0] + TileSize - 1) >> TileBits) *
+                        ((n[1] + TileSize - 1) >> TileBits) *
+                        ((n[2] + TileSize - 1) >> TileBits);
+         
+         if (tiles * (TileBytes + sizeof(float*)) <= maxBytes)
+         {
+            for (int i=0; i<3; ++i)
+            {
+               _count[i] = int(n[i]);
+               _tileCount[i] = int((n[i] + TileSize - 1) >> TileBits);
+            }
+            _numTiles = tiles;
+            break;
+         }
+         else if (tiles == 1)
+         {
+            // budget too small for a single tile
+            return;
+         }
+         
+         spacing *= 1.25f;
+      }
+      
+      _spacing = spacing;
+      _invSpacing = 1.0f / spacing;
+      
+      _tiles = new float* volatile[_numTiles];
+      for (size_t i=0; i<_numTiles; ++i)
+      {
+         _tiles[i] = 0;
+      }
+   }
+   
+   ~BakedGrid()
+   {
+      if (_tiles)
+      {
+         for (size_t i=0; i<_numTiles; ++i)
+         {
+            delete[] _tiles[i];
+         }
+         delete[] _tiles;
+      }
+   }
+   
+   inline bool valid() const
+   {
+      return (_tiles != 0);
+   }
+   
+   inline bool contains(const Vec3 &P) const
+   {
+      return (P.x >= _min.x && P.x <= _max.x &&
+              P.y >= _min.y && P.y <= _max.y &&
+              P.z >= _min.z && P.z <= _max.z);
+   }
+   
+   // P is expected to be inside the grid bounds (see contains)
+   float lookup(const BakeSource &src, const Vec3 &P, BakeInterpolation interpolation)
+   {
+      float fx = (P.x - _min.x) * _invSpacing;
+      float fy = (P.y - _min.y) * _invSpacing;
+      float fz = (P.z - _min.z) * _invSpacing;
+      
+      int x = Clamp(int(floorf(fx)), 0, _count[0] - 2);
+      int y = Clamp(int(floorf(fy)), 0, _count[1] - 2);
+      int z = Clamp(int(floorf(fz)), 0, _count[2] - 2);
+      
+      fx -= float(x);
+      fy -= float(y);
+      fz -= float(z);
+      
+      if (interpolation == BI_cubic)
+      {
+         float wx[4], wy[4], wz[4];
+         
+         CubicWeights(fx, wx);
+         CubicWeights(fy, wy);
+         CubicWeights(fz, wz);
+         
+         float out = 0.0f;
+         
+         for (int k=0; k<4; ++k)
+         {
+            int sz = Clamp(z + k - 1, 0, _count[2] - 1);
+            float outz = 0.0f;
+            
+            for (int j=0; j<4; ++j)
+            {
+               int sy = Clamp(y + j - 1, 0, _count[1] - 1);
+               float outy = 0.0f;
+               
+               for (int i=0; i<4; ++i)
+               {
+                  outy += wx[i] * sample(src, Clamp(x + i - 1, 0, _count[0] - 1), sy, sz);
+               }
+               
+               outz += wy[j] * outy;
+            }
+            
+            out += wz[k] * outz;
+         }
+         
+         return out;
+      }
+      else
+      {
+         float v00 = Lerp(fx, sample(src, x, y, z), sample(src, x + 1, y, z));
+         float v10 = Lerp(fx, sample(src, x, y + 1, z), sample(src, x + 1, y + 1, z));
+         float v01 = Lerp(fx, sample(src, x, y, z + 1), sample(src, x + 1, y, z + 1));
+         float v11 = Lerp(fx, sample(src, x, y + 1, z + 1), sample(src, x + 1, y + 1, z + 1));
+         
+         return Lerp(fz, Lerp(fy, v00, v10), Lerp(fy, v01, v11));
+      }
+   }
+   
+   inline float spacing() const
+   {
+      return _spacing;
+   }
+   
+   inline int resolution(int axis) const
+   {
+      return _count[axis];
+   }
+   
+   inline size_t tiles() const
+   {
+      return _numTiles;
+   }
+   
+   // Only accurate once no more lookups are running
+   size_t populatedTiles() const
+   {
+      size_t n = 0;
+      for (size_t i=0; i<_numTiles; ++i)
+      {
+         if (_tiles[i])
+         {
+            ++n;
+         }
+      }
+      return n;
+   }
+   
+   // Memory currently used by the grid
+   size_t bytes() const
+   {
+      return _numTiles * sizeof(float*) + populatedTiles() * TileBytes;
+   }
+   
+private:
+   
+   BakedGrid(const BakedGrid&);
+   BakedGrid& operator=(const BakedGrid&);
+   
+   static inline size_t Count(float extent, float spacing)
+   {
+      return size_t(ceilf(extent / spacing)) + 1;
+   }
+   
+   static inline float Lerp(float t, float a, float b)
+   {
+      return a + t * (b - a);
+   }
+   
+   // Catmull-Rom
+   static inline void CubicWeights(float t, float w[4])
+   {
+      w[0] = 0.5f * ((-t + 2.0f) * t - 1.0f) * t;
+      w[1] = 0.5f * ((3.0f * t - 5.0f) * t * t + 2.0f);
+      w[2] = 0.5f * ((-3.0f * t + 4.0f) * t + 1.0f) * t;
+      w[3] = 0.5f * (t - 1.0f) * t * t;
+   }
+   
+   inline float sample(const BakeSource &src, int x, int y, int z)
+   {
+      size_t t = (size_t(z >> TileBits) * _tileCount[1] + size_t(y >> TileBits)) * _tileCount[0] + size_t(x >> TileBits);
+      
+      float *tile = LoadSlot(&_tiles[t]);
+      
+      if (!tile)
+      {
+         tile = populate(src, t, x >> TileBits, y >> TileBits, z >> TileBits);
+      }
+      
+      return tile[((z & (TileSize - 1)) << (2 * TileBits)) | ((y & (TileSize - 1)) << TileBits) | (x & (TileSize - 1))];
+   }
+   
+   float* populate(const BakeSource &src, size_t t, int tx, int ty, int tz)
+   {
+      float *tile = new float[TileSamples];
+      float px[TileSamples];
+      float py[TileSamples];
+      float pz[TileSamples];
+      int i = 0;
+      
+      for (int z=0; z<TileSize; ++z)
+      {
+         float vz = _min.z + float((tz << TileBits) + z) * _spacing;
+         
+         for (int y=0; y<TileSize; ++y)
+         {
+            float vy = _min.y + float((ty << TileBits) + y) * _spacing;
+            
+            for (int x=0; x<TileSize; ++x, ++i)
+            {
+               px[i] = _min.x + float((tx << TileBits) + x) * _spacing;
+               py[i] = vy;
+               pz[i] = vz;
+            }
+         }
+      }
+      
+      src.values(TileSamples, px, py, pz, tile);
+      
+      if (!PublishSlot(&_tiles[t], tile))
+      {
+         delete[] tile;
+         tile = LoadSlot(&_tiles[t]);
+      }
+      
+      return tile;
+   }
+   
+   Vec3 _min;
+   Vec3 _max;
+   float _spacing;
+   float _invSpacing;
+   // samples per axis
+   int _count[3];
+   // tiles per axis
+   int _tileCount[3];
+   size_t _numTiles;
+   float* volatile *_tiles;
+};
+
+// Sparse cache of samples over unbounded space, for volumes.
+//
+// Space is split in bricks of 8x8x8 voxels allocated when first touched and
+// stored in a fixed size open addressing hash table keyed by the brick
+// coordinates. Bricks hold 9x9x9 samples (one sample overlap with their
+// neighbours) so a trilinear lookup only ever touches a single brick.
+//
+// Like BakedGrid, lookups never lock: the first thread to claim a brick key
+// evaluates it, other threads evaluate directly until it is published.
+class BrickCache
+{
+public:
+   
+   static const int BrickBits = 3;
+   static const int BrickSize = (1 << BrickBits);
+   static const int BrickSide = BrickSize + 1;
+   static const int BrickSamples = BrickSide * BrickSide * BrickSide;
+   // brick coordinates are packed in 21 bits each
+   static const int CoordBits = 21;
+   // give up inserting after that many collisions
+   static const int MaxProbes = 16;
+   
+   // spacing is the distance between samples, components the number of
+   // values written by the source
+   BrickCache(int components, float spacing, size_t maxBytes)
+      : _components(components)
+      , _spacing(spacing)
+      , _invSpacing(0.0f)
+      , _brickBytes(size_t(BrickSamples) * components * sizeof(float))
+      , _maxBricks(0)
+      , _numBricks(0)
+      , _mask(0)
+      , _keys(0)
+      , _bricks(0)
+   {
+      if (!(spacing > 0.0f) || components <= 0)
+      {
+         return;
+      }
+      
+      // keep the table at most half full
+      size_t slotBytes = sizeof(uint64_t) + sizeof(float*);
+      size_t maxBricks = maxBytes / (_brickBytes + 2 * slotBytes);
+      
+      if (maxBricks == 0)
+      {
+         return;
+      }
+      
+      size_t slots = 1;
+      while (slots < 2 * maxBricks)
+      {
+         slots <<= 1;
+      }
+      
+      _maxBricks = maxBricks;
+      _mask = slots - 1;
+      _invSpacing = 1.0f / spacing;
+      
+      _keys = new volatile uint64_t[slots];
+      _bricks = new float* volatile[slots];
+      for (size_t i=0; i<slots; ++i)
+      {
+         _keys[i] = 0;
+         _bricks[i] = 0;
+      }
+   }
+   
+   ~BrickCache()
+   {
+      if (_bricks)
+      {
+         for (size_t i=0; i<=_mask; ++i)
+         {
+            delete[] _bricks[i];
+         }
+         delete[] _bricks;
+         delete[] _keys;
+      }
+   }
+   
+   inline bool valid() const
+   {
+      return (_bricks != 0);
+   }
+   
+   // Trilinear lookup of the components at P.
+   //
+   // Returns false, leaving out untouched, when P can't be served from the
+   // cache: beyond the brick coordinates range, brick still being evaluated
+   // by another thread or memory budget exhausted.
+   bool lookup(const BakeSource &src, const Vec3 &P, float *out)
+   {
+      static const float Range = float(BrickSize << (CoordBits - 1));
+      
+      float fx = P.x * _invSpacing;
+      float fy = P.y * _invSpacing;
+      float fz = P.z * _invSpacing;
+      
+      if (!(fabsf(fx) < Range && fabsf(fy) < Range && fabsf(fz) < Range))
+      {
+         return false;
+      }
+      
+      int x = int(floorf(fx));
+      int y = int(floorf(fy));
+      int z = int(floorf(fz));
+      
+      fx -= float(x);
+      fy -= float(y);
+      fz -= float(z);
+      
+      // arithmetic shifts round towards -infinity
+      const float *brick = find(src, x >> BrickBits, y >> BrickBits, z >> BrickBits);
+      
+      if (!brick)
+      {
+         return false;
+      }
+      
+      x &= (BrickSize - 1);
+      y &= (BrickSize - 1);
+      z &= (BrickSize - 1);
+      
+      const int dy = BrickSide * _components;
+      const int dz = BrickSide * dy;
+      const float *s = brick + ((z * BrickSide + y) * BrickSide + x) * _components;
+      
+      for (int c=0; c<_components; ++c, ++s)
+      {
+         float v00 = s[0] + fx * (s[_components] - s[0]);
+         float v10 = s[dy] + fx * (s[dy + _components] - s[dy]);
+         float v01 = s[dz] + fx * (s[dz + _components] - s[dz]);
+         float v11 = s[dz + dy] + fx * (s[dz + dy + _components] - s[dz + dy]);
+         float v0 = v00 + fy * (v10 - v00);
+         float v1 = v01 + fy * (v11 - v01);
+         out[c] = v0 + fz * (v1 - v0);
+      }
+      
+      return true;
+   }
+   
+   inline float spacing() const
+   {
+      return _spacing;
+   }
+   
+   inline size_t maxBricks() const
+   {
+      return _maxBricks;
+   }
+   
+   // Number of evaluated bricks
+   inline size_t bricks() const
+   {
+      uint64_t n = _numBricks;
+      return (n < _maxBricks ? size_t(n) : _maxBricks);
+   }
+   
+   // Memory currently used by the cache
+   inline size_t bytes() const
+   {
+      return (_mask + 1) * (sizeof(uint64_t) + sizeof(float*)) + bricks() * _brickBytes;
+   }
+   
+private:
+   
+   BrickCache(const BrickCache&);
+   BrickCache& operator=(const BrickCache&);
+   
+   static inline uint64_t Key(int bx, int by, int bz)
+   {
+      static const uint64_t CoordMask = (uint64_t(1) << CoordBits) - 1;
+      // top bit set so that no key is 0 (empty slot)
+      return (uint64_t(1) << 63) |
+             ((uint64_t(uint32_t(bx)) & CoordMask) << (2 * CoordBits)) |
+             ((uint64_t(uint32_t(by)) & CoordMask) << CoordBits) |
+             (uint64_t(uint32_t(bz)) & CoordMask);
+   }
+   
+   static inline size_t Hash(uint64_t key)
+   {
+      key ^= (key >> 33);
+      key *= 0xff51afd7ed558ccdULL;
+      key ^= (key >> 33);
+      return size_t(key);
+   }
+   
+   const float* find(const BakeSource &src, int bx, int by, int bz)
+   {
+      uint64_t key = Key(bx, by, bz);
+      size_t slot = Hash(key) & _mask;
+      
+      for (int probe=0; probe<MaxProbes; ++probe, slot=((slot + 1) & _mask))
+      {
+         uint64_t k = LoadKey(&_keys[slot]);
+         
+         if (k == 0)
+         {
+            if (ClaimKey(&_keys[slot], key))
+            {
+               if (AtomicIncrement(&_numBricks) > _maxBricks)
+               {
+                  // the slot stays claimed but empty, falling back to
+                  // direct evaluation
+                  return 0;
+               }
+               return populate(src, slot, bx, by, bz);
+            }
+            k = LoadKey(&_keys[slot]);
+         }
+         
+         if (k == key)
+         {
+            return LoadSlot(&_bricks[slot]);
+         }
+      }
+      
+      return 0;
+   }
+   
+   const float* populate(const BakeSource &src, size_t slot, int bx, int by, int bz)
+   {
+      float *brick = new float[BrickSamples * _components];
+      float px[BrickSamples];
+      float py[BrickSamples];
+      float pz[BrickSamples];
+      int i = 0;
+      
+      int x0 = bx * BrickSize;
+      int y0 = by * BrickSize;
+      int z0 = bz * BrickSize;
+      
+      for (int z=0; z<BrickSide; ++z)
+      {
+         float vz = float(z0 + z) * _spacing;
+         
+         for (int y=0; y<BrickSide; ++y)
+         {
+            float vy = float(y0 + y) * _spacing;
+            
+            for (int x=0; x<BrickSide; ++x, ++i)
+            {
+               px[i] = float(x0 + x) * _spacing;
+               py[i] = vy;
+               pz[i] = vz;
+            }
+         }
+      }
+      
+      src.values(BrickSamples, px, py, pz, brick);
+      
+      // only the thread that claimed the key publishes it
+      PublishSlot(&_bricks[slot], brick);
+      
+      return brick;
+   }
+   
+   int _components;
+   float _spacing;
+   float _invSpacing;
+   size_t _brickBytes;
+   size_t _maxBricks;
+   volatile uint64_t _numBricks;
+   size_t _mask;
+   volatile uint64_t *_keys;
+   float* volatile *_bricks;
+};
+
+#endif
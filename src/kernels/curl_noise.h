@@ -0,0 +1,158 @@
+/*
+MIT License
+
+Copyright (c) 2016 Gaetan Guidet
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __noise_kernels_curl_noise_h__
+#define __noise_kernels_curl_noise_h__
+
+// curl_noise shader kernel. Nothing in here depends on Arnold.
+
+#include "fbm.h"
+#include "../stegu/sdnoise1234.h"
+
+struct CurlNoiseValues
+{
+   float frequency;
+   float power;
+   int roughness;
+   // sample footprint for octaves fading, 0 to disable
+   float filter_width;
+   // see AcquirePermutationTable, 0 for the reference one
+   const PermutationTable *permutation;
+};
+
+// Curl of a vector potential made of 3 decorrelated simplex fBm fields. The
+// fields share each octave's lattice work (see sdnoise3x3) and their analytic
+// derivatives give the curl directly, so the result is divergence free (up
+// to octaves fading).
+class CurlfBm : public fBmBase
+{
+public:
+   
+   const PermutationTable *permutation;
+   
+   CurlfBm(float octaves, float amplitude, float persistence, float frequency, float lacunarity)
+      : fBmBase(octaves, amplitude, persistence, frequency, lacunarity)
+      , permutation(0)
+      , _perm(SimplexNoise1234::permutation())
+   {
+   }
+   
+   // Must be called once params and permutation are set and before any call
+   // to eval
+   void prepare()
+   {
+      prepareOctaves();
+      _perm = (permutation ? permutation->perm : SimplexNoise1234::permutation());
+   }
+   
+   // See fBm::eval for filterWidth
+   Vec3 eval(const Vec3 &inP, bool dampen=true, float filterWidth=0.0f) const
+   {
+      Context ctx;
+      
+      ctx.amplitude = params.amplitude;
+      ctx.frequency = params.frequency;
+      ctx.octave = 0;
+      
+      // potential gradients, dpsi[3*i+j] is the derivative of field i along
+      // axis j
+      float dpsi[9] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+      float remaining = _amplitudeSum;
+      float threshold = amplitudeThreshold(dampen);
+      
+      Vec3 P = inP * params.frequency;
+      float n[3], dn[9];
+      
+      for (; ctx.octave<_octaves; ctx.octave++)
+      {
+         if (threshold > 0.0f && remaining < threshold)
+         {
+            break;
+         }
+         
+         float weight = OctaveFade(ctx.frequency, filterWidth);
+         
+         if (weight <= 0.0f && stopAtFadedOctave())
+         {
+            break;
+         }
+         
+         if (ctx.octave + 1 == _octaves)
+         {
+            weight *= _lastOctaveWeight;
+         }
+         
+         sdnoise3x3(P.x, P.y, P.z, _perm, n, dn);
+         
+         // noise space to input space
+         float scale = weight * ctx.amplitude * ctx.frequency;
+         
+         for (int i=0; i<9; ++i)
+         {
+            dpsi[i] += scale * dn[i];
+         }
+         
+         // Prepare the next octave.
+         remaining -= fabsf(ctx.amplitude);
+         
+         ctx.amplitude *= params.persistence;
+         ctx.frequency *= params.lacunarity;
+         
+         P *= params.lacunarity;
+      }
+      
+      Vec3 curl(dpsi[7] - dpsi[5], dpsi[2] - dpsi[6], dpsi[3] - dpsi[1]);
+      
+      if (dampen)
+      {
+         // normalize as if all octaves were evaluated
+         curl *= 1.0f / _dampfactor;
+      }
+      
+      return curl;
+   }
+   
+private:
+   
+   const unsigned char *_perm;
+};
+
+// Same octaves series as DistortPoint
+inline Vec3 CurlNoise(const CurlNoiseValues &values, const Vec3 &P)
+{
+   CurlfBm fbm(float(values.roughness), 1.0f, 0.5f, values.frequency, 2.0f);
+   fbm.permutation = values.permutation;
+   fbm.prepare();
+   return values.power * fbm.eval(P, false, values.filter_width);
+}
+
+// Number of noise octaves evaluated per point, used for shading statistics
+inline int EvaluatedOctaves(const CurlNoiseValues &values)
+{
+   fBmBase fbm(float(values.roughness), 1.0f, 0.5f, values.frequency, 2.0f);
+   fbm.prepareOctaves();
+   return fbm.evaluatedOctaves(false, values.filter_width);
+}
+
+#endif
@@ -0,0 +1,388 @@
+/*
+MIT License
+
+Copyright (c) 2016 Gaetan Guidet
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __noise_kernels_distort_point_h__
+#define __noise_kernels_distort_point_h__
+
+// distort_point shader kernel. Nothing in here depends on Arnold.
+
+#include "fbm.h"
+#include "bake.h"
+
+struct DistortPointValues
+{
+   float frequency;
+   float power;
+   int roughness;
+   // sample footprint for octaves fading, 0 to disable
+   float filter_width;
+   // only the parameters of the selected noise type need to be set
+   int value_seed;
+   int perlin_seed;
+   NoiseHash lattice_hash;
+   float flow_power;
+   float flow_time;
+   // simplex4d noise time coordinate
+   float time;
+   // simplex, simplex4d or flow noise permutation table (see AcquirePermutationTable),
+   // 0 for the reference one
+   const PermutationTable *permutation;
+};
+
+// Channel i is sampled at P + DistortPointOffsets[i]
+static const float DistortPointOffsets[3][3] =
+{
+   {(12414.0f / 65536.0f), (65124.0f / 65536.0f), (31337.0f / 65536.0f)},
+   {(26519.0f / 65536.0f), (18128.0f / 65536.0f), (60493.0f / 65536.0f)},
+   {(53820.0f / 65536.0f), (11213.0f / 65536.0f), (44845.0f / 65536.0f)}
+};
+
+// Noise parameters of channel i
+inline void SetupChannel(const DistortPointValues &values, int i, ValueNoise::Params &params)
+{
+   params.quality = NQ_std;
+   params.seed = values.value_seed + i;
+   params.hash = values.lattice_hash;
+}
+inline void SetupChannel(const DistortPointValues &values, int i, PerlinNoise::Params &params)
+{
+   params.quality = NQ_std;
+   params.seed = values.perlin_seed + i;
+   params.hash = values.lattice_hash;
+}
+inline void SetupChannel(const DistortPointValues &values, int, SimplexNoise::Params &params)
+{
+   params.permutation = values.permutation;
+}
+inline void SetupChannel(const DistortPointValues &values, int, Simplex4DNoise::Params &params)
+{
+   params.time = values.time;
+   params.permutation = values.permutation;
+}
+inline void SetupChannel(const DistortPointValues &values, int, FlowNoise::Params &params)
+{
+   params.power = values.flow_power;
+   params.t = values.flow_time;
+   params.permutation = values.permutation;
+}
+
+// Set up and prepare fbm for the given values
+template <typename TNoise>
+void Setup(const DistortPointValues &values, fBm3<TNoise> &fbm)
+{
+   fbm.params.octaves = float(values.roughness);
+   fbm.params.amplitude = 1.0f;
+   fbm.params.persistence = 0.5f;
+   fbm.params.frequency = values.frequency;
+   fbm.params.lacunarity = 2.0f;
+   for (int i=0; i<3; ++i)
+   {
+      SetupChannel(values, i, fbm.noise_params[i]);
+   }
+   fbm.prepare();
+}
+
+// Offset applied to the input point: a 3 channels fBm scaled by power,
+// each channel sampled at a different offset of P. fbm must be prepared
+// (see Setup).
+template <typename TNoise>
+inline Vec3 DistortPointOffset(const fBm3<TNoise> &fbm, const DistortPointValues &values, const Vec3 &P)
+{
+   Vec3 Pn[3];
+   
+   for (int i=0; i<3; ++i)
+   {
+      Pn[i] = Vec3(P.x + DistortPointOffsets[i][0], P.y + DistortPointOffsets[i][1], P.z + DistortPointOffsets[i][2]);
+   }
+   
+   return values.power * fbm.eval(Pn, false, values.filter_width);
+}
+
+template <typename TNoise>
+inline Vec3 DistortPointOffset(const DistortPointValues &values, const Vec3 &P)
+{
+   fBm3<TNoise> fbm(values.roughness, 1.0f, 0.5f, values.frequency, 2.0f);
+   Setup(values, fbm);
+   return DistortPointOffset(fbm, values, P);
+}
+
+inline Vec3 DistortPointOffset(NoiseType type, const DistortPointValues &values, const Vec3 &P)
+{
+   switch (type)
+   {
+   case NT_value:
+      return DistortPointOffset<ValueNoise>(values, P);
+   case NT_perlin:
+      return DistortPointOffset<PerlinNoise>(values, P);
+   case NT_flow:
+      return DistortPointOffset<FlowNoise>(values, P);
+   case NT_simplex4d:
+      return DistortPointOffset<Simplex4DNoise>(values, P);
+   case NT_simplex:
+   default:
+      return DistortPointOffset<SimplexNoise>(values, P);
+   }
+}
+
+// Offset the input point (see DistortPointOffset)
+template <typename TNoise>
+inline Vec3 DistortPoint(const fBm3<TNoise> &fbm, const DistortPointValues &values, const Vec3 &P)
+{
+   return P + DistortPointOffset(fbm, values, P);
+}
+
+inline Vec3 DistortPoint(NoiseType type, const DistortPointValues &values, const Vec3 &P)
+{
+   return P + DistortPointOffset(type, values, P);
+}
+
+// Distorts points with parameter values bound once, so that the fBm is
+// not set up again for every point
+class DistortPointEvaluator
+{
+public:
+   
+   virtual ~DistortPointEvaluator()
+   {
+   }
+   
+   // Bind parameter values
+   virtual void setup(const DistortPointValues &values) = 0;
+   
+   // Evaluate using bound values
+   // filterWidth is the sample footprint for octaves fading, 0 to disable
+   virtual Vec3 eval(const Vec3 &P, float filterWidth) const = 0;
+};
+
+template <typename TNoise>
+class TDistortPointEvaluator : public DistortPointEvaluator
+{
+public:
+   
+   TDistortPointEvaluator()
+      : _fbm(0, 1.0f, 0.5f, 1.0f, 2.0f)
+   {
+   }
+   
+   virtual ~TDistortPointEvaluator()
+   {
+   }
+   
+   virtual void setup(const DistortPointValues &values)
+   {
+      _values = values;
+      Setup(values, _fbm);
+   }
+   
+   virtual Vec3 eval(const Vec3 &P, float filterWidth) const
+   {
+      DistortPointValues values = _values;
+      values.filter_width = filterWidth;
+      return DistortPoint(_fbm, values, P);
+   }
+   
+private:
+   
+   fBm3<TNoise> _fbm;
+   DistortPointValues _values;
+};
+
+inline DistortPointEvaluator* CreateDistortPointEvaluator(NoiseType type)
+{
+   switch (type)
+   {
+   case NT_value:
+      return new TDistortPointEvaluator<ValueNoise>();
+   case NT_perlin:
+      return new TDistortPointEvaluator<PerlinNoise>();
+   case NT_flow:
+      return new TDistortPointEvaluator<FlowNoise>();
+   case NT_simplex4d:
+      return new TDistortPointEvaluator<Simplex4DNoise>();
+   case NT_simplex:
+   default:
+      return new TDistortPointEvaluator<SimplexNoise>();
+   }
+}
+
+// Offsets of n points given in SoA layout (x, y and z arrays), same results
+// as DistortPointOffset for each point. Each channel runs as a batched fBm
+// over the points (see fBm::eval). Outputs must not alias the inputs.
+template <typename TNoise>
+void EvalDistortPointOffsetBatch(const DistortPointValues &values, size_t n, const float *x, const float *y, const float *z, float *outX, float *outY, float *outZ)
+{
+   float *out[3] = {outX, outY, outZ};
+   
+   float px[NOISE_BATCH_TILE_SIZE];
+   float py[NOISE_BATCH_TILE_SIZE];
+   float pz[NOISE_BATCH_TILE_SIZE];
+   float offset[NOISE_BATCH_TILE_SIZE];
+   
+   for (int c=0; c<3; ++c)
+   {
+      fBm<TNoise, DefaultModifier> fbm(values.roughness, 1.0f, 0.5f, values.frequency, 2.0f);
+      SetupChannel(values, c, fbm.noise_params);
+      fbm.prepare();
+      
+      for (size_t start=0; start<n; start+=NOISE_BATCH_TILE_SIZE)
+      {
+         size_t count = std::min<size_t>(n - start, NOISE_BATCH_TILE_SIZE);
+         
+         for (size_t i=0; i<count; ++i)
+         {
+            px[i] = x[start + i] + DistortPointOffsets[c][0];
+            py[i] = y[start + i] + DistortPointOffsets[c][1];
+            pz[i] = z[start + i] + DistortPointOffsets[c][2];
+         }
+         
+         fbm.eval(count, px, py, pz, offset, false, values.filter_width);
+         
+         for (size_t i=0; i<count; ++i)
+         {
+            out[c][start + i] = values.power * offset[i];
+         }
+      }
+   }
+}
+
+inline void EvalDistortPointOffsetBatch(NoiseType type, const DistortPointValues &values, size_t n, const float *x, const float *y, const float *z, float *outX, float *outY, float *outZ)
+{
+   switch (type)
+   {
+   case NT_value:
+      EvalDistortPointOffsetBatch<ValueNoise>(values, n, x, y, z, outX, outY, outZ);
+      break;
+   case NT_perlin:
+      EvalDistortPointOffsetBatch<PerlinNoise>(values, n, x, y, z, outX, outY, outZ);
+      break;
+   case NT_flow:
+      EvalDistortPointOffsetBatch<FlowNoise>(values, n, x, y, z, outX, outY, outZ);
+      break;
+   case NT_simplex4d:
+      EvalDistortPointOffsetBatch<Simplex4DNoise>(values, n, x, y, z, outX, outY, outZ);
+      break;
+   case NT_simplex:
+   default:
+      EvalDistortPointOffsetBatch<SimplexNoise>(values, n, x, y, z, outX, outY, outZ);
+   }
+}
+
+// Distort n points given in SoA layout, same results as DistortPoint for
+// each point. Outputs must not alias the inputs.
+inline void EvalDistortPointBatch(NoiseType type, const DistortPointValues &values, size_t n, const float *x, const float *y, const float *z, float *outX, float *outY, float *outZ)
+{
+   EvalDistortPointOffsetBatch(type, values, n, x, y, z, outX, outY, outZ);
+   
+   for (size_t i=0; i<n; ++i)
+   {
+      outX[i] += x[i];
+      outY[i] += y[i];
+      outZ[i] += z[i];
+   }
+}
+
+// Number of noise octaves evaluated per point (all channels), used for
+// shading statistics
+inline int EvaluatedOctaves(const DistortPointValues &values)
+{
+   fBmBase fbm(values.roughness, 1.0f, 0.5f, values.frequency, 2.0f);
+   fbm.prepareOctaves();
+   return 3 * fbm.evaluatedOctaves(false, values.filter_width);
+}
+
+// Number of cached samples per lattice cell of the finest octave
+#ifndef DISTORT_POINT_BAKE_SAMPLES_PER_CELL
+#  define DISTORT_POINT_BAKE_SAMPLES_PER_CELL 4
+#endif
+
+// Cache sample spacing resolving the finest octave, 0 if none
+inline float BakeSpacing(const DistortPointValues &values)
+{
+   float frequency = fabsf(values.frequency);
+   
+   if (values.roughness > 1)
+   {
+      frequency *= float(1 << std::min(values.roughness - 1, 30));
+   }
+   
+   return (frequency > 0.0f ? 1.0f / (frequency * DISTORT_POINT_BAKE_SAMPLES_PER_CELL) : 0.0f);
+}
+
+// Caches the offset applied to P (3 components)
+class DistortPointBakeSource : public BakeSource
+{
+public:
+   
+   DistortPointBakeSource()
+      : _type(NT_simplex)
+   {
+   }
+   
+   virtual ~DistortPointBakeSource()
+   {
+   }
+   
+   inline void bind(NoiseType type, const DistortPointValues &values)
+   {
+      _type = type;
+      _values = values;
+      _values.filter_width = 0.0f;
+   }
+   
+   virtual void value(const Vec3 &P, float *out) const
+   {
+      Vec3 offset = DistortPointOffset(_type, _values, P);
+      out[0] = offset.x;
+      out[1] = offset.y;
+      out[2] = offset.z;
+   }
+   
+   virtual void values(size_t n, const float *x, const float *y, const float *z, float *out) const
+   {
+      float dx[NOISE_BATCH_TILE_SIZE];
+      float dy[NOISE_BATCH_TILE_SIZE];
+      float dz[NOISE_BATCH_TILE_SIZE];
+      
+      for (size_t start=0; start<n; start+=NOISE_BATCH_TILE_SIZE)
+      {
+         size_t count = std::min<size_t>(n - start, NOISE_BATCH_TILE_SIZE);
+         
+         EvalDistortPointOffsetBatch(_type, _values, count, x + start, y + start, z + start, dx, dy, dz);
+         
+         for (size_t i=0; i<count; ++i, out+=3)
+         {
+            out[0] = dx[i];
+            out[1] = dy[i];
+            out[2] = dz[i];
+         }
+      }
+   }
+   
+private:
+   
+   NoiseType _type;
+   DistortPointValues _values;
+};
+
+#endif
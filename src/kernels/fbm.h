@@ -0,0 +1,1377 @@
+/*
+MIT License
+
+Copyright (c) 2016 Gaetan Guidet
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __noise_kernels_fbm_h__
+#define __noise_kernels_fbm_h__
+
+// Fractal noise kernels. Nothing in here depends on Arnold.
+
+#include <cmath>
+#include <cstddef>
+#include "vec3.h"
+#include "../libnoise/noisegen.h"
+#include "../stegu/simplexnoise1234.h"
+#include "../stegu/srdnoise23.h"
+#include "permutation.h"
+
+// Number of points evaluated together by the batch entry points, sized so
+// that a tile's coordinates and noise instances stay in L1
+#ifndef NOISE_BATCH_TILE_SIZE
+#  define NOISE_BATCH_TILE_SIZE 64
+#endif
+
+// Forward differences step, in lattice units, estimating the gradient of
+// the noises without analytic derivatives (value, perlin and 4D simplex)
+#ifndef NOISE_GRADIENT_STEP
+#  define NOISE_GRADIENT_STEP (1.0f / 1024.0f)
+#endif
+
+// Largest octave count with a fully unrolled fBm::eval (see fBm::evalFixed),
+// 0 to always use the generic loop
+#ifndef NOISE_FIXED_OCTAVES_MAX
+#  define NOISE_FIXED_OCTAVES_MAX 8
+#endif
+
+// Actual step between x and x + h once rounded, 0 when x + h rounds to x.
+// Dividing by it instead of h keeps the differences accurate far from the
+// origin
+inline float DifferenceStep(float x, float h)
+{
+   return ((x + h) - x);
+}
+
+enum NoiseQuality
+{
+   NQ_fast = 0,
+   NQ_std,
+   NQ_best
+};
+
+// Lattice hash of value and perlin noises (see noise::NoiseHash)
+enum NoiseHash
+{
+   NH_legacy = 0,
+   NH_xxhash
+};
+
+enum NoiseType
+{
+   NT_value = 0,
+   NT_perlin,
+   NT_simplex,
+   NT_flow,
+   NT_simplex4d
+};
+
+class fBmBase
+{
+public:
+   
+   struct Params
+   {
+      // the last octave is weighted by the fractional part
+      float octaves;
+      float amplitude;
+      float persistence;
+      float frequency;
+      float lacunarity;
+      // stop once the remaining octaves amplitudes sum, relative to the
+      // output, is below this value (0 to disable)
+      float epsilon;
+   };
+   
+   struct Context
+   {
+      int octave;
+      float amplitude;
+      float frequency;
+   };
+   
+   Params params;
+   
+   fBmBase(float octaves, float amplitude, float persistence, float frequency, float lacunarity)
+      : _octaves(0)
+      , _lastOctaveWeight(1.0f)
+      , _dampfactor(0.0f)
+      , _amplitudeSum(0.0f)
+      , _fixedOctaves(false)
+   {
+      params.octaves = octaves;
+      params.amplitude = amplitude;
+      params.persistence = persistence;
+      params.frequency = frequency;
+      params.lacunarity = lacunarity;
+      params.epsilon = 0.0f;
+   }
+   
+   ~fBmBase()
+   {   
+   }
+   
+   // Weight of an octave of the given frequency for a sample covering
+   // filterWidth units of the input space (no filtering when <= 0).
+   // Octaves are faded out from half to full Nyquist frequency.
+   static inline float OctaveFade(float frequency, float filterWidth)
+   {
+      return (filterWidth > 0.0f ? Clamp(2.0f - 4.0f * frequency * filterWidth, 0.0f, 1.0f) : 1.0f);
+   }
+   
+   // Whether no octave after one of weight 0 can contribute
+   inline bool stopAtFadedOctave() const
+   {
+      return (params.lacunarity >= 1.0f);
+   }
+   
+   // Number of octaves eval goes through for the given filterWidth, the
+   // partial one included. It doesn't depend on the point.
+   // Only valid once the octaves series is computed (see prepareOctaves)
+   int evaluatedOctaves(bool dampen, float filterWidth) const
+   {
+      float amplitude = params.amplitude;
+      float frequency = params.frequency;
+      float remaining = _amplitudeSum;
+      float threshold = amplitudeThreshold(dampen);
+      int octave = 0;
+      
+      for (; octave<_octaves; ++octave)
+      {
+         if (threshold > 0.0f && remaining < threshold)
+         {
+            break;
+         }
+         if (OctaveFade(frequency, filterWidth) <= 0.0f && stopAtFadedOctave())
+         {
+            break;
+         }
+         remaining -= fabsf(amplitude);
+         amplitude *= params.persistence;
+         frequency *= params.lacunarity;
+      }
+      
+      return octave;
+   }
+   
+   // Compute the octaves series values below from params
+   void prepareOctaves()
+   {
+      float octaves = (params.octaves > 0.0f ? params.octaves : 0.0f);
+      
+      _octaves = int(ceilf(octaves));
+      _lastOctaveWeight = octaves - floorf(octaves);
+      if (_lastOctaveWeight <= 0.0f)
+      {
+         _lastOctaveWeight = 1.0f;
+      }
+      
+      float tmp = 1.0f;
+      float amplitude = fabsf(params.amplitude);
+      
+      _dampfactor = 0.0f;
+      _amplitudeSum = 0.0f;
+      
+      for (int i=0; i<_octaves; ++i)
+      {
+         float weight = (i + 1 == _octaves ? _lastOctaveWeight : 1.0f);
+         _dampfactor += weight * tmp;
+         _amplitudeSum += weight * amplitude;
+         tmp *= params.persistence;
+         amplitude *= params.persistence;
+      }
+      
+      // Whole octave counts without early termination don't need any per
+      // octave test, their series is tabulated for evalFixed
+      _fixedOctaves = (_octaves >= 1 && _octaves <= NOISE_FIXED_OCTAVES_MAX &&
+                       _lastOctaveWeight == 1.0f && params.epsilon <= 0.0f);
+      
+      if (_fixedOctaves)
+      {
+         _amplitudes[0] = params.amplitude;
+         _frequencies[0] = params.frequency;
+         
+         for (int i=1; i<_octaves; ++i)
+         {
+            _amplitudes[i] = _amplitudes[i - 1] * params.persistence;
+            _frequencies[i] = _frequencies[i - 1] * params.lacunarity;
+         }
+      }
+   }
+   
+   // Early termination threshold on the remaining amplitudes sum
+   inline float amplitudeThreshold(bool dampen) const
+   {
+      return params.epsilon * (dampen ? _dampfactor : 1.0f);
+   }
+   
+protected:
+   
+   // number of octaves to evaluate, including the partial one
+   int _octaves;
+   // weight of the last octave
+   float _lastOctaveWeight;
+   // sum of octaves relative amplitudes, used to dampen output
+   float _dampfactor;
+   // sum of octaves absolute amplitudes
+   float _amplitudeSum;
+   // whether eval can use evalFixed, and the octaves amplitudes and
+   // frequencies it reads
+   bool _fixedOctaves;
+   float _amplitudes[NOISE_FIXED_OCTAVES_MAX > 0 ? NOISE_FIXED_OCTAVES_MAX : 1];
+   float _frequencies[NOISE_FIXED_OCTAVES_MAX > 0 ? NOISE_FIXED_OCTAVES_MAX : 1];
+};
+
+// Octaves Octave to Count-1 of fBm::evalFixed, unrolled at compile time.
+// Noise and modifier calls happen in octave order and the output is
+// accumulated in the same order as fBm::eval, so that results match.
+template <typename Noise, typename Modifier, int Octave, int Count>
+struct FixedOctaves
+{
+   static inline void accumulate(Noise &noise, Modifier &modifier, const float *amplitudes, const float *frequencies,
+                                 float lacunarity, const Vec3 &P, float &out)
+   {
+      fBmBase::Context ctx;
+      
+      ctx.octave = Octave;
+      ctx.amplitude = amplitudes[Octave];
+      ctx.frequency = frequencies[Octave];
+      
+      out += ctx.amplitude * modifier.apply(ctx, noise.value(ctx, P.x, P.y, P.z));
+      
+      FixedOctaves<Noise, Modifier, Octave + 1, Count>::accumulate(noise, modifier, amplitudes, frequencies, lacunarity, P * lacunarity, out);
+   }
+};
+
+template <typename Noise, typename Modifier, int Count>
+struct FixedOctaves<Noise, Modifier, Count, Count>
+{
+   static inline void accumulate(Noise &, Modifier &, const float *, const float *, float, const Vec3 &, float &)
+   {
+   }
+};
+
+// Defined after the noises
+template <typename Noise>
+struct NoiseLanes;
+
+template <typename Noise>
+struct OctaveGradients;
+
+template <typename Modifier>
+struct OctaveFading;
+
+// filterWidth as used for octaves fading with the given modifier
+template <typename Modifier>
+inline float FadingWidth(float filterWidth)
+{
+   return (OctaveFading<Modifier>::value ? filterWidth : 0.0f);
+}
+
+template <typename Noise, typename Modifier>
+class fBm : public fBmBase
+{
+private:
+   
+   Noise _noise;
+   Modifier _modifier;
+   
+public:
+   
+   typename Noise::Params noise_params;
+   typename Modifier::Params modifier_params;
+
+public:
+   
+   fBm(float octaves, float amplitude, float persistence, float frequency, float lacunarity)
+      : fBmBase(octaves, amplitude, persistence, frequency, lacunarity)
+   {
+   }
+   
+   // Must be called once params, noise_params and modifier_params are set
+   // and before any call to eval
+   void prepare()
+   {
+      prepareOctaves();
+      _noise.prepare(params, noise_params);
+      _modifier.prepare(params, modifier_params);
+   }
+   
+   // Noise and modifier may hold per evaluation state, work on copies of the
+   // prepared instances so that eval can safely be called from several threads
+   //
+   // When filterWidth is positive, octaves above the Nyquist limit for that
+   // footprint are faded out and skipped (see OctaveFade and OctaveFading)
+   float eval(const Vec3 &inP, bool dampen=true, float filterWidth=0.0f) const
+   {
+      filterWidth = FadingWidth<Modifier>(filterWidth);
+      
+      if (_fixedOctaves && filterWidth <= 0.0f)
+      {
+         switch (_octaves)
+         {
+         case 1: return evalFixed<1>(inP, dampen);
+         case 2: return evalFixed<2>(inP, dampen);
+         case 3: return evalFixed<3>(inP, dampen);
+         case 4: return evalFixed<4>(inP, dampen);
+         case 5: return evalFixed<5>(inP, dampen);
+         case 6: return evalFixed<6>(inP, dampen);
+         case 7: return evalFixed<7>(inP, dampen);
+         case 8: return evalFixed<8>(inP, dampen);
+         default: break;
+         }
+      }
+      
+      Noise noise(_noise);
+      Modifier modifier(_modifier);
+      Context ctx;
+      
+      ctx.amplitude = params.amplitude;
+      ctx.frequency = params.frequency;
+      ctx.octave = 0;
+      
+      float out = 0.0f;
+      float remaining = _amplitudeSum;
+      float threshold = amplitudeThreshold(dampen);
+      
+      Vec3 P = inP * params.frequency;
+      
+      for (; ctx.octave<_octaves; ctx.octave++)
+      {
+         if (threshold > 0.0f && remaining < threshold)
+         {
+            break;
+         }
+         
+         float weight = OctaveFade(ctx.frequency, filterWidth);
+         
+         if (weight <= 0.0f && stopAtFadedOctave())
+         {
+            break;
+         }
+         
+         if (ctx.octave + 1 == _octaves)
+         {
+            weight *= _lastOctaveWeight;
+         }
+         
+         out += weight * ctx.amplitude * modifier.apply(ctx, noise.value(ctx, P.x, P.y, P.z));
+         
+         // Prepare the next octave.
+         remaining -= fabsf(ctx.amplitude);
+         
+         ctx.amplitude *= params.persistence;
+         ctx.frequency *= params.lacunarity;
+         
+         P *= params.lacunarity;
+      }
+      
+      if (dampen)
+      {
+         // normalize as if all octaves were evaluated
+         out /= _dampfactor;
+      }
+      
+      modifier.cleanup();
+      noise.cleanup();
+      
+      return out;
+   }
+   
+   // Same as eval(P) for Count whole octaves, no early termination nor
+   // octaves fading. Only valid when prepareOctaves selected it (see
+   // _fixedOctaves) for Count octaves.
+   template <int Count>
+   float evalFixed(const Vec3 &inP, bool dampen) const
+   {
+      Noise noise(_noise);
+      Modifier modifier(_modifier);
+      
+      float out = 0.0f;
+      
+      FixedOctaves<Noise, Modifier, 0, Count>::accumulate(noise, modifier, _amplitudes, _frequencies, params.lacunarity,
+                                                          inP * params.frequency, out);
+      
+      if (dampen)
+      {
+         // normalize as if all octaves were evaluated
+         out /= _dampfactor;
+      }
+      
+      modifier.cleanup();
+      noise.cleanup();
+      
+      return out;
+   }
+   
+   // Same value as eval(P) along with its gradient with respect to P, for
+   // bump mapping without offset evaluations. Noises and modifiers
+   // propagate the octaves gradients (see their value and apply overloads)
+   // unless OctaveGradients<Noise> says otherwise
+   float eval(const Vec3 &inP, Vec3 &outGrad, bool dampen=true, float filterWidth=0.0f) const
+   {
+      if (!OctaveGradients<Noise>::value)
+      {
+         return differences(inP, outGrad, dampen, filterWidth);
+      }
+      
+      filterWidth = FadingWidth<Modifier>(filterWidth);
+      
+      Noise noise(_noise);
+      Modifier modifier(_modifier);
+      Context ctx;
+      
+      ctx.amplitude = params.amplitude;
+      ctx.frequency = params.frequency;
+      ctx.octave = 0;
+      
+      float out = 0.0f;
+      float remaining = _amplitudeSum;
+      float threshold = amplitudeThreshold(dampen);
+      
+      Vec3 P = inP * params.frequency;
+      Vec3 grad;
+      
+      outGrad = Vec3(0.0f, 0.0f, 0.0f);
+      
+      for (; ctx.octave<_octaves; ctx.octave++)
+      {
+         if (threshold > 0.0f && remaining < threshold)
+         {
+            break;
+         }
+         
+         float weight = OctaveFade(ctx.frequency, filterWidth);
+         
+         if (weight <= 0.0f && stopAtFadedOctave())
+         {
+            break;
+         }
+         
+         if (ctx.octave + 1 == _octaves)
+         {
+            weight *= _lastOctaveWeight;
+         }
+         
+         float value = noise.value(ctx, P.x, P.y, P.z, grad);
+         
+         // noise space to input space
+         grad *= ctx.frequency;
+         
+         value = modifier.apply(ctx, value, grad);
+         
+         out += weight * ctx.amplitude * value;
+         outGrad += (weight * ctx.amplitude) * grad;
+         
+         // Prepare the next octave.
+         remaining -= fabsf(ctx.amplitude);
+         
+         ctx.amplitude *= params.persistence;
+         ctx.frequency *= params.lacunarity;
+         
+         P *= params.lacunarity;
+      }
+      
+      if (dampen)
+      {
+         // normalize as if all octaves were evaluated
+         out /= _dampfactor;
+         outGrad *= 1.0f / _dampfactor;
+      }
+      
+      modifier.cleanup();
+      noise.cleanup();
+      
+      return out;
+   }
+   
+   // Forward differences of eval(P), the step is a fraction of the finest
+   // octave's lattice
+   float differences(const Vec3 &inP, Vec3 &outGrad, bool dampen, float filterWidth) const
+   {
+      float frequency = fabsf(params.frequency);
+      if (params.lacunarity > 1.0f && _octaves > 1)
+      {
+         frequency *= powf(params.lacunarity, float(_octaves - 1));
+      }
+      
+      float h = (frequency > 0.0f ? NOISE_GRADIENT_STEP / frequency : NOISE_GRADIENT_STEP);
+      float hx = DifferenceStep(inP.x, h);
+      float hy = DifferenceStep(inP.y, h);
+      float hz = DifferenceStep(inP.z, h);
+      float rv = eval(inP, dampen, filterWidth);
+      
+      outGrad.x = (hx > 0.0f ? (eval(Vec3(inP.x + hx, inP.y, inP.z), dampen, filterWidth) - rv) / hx : 0.0f);
+      outGrad.y = (hy > 0.0f ? (eval(Vec3(inP.x, inP.y + hy, inP.z), dampen, filterWidth) - rv) / hy : 0.0f);
+      outGrad.z = (hz > 0.0f ? (eval(Vec3(inP.x, inP.y, inP.z + hz), dampen, filterWidth) - rv) / hz : 0.0f);
+      
+      return rv;
+   }
+   
+   // Evaluate n points given as separate x, y and z arrays, same results as
+   // eval(P) for each point. Points are processed by tiles of
+   // NOISE_BATCH_TILE_SIZE, octave by octave, so that noise lookups run as
+   // lanes (see NoiseLanes)
+   void eval(size_t n, const float *inX, const float *inY, const float *inZ, float *out, bool dampen=true, float filterWidth=0.0f) const
+   {
+      Noise noise[NOISE_BATCH_TILE_SIZE];
+      Modifier modifier[NOISE_BATCH_TILE_SIZE];
+      float x[NOISE_BATCH_TILE_SIZE];
+      float y[NOISE_BATCH_TILE_SIZE];
+      float z[NOISE_BATCH_TILE_SIZE];
+      float v[NOISE_BATCH_TILE_SIZE];
+      
+      float threshold = amplitudeThreshold(dampen);
+      
+      filterWidth = FadingWidth<Modifier>(filterWidth);
+      
+      for (size_t start=0; start<n; start+=NOISE_BATCH_TILE_SIZE)
+      {
+         int count = int(n - start < NOISE_BATCH_TILE_SIZE ? n - start : NOISE_BATCH_TILE_SIZE);
+         float *tileOut = out + start;
+         
+         for (int i=0; i<count; ++i)
+         {
+            noise[i] = _noise;
+            modifier[i] = _modifier;
+            x[i] = inX[start + i] * params.frequency;
+            y[i] = inY[start + i] * params.frequency;
+            z[i] = inZ[start + i] * params.frequency;
+            tileOut[i] = 0.0f;
+         }
+         
+         Context ctx;
+         
+         ctx.amplitude = params.amplitude;
+         ctx.frequency = params.frequency;
+         ctx.octave = 0;
+         
+         float remaining = _amplitudeSum;
+         
+         for (; ctx.octave<_octaves; ctx.octave++)
+         {
+            if (threshold > 0.0f && remaining < threshold)
+            {
+               break;
+            }
+            
+            float weight = OctaveFade(ctx.frequency, filterWidth);
+            
+            if (weight <= 0.0f && stopAtFadedOctave())
+            {
+               break;
+            }
+            
+            if (ctx.octave + 1 == _octaves)
+            {
+               weight *= _lastOctaveWeight;
+            }
+            
+            NoiseLanes<Noise>::values(noise, ctx, count, x, y, z, v);
+            
+            for (int i=0; i<count; ++i)
+            {
+               tileOut[i] += weight * ctx.amplitude * modifier[i].apply(ctx, v[i]);
+            }
+            
+            // Prepare the next octave.
+            remaining -= fabsf(ctx.amplitude);
+            
+            ctx.amplitude *= params.persistence;
+            ctx.frequency *= params.lacunarity;
+            
+            for (int i=0; i<count; ++i)
+            {
+               x[i] *= params.lacunarity;
+               y[i] *= params.lacunarity;
+               z[i] *= params.lacunarity;
+            }
+         }
+         
+         for (int i=0; i<count; ++i)
+         {
+            if (dampen)
+            {
+               // normalize as if all octaves were evaluated
+               tileOut[i] /= _dampfactor;
+            }
+            modifier[i].cleanup();
+            noise[i].cleanup();
+         }
+      }
+   }
+};
+
+struct ValueNoise
+{
+   struct Params
+   {
+      int seed;
+      NoiseQuality quality;
+      NoiseHash hash;
+      
+      inline Params()
+         : seed(0), quality(NQ_std), hash(NH_legacy)
+      {
+      }
+   };
+   
+   typedef float (*CoherentNoiseFunc)(float, float, float, int);
+   typedef float (*CoherentNoiseGradFunc)(float, float, float, int, float*, float*, float*);
+   
+   Params _params;
+   CoherentNoiseFunc _func;
+   CoherentNoiseGradFunc _gradFunc;
+   
+   inline ValueNoise()
+      : _func(&noise::ValueLatticeNoise3DF<noise::QUALITY_STD, noise::HASH_LEGACY>)
+      , _gradFunc(&noise::ValueLatticeNoise3DFD<noise::QUALITY_STD, noise::HASH_LEGACY>)
+   {
+   }
+   
+   template <noise::NoiseHash hash>
+   static inline void Select(NoiseQuality quality, CoherentNoiseFunc &func, CoherentNoiseGradFunc &gradFunc)
+   {
+      switch (quality)
+      {
+      case NQ_fast:
+         func = &noise::ValueLatticeNoise3DF<noise::QUALITY_FAST, hash>;
+         gradFunc = &noise::ValueLatticeNoise3DFD<noise::QUALITY_FAST, hash>;
+         break;
+      case NQ_best:
+         func = &noise::ValueLatticeNoise3DF<noise::QUALITY_BEST, hash>;
+         gradFunc = &noise::ValueLatticeNoise3DFD<noise::QUALITY_BEST, hash>;
+         break;
+      case NQ_std:
+      default:
+         func = &noise::ValueLatticeNoise3DF<noise::QUALITY_STD, hash>;
+         gradFunc = &noise::ValueLatticeNoise3DFD<noise::QUALITY_STD, hash>;
+      }
+   }
+   
+   inline void prepare(const fBmBase::Params &, const Params &inParams)
+   {
+      _params = inParams;
+      
+      if (_params.hash == NH_xxhash)
+      {
+         Select<noise::HASH_XX>(_params.quality, _func, _gradFunc);
+      }
+      else
+      {
+         Select<noise::HASH_LEGACY>(_params.quality, _func, _gradFunc);
+      }
+   }
+   
+   inline float value(const fBmBase::Context &ctx, float x, float y, float z)
+   {
+      // Make sure that these floating-point values have the same range as a 32-
+      // bit integer so that we can pass them to the coherent-noise functions.
+      float nx = noise::MakeInt32Range(x);
+      float ny = noise::MakeInt32Range(y);
+      float nz = noise::MakeInt32Range(z);
+      _params.seed = (_params.seed + ctx.octave) & 0xFFFFFFFF;
+      return _func(nx, ny, nz, _params.seed);
+   }
+   
+   // Analytic gradient, from the same lattice cell corners as the value
+   inline float value(const fBmBase::Context &ctx, float x, float y, float z, Vec3 &grad)
+   {
+      float nx = noise::MakeInt32Range(x);
+      float ny = noise::MakeInt32Range(y);
+      float nz = noise::MakeInt32Range(z);
+      _params.seed = (_params.seed + ctx.octave) & 0xFFFFFFFF;
+      return _gradFunc(nx, ny, nz, _params.seed, &grad.x, &grad.y, &grad.z);
+   }
+   
+   inline void cleanup()
+   {
+   }
+};
+
+struct PerlinNoise
+{
+   struct Params
+   {
+      int seed;
+      NoiseQuality quality;
+      NoiseHash hash;
+      
+      inline Params()
+         : seed(0), quality(NQ_std), hash(NH_legacy)
+      {
+      }
+   };
+   
+   typedef float (*CoherentNoiseFunc)(float, float, float, int);
+   typedef float (*CoherentNoiseGradFunc)(float, float, float, int, float*, float*, float*);
+   
+   Params _params;
+   CoherentNoiseFunc _func;
+   CoherentNoiseGradFunc _gradFunc;
+   
+   inline PerlinNoise()
+      : _func(&noise::GradientLatticeNoise3DF<noise::QUALITY_STD, noise::HASH_LEGACY>)
+      , _gradFunc(&noise::GradientLatticeNoise3DFD<noise::QUALITY_STD, noise::HASH_LEGACY>)
+   {
+   }
+   
+   template <noise::NoiseHash hash>
+   static inline void Select(NoiseQuality quality, CoherentNoiseFunc &func, CoherentNoiseGradFunc &gradFunc)
+   {
+      switch (quality)
+      {
+      case NQ_fast:
+         func = &noise::GradientLatticeNoise3DF<noise::QUALITY_FAST, hash>;
+         gradFunc = &noise::GradientLatticeNoise3DFD<noise::QUALITY_FAST, hash>;
+         break;
+      case NQ_best:
+         func = &noise::GradientLatticeNoise3DF<noise::QUALITY_BEST, hash>;
+         gradFunc = &noise::GradientLatticeNoise3DFD<noise::QUALITY_BEST, hash>;
+         break;
+      case NQ_std:
+      default:
+         func = &noise::GradientLatticeNoise3DF<noise::QUALITY_STD, hash>;
+         gradFunc = &noise::GradientLatticeNoise3DFD<noise::QUALITY_STD, hash>;
+      }
+   }
+   
+   inline void prepare(const fBmBase::Params &, const Params &inParams)
+   {
+      _params = inParams;
+      
+      if (_params.hash == NH_xxhash)
+      {
+         Select<noise::HASH_XX>(_params.quality, _func, _gradFunc);
+      }
+      else
+      {
+         Select<noise::HASH_LEGACY>(_params.quality, _func, _gradFunc);
+      }
+   }
+   
+   inline float value(const fBmBase::Context &ctx, float x, float y, float z)
+   {
+      // Make sure that these floating-point values have the same range as a 32-
+      // bit integer so that we can pass them to the coherent-noise functions.
+      float nx = noise::MakeInt32Range(x);
+      float ny = noise::MakeInt32Range(y);
+      float nz = noise::MakeInt32Range(z);
+      _params.seed = (_params.seed + ctx.octave) & 0xFFFFFFFF;
+      return _func(nx, ny, nz, _params.seed);
+   }
+   
+   // Analytic gradient, from the same lattice cell corners as the value
+   inline float value(const fBmBase::Context &ctx, float x, float y, float z, Vec3 &grad)
+   {
+      float nx = noise::MakeInt32Range(x);
+      float ny = noise::MakeInt32Range(y);
+      float nz = noise::MakeInt32Range(z);
+      _params.seed = (_params.seed + ctx.octave) & 0xFFFFFFFF;
+      return _gradFunc(nx, ny, nz, _params.seed, &grad.x, &grad.y, &grad.z);
+   }
+   
+   inline void cleanup()
+   {
+   }
+};
+
+struct SimplexNoise
+{
+   struct Params
+   {
+      // see AcquirePermutationTable, 0 for the reference permutation
+      const PermutationTable *permutation;
+      
+      inline Params()
+         : permutation(0)
+      {
+      }
+   };
+   
+   Params _params;
+   const unsigned char *_perm;
+   
+   inline SimplexNoise()
+      : _perm(SimplexNoise1234::permutation())
+   {
+   }
+   
+   inline void prepare(const fBmBase::Params &, const Params &params)
+   {
+      _params = params;
+      _perm = (params.permutation ? params.permutation->perm : SimplexNoise1234::permutation());
+   }
+   
+   inline float value(const fBmBase::Context &, float x, float y, float z)
+   {
+      return SimplexNoise1234::noise(x, y, z, _perm);
+   }
+   
+   // Analytic gradient
+   inline float value(const fBmBase::Context &, float x, float y, float z, Vec3 &grad)
+   {
+      return SimplexNoise1234::noise(x, y, z, _perm, &grad.x, &grad.y, &grad.z);
+   }
+   
+   inline void cleanup()
+   {
+   }
+};
+
+// 4D simplex noise, the time coordinate being the 4th dimension. time is
+// constant for all the points an fBm evaluates: its value and skew for the
+// first octave are computed in prepare, following octaves only rescale them.
+struct Simplex4DNoise
+{
+   struct Params
+   {
+      float time;
+      // see AcquirePermutationTable, 0 for the reference permutation
+      const PermutationTable *permutation;
+      
+      inline Params()
+         : time(0.0f)
+         , permutation(0)
+      {
+      }
+   };
+   
+   Params _params;
+   const unsigned char *_perm;
+   // current octave's time coordinate and its 4D skew
+   float _w;
+   float _wf4;
+   float _lacunarity;
+   
+   inline Simplex4DNoise()
+      : _perm(SimplexNoise1234::permutation())
+      , _w(0.0f)
+      , _wf4(0.0f)
+      , _lacunarity(1.0f)
+   {
+   }
+   
+   inline void prepare(const fBmBase::Params &fparams, const Params &params)
+   {
+      _params = params;
+      _perm = (params.permutation ? params.permutation->perm : SimplexNoise1234::permutation());
+      _w = params.time * fparams.frequency;
+      _wf4 = SimplexNoise1234::skew4(_w);
+      _lacunarity = fparams.lacunarity;
+   }
+   
+   inline float value(const fBmBase::Context &, float x, float y, float z)
+   {
+      float rv = SimplexNoise1234::noise(x, y, z, _w, _wf4, _perm);
+      _w *= _lacunarity;
+      _wf4 *= _lacunarity;
+      return rv;
+   }
+   
+   // Gradient from forward differences, unused by fBm (see OctaveGradients)
+   inline float value(const fBmBase::Context &, float x, float y, float z, Vec3 &grad)
+   {
+      float rv = SimplexNoise1234::noise(x, y, z, _w, _wf4, _perm);
+      float hx = DifferenceStep(x, NOISE_GRADIENT_STEP);
+      float hy = DifferenceStep(y, NOISE_GRADIENT_STEP);
+      float hz = DifferenceStep(z, NOISE_GRADIENT_STEP);
+      grad.x = (hx > 0.0f ? (SimplexNoise1234::noise(x + hx, y, z, _w, _wf4, _perm) - rv) / hx : 0.0f);
+      grad.y = (hy > 0.0f ? (SimplexNoise1234::noise(x, y + hy, z, _w, _wf4, _perm) - rv) / hy : 0.0f);
+      grad.z = (hz > 0.0f ? (SimplexNoise1234::noise(x, y, z + hz, _w, _wf4, _perm) - rv) / hz : 0.0f);
+      _w *= _lacunarity;
+      _wf4 *= _lacunarity;
+      return rv;
+   }
+   
+   inline void cleanup()
+   {
+   }
+};
+
+struct FlowNoise
+{
+   struct Params
+   {
+      float t;
+      float power;
+      // see AcquirePermutationTable, 0 for the reference permutation
+      const PermutationTable *permutation;
+      
+      inline Params()
+         : t(0.0f), power(0.25f), permutation(0)
+      {
+      }
+   };
+   
+   Params _params;
+   const unsigned char *_perm;
+   float _dx;
+   float _dy;
+   float _dz;
+   float _power;
+   float _persistence;
+   
+   inline FlowNoise()
+      : _perm(SimplexNoise1234::permutation()), _dx(0.0f), _dy(0.0f), _dz(0.0f), _power(0.0f), _persistence(1.0f)
+   {
+   }
+   
+   inline void prepare(const fBmBase::Params &fbmparams, const Params &params)
+   {
+      _params = params;
+      _perm = (params.permutation ? params.permutation->perm : SimplexNoise1234::permutation());
+      _power = params.power;
+      _persistence = fbmparams.persistence;
+      _dx = 0.0f;
+      _dy = 0.0f;
+      _dz = 0.0f;
+   }
+   
+   inline float value(const fBmBase::Context &, float x, float y, float z)
+   {
+      // the new derivatives
+      float dx = 0.0f;
+      float dy = 0.0f;
+      float dz = 0.0f;
+      
+      float rv = srdnoise3(x+_dx, y+_dy, z+_dz, _params.t, &dx, &dy, &dz, _perm);
+      
+      // update derivatives
+      _dx += _power * dx;
+      _dy += _power * dy;
+      _dz += _power * dz;
+      _power *= _persistence;
+      
+      return rv;
+   }
+   
+   // Analytic gradient at the advected point. The advection by the previous
+   // octaves is not differentiated so it is only exact for the first octave
+   // (see OctaveGradients)
+   inline float value(const fBmBase::Context &, float x, float y, float z, Vec3 &grad)
+   {
+      grad = Vec3(0.0f, 0.0f, 0.0f);
+      
+      float rv = srdnoise3(x+_dx, y+_dy, z+_dz, _params.t, &grad.x, &grad.y, &grad.z, _perm);
+      
+      _dx += _power * grad.x;
+      _dy += _power * grad.y;
+      _dz += _power * grad.z;
+      _power *= _persistence;
+      
+      return rv;
+   }
+   
+   inline void cleanup()
+   {
+   }
+};
+
+template <typename M1, typename M2>
+struct CombineModifier
+{
+   struct Params
+   {
+      typename M1::Params mod1;
+      typename M2::Params mod2;
+   };
+   
+   M1 _mod1;
+   M2 _mod2;
+   
+   inline void prepare(const fBmBase::Params &fbmparams, const Params &params)
+   {
+      _mod1.prepare(fbmparams, params.mod1);
+      _mod2.prepare(fbmparams, params.mod2);
+   }
+   
+   inline float apply(const fBmBase::Context &ctx, float noise_value) const
+   {
+      return _mod2.apply(ctx, _mod1.apply(ctx, noise_value));
+   }
+   
+   inline float apply(const fBmBase::Context &ctx, float noise_value, Vec3 &grad) const
+   {
+      return _mod2.apply(ctx, _mod1.apply(ctx, noise_value, grad), grad);
+   }
+   
+   inline void cleanup()
+   {
+   }
+};
+
+struct DefaultModifier
+{
+   struct Params
+   {
+   };
+   
+   inline void prepare(const fBmBase::Params &, const Params &)
+   {
+   }
+   
+   inline float apply(const fBmBase::Context &, float noise_value) const
+   {
+      return noise_value;
+   }
+   
+   // grad is the noise value gradient, replaced by the output's
+   inline float apply(const fBmBase::Context &, float noise_value, Vec3 &) const
+   {
+      return noise_value;
+   }
+   
+   inline void cleanup()
+   {
+   }
+};
+
+struct TurbulenceModifier
+{
+   struct Params
+   {
+      float offset;
+      float scale;
+   };
+   
+   Params _params;
+   
+   inline void prepare(const fBmBase::Params &, const Params &params)
+   {
+      _params = params;
+   }
+   
+   inline float apply(const fBmBase::Context &, float noise_value) const
+   {
+      return (_params.scale * (_params.offset + fabsf(noise_value)));
+   }
+   
+   inline float apply(const fBmBase::Context &ctx, float noise_value, Vec3 &grad) const
+   {
+      grad *= (noise_value < 0.0f ? -_params.scale : _params.scale);
+      return apply(ctx, noise_value);
+   }
+   
+   inline void cleanup()
+   {
+   }
+};
+
+struct RidgeModifier
+{
+   struct Params
+   {
+      float offset;
+      float gain;
+      float exponent;
+   };
+   
+   Params _params;
+   mutable float _weight;
+   // gradient of _weight, only maintained by the gradient apply
+   mutable Vec3 _dweight;
+   
+   inline RidgeModifier()
+      : _weight(1.0f)
+      , _dweight(0.0f, 0.0f, 0.0f)
+   {
+   }
+   
+   void prepare(const fBmBase::Params &, const Params &params)
+   {
+      _params = params;
+      _weight = 1.0f;
+      _dweight = Vec3(0.0f, 0.0f, 0.0f);
+   }
+   
+   float apply(const fBmBase::Context &ctx, float noise_value) const
+   {
+      float s = _params.offset - noise_value;
+      
+      s *= s * _weight;
+      
+      // update weight for next octave
+      _weight = Clamp(s * _params.gain, 0.0f, 1.0f);
+      
+      // apply octave spectral weight
+      return (s * powf(ctx.frequency, -_params.exponent));
+   }
+   
+   float apply(const fBmBase::Context &ctx, float noise_value, Vec3 &grad) const
+   {
+      float r = _params.offset - noise_value;
+      float s = r * (r * _weight);
+      
+      // d(r^2 * weight) = -2 * r * weight * dnoise + r^2 * dweight
+      Vec3 ds = (-2.0f * r * _weight) * grad + (r * r) * _dweight;
+      
+      float w = s * _params.gain;
+      _dweight = ((w > 0.0f && w < 1.0f) ? _params.gain * ds : Vec3(0.0f, 0.0f, 0.0f));
+      _weight = Clamp(w, 0.0f, 1.0f);
+      
+      float spectral = powf(ctx.frequency, -_params.exponent);
+      grad = spectral * ds;
+      
+      return (s * spectral);
+   }
+   
+   inline void cleanup()
+   {
+   }
+};
+
+// Whether the fBm gradient can be accumulated from the octaves' noise and
+// modifier gradients. Flow noise octaves are advected by the previous
+// octaves' derivatives, differentiating that would require the noise
+// hessian, and 4D simplex noise has no analytic gradient: their fBm falls
+// back to forward differences
+template <typename Noise>
+struct OctaveGradients
+{
+   static const bool value = true;
+};
+
+template <>
+struct OctaveGradients<Simplex4DNoise>
+{
+   static const bool value = false;
+};
+
+template <>
+struct OctaveGradients<FlowNoise>
+{
+   static const bool value = false;
+};
+
+// Whether octaves can be faded out (see OctaveFade). Fading blends octaves
+// towards 0, which only leaves the average output unchanged for zero mean
+// modifiers: turbulence and ridges would brighten or darken as the filter
+// width grows, they always evaluate all octaves
+template <typename Modifier>
+struct OctaveFading
+{
+   static const bool value = false;
+};
+
+template <>
+struct OctaveFading<DefaultModifier>
+{
+   static const bool value = true;
+};
+
+// Evaluate noise for n points at once, each point (lane) using its own noise
+// instance. Noises that can process lanes in SIMD specialize this.
+template <typename Noise>
+struct NoiseLanes
+{
+   static inline void values(Noise *noises, const fBmBase::Context &ctx, int n, const float *x, const float *y, const float *z, float *out)
+   {
+      for (int i=0; i<n; ++i)
+      {
+         out[i] = noises[i].value(ctx, x[i], y[i], z[i]);
+      }
+   }
+};
+
+template <>
+struct NoiseLanes<SimplexNoise>
+{
+   static inline void values(SimplexNoise *noises, const fBmBase::Context &ctx, int n, const float *x, const float *y, const float *z, float *out)
+   {
+      const PermutationTable *table = noises[0]._params.permutation;
+      
+      for (int i=1; i<n; ++i)
+      {
+         if (noises[i]._params.permutation != table)
+         {
+            // batches share a single permutation
+            for (int j=0; j<n; ++j)
+            {
+               out[j] = noises[j].value(ctx, x[j], y[j], z[j]);
+            }
+            return;
+         }
+      }
+      
+      if (n >= 4)
+      {
+         batch(table, n, x, y, z, out);
+      }
+      else
+      {
+         // pad to a full SSE lane
+         float px[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+         float py[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+         float pz[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+         float po[4];
+         for (int i=0; i<n; ++i)
+         {
+            px[i] = x[i];
+            py[i] = y[i];
+            pz[i] = z[i];
+         }
+         batch(table, 4, px, py, pz, po);
+         for (int i=0; i<n; ++i)
+         {
+            out[i] = po[i];
+         }
+      }
+   }
+   
+   static inline void batch(const PermutationTable *table, int n, const float *x, const float *y, const float *z, float *out)
+   {
+      if (table)
+      {
+         SimplexNoise1234::noise(n, x, y, z, out, table->perm, table->iperm);
+      }
+      else
+      {
+         SimplexNoise1234::noise(n, x, y, z, out);
+      }
+   }
+};
+
+// Vector valued fBm: 3 fBm channels, one per output component, evaluated
+// together so that octave setup is shared and noise lookups run as lanes.
+// Channel i uses noise_params[i] and is sampled at the i-th input point.
+template <typename Noise, typename Modifier=DefaultModifier>
+class fBm3 : public fBmBase
+{
+private:
+   
+   Noise _noise[3];
+   Modifier _modifier[3];
+   
+public:
+   
+   typename Noise::Params noise_params[3];
+   typename Modifier::Params modifier_params;
+
+public:
+   
+   fBm3(float octaves, float amplitude, float persistence, float frequency, float lacunarity)
+      : fBmBase(octaves, amplitude, persistence, frequency, lacunarity)
+   {
+   }
+   
+   // Must be called once params, noise_params and modifier_params are set
+   // and before any call to eval
+   void prepare()
+   {
+      prepareOctaves();
+      for (int i=0; i<3; ++i)
+      {
+         _noise[i].prepare(params, noise_params[i]);
+         _modifier[i].prepare(params, modifier_params);
+      }
+   }
+   
+   // See fBm::eval for filterWidth
+   Vec3 eval(const Vec3 inP[3], bool dampen=true, float filterWidth=0.0f) const
+   {
+      filterWidth = FadingWidth<Modifier>(filterWidth);
+      
+      Noise noise[3] = {_noise[0], _noise[1], _noise[2]};
+      Modifier modifier[3] = {_modifier[0], _modifier[1], _modifier[2]};
+      Context ctx;
+      
+      ctx.amplitude = params.amplitude;
+      ctx.frequency = params.frequency;
+      ctx.octave = 0;
+      
+      float out[3] = {0.0f, 0.0f, 0.0f};
+      float remaining = _amplitudeSum;
+      float threshold = amplitudeThreshold(dampen);
+      
+      float x[3], y[3], z[3], n[3];
+      
+      for (int i=0; i<3; ++i)
+      {
+         x[i] = inP[i].x * params.frequency;
+         y[i] = inP[i].y * params.frequency;
+         z[i] = inP[i].z * params.frequency;
+      }
+      
+      for (; ctx.octave<_octaves; ctx.octave++)
+      {
+         if (threshold > 0.0f && remaining < threshold)
+         {
+            break;
+         }
+         
+         float weight = OctaveFade(ctx.frequency, filterWidth);
+         
+         if (weight <= 0.0f && stopAtFadedOctave())
+         {
+            break;
+         }
+         
+         if (ctx.octave + 1 == _octaves)
+         {
+            weight *= _lastOctaveWeight;
+         }
+         
+         NoiseLanes<Noise>::values(noise, ctx, 3, x, y, z, n);
+         
+         for (int i=0; i<3; ++i)
+         {
+            out[i] += weight * ctx.amplitude * modifier[i].apply(ctx, n[i]);
+         }
+         
+         // Prepare the next octave.
+         remaining -= fabsf(ctx.amplitude);
+         
+         ctx.amplitude *= params.persistence;
+         ctx.frequency *= params.lacunarity;
+         
+         for (int i=0; i<3; ++i)
+         {
+            x[i] *= params.lacunarity;
+            y[i] *= params.lacunarity;
+            z[i] *= params.lacunarity;
+         }
+      }
+      
+      if (dampen)
+      {
+         // normalize as if all octaves were evaluated
+         for (int i=0; i<3; ++i)
+         {
+            out[i] /= _dampfactor;
+         }
+      }
+      
+      for (int i=0; i<3; ++i)
+      {
+         modifier[i].cleanup();
+         noise[i].cleanup();
+      }
+      
+      Vec3 rv;
+      rv.x = out[0];
+      rv.y = out[1];
+      rv.z = out[2];
+      return rv;
+   }
+};
+
+#endif
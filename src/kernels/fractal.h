@@ -0,0 +1,513 @@
+/*
+MIT License
+
+Copyright (c) 2016 Gaetan Guidet
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __noise_kernels_fractal_h__
+#define __noise_kernels_fractal_h__
+
+// fractal shader kernel. Nothing in here depends on Arnold.
+
+#include "fbm.h"
+#include "bake.h"
+
+// Fully resolved fractal parameters
+struct FractalValues
+{
+   float amplitude;
+   float frequency;
+   float octaves;
+   float persistence;
+   float lacunarity;
+   float amplitude_threshold;
+   
+   int value_seed;
+   NoiseQuality value_quality;
+   int perlin_seed;
+   NoiseQuality perlin_quality;
+   // value and perlin noises lattice hash
+   NoiseHash lattice_hash;
+   float flow_power;
+   float flow_time;
+   // simplex4d noise time coordinate
+   float time;
+   // simplex, simplex4d or flow noise permutation table (see AcquirePermutationTable),
+   // 0 for the reference one
+   const PermutationTable *permutation;
+   
+   bool turbulent;
+   float turbulence_offset;
+   float turbulence_scale;
+   
+   bool ridged;
+   float ridge_offset;
+   float ridge_gain;
+   float ridge_exponent;
+   
+   bool dampen_output;
+   
+   bool remap_output;
+   float fractal_min;
+   float fractal_max;
+   float output_min;
+   float output_max;
+   bool clamp_output;
+};
+
+template <typename TNoise, typename TModifier>
+void SetupNoise(const FractalValues &, fBm<TNoise, TModifier> &)
+{
+}
+template <typename TModifier>
+void SetupNoise(const FractalValues &values, fBm<ValueNoise, TModifier> &fbm)
+{
+   fbm.noise_params.seed = values.value_seed;
+   fbm.noise_params.quality = values.value_quality;
+   fbm.noise_params.hash = values.lattice_hash;
+}
+template <typename TModifier>
+void SetupNoise(const FractalValues &values, fBm<PerlinNoise, TModifier> &fbm)
+{
+   fbm.noise_params.seed = values.perlin_seed;
+   fbm.noise_params.quality = values.perlin_quality;
+   fbm.noise_params.hash = values.lattice_hash;
+}
+template <typename TModifier>
+void SetupNoise(const FractalValues &values, fBm<SimplexNoise, TModifier> &fbm)
+{
+   fbm.noise_params.permutation = values.permutation;
+}
+template <typename TModifier>
+void SetupNoise(const FractalValues &values, fBm<Simplex4DNoise, TModifier> &fbm)
+{
+   fbm.noise_params.time = values.time;
+   fbm.noise_params.permutation = values.permutation;
+}
+template <typename TModifier>
+void SetupNoise(const FractalValues &values, fBm<FlowNoise, TModifier> &fbm)
+{
+   fbm.noise_params.t = values.flow_time;
+   fbm.noise_params.power = values.flow_power;
+   fbm.noise_params.permutation = values.permutation;
+}
+
+template <typename TNoise, typename TModifier>
+void SetupModifier(const FractalValues &, fBm<TNoise, TModifier> &)
+{
+}
+template <typename TNoise>
+void SetupModifier(const FractalValues &values, fBm<TNoise, TurbulenceModifier> &fbm)
+{
+   fbm.modifier_params.offset = values.turbulence_offset;
+   fbm.modifier_params.scale = values.turbulence_scale;
+}
+template <typename TNoise>
+void SetupModifier(const FractalValues &values, fBm<TNoise, RidgeModifier> &fbm)
+{
+   fbm.modifier_params.offset = values.ridge_offset;
+   fbm.modifier_params.gain = values.ridge_gain;
+   fbm.modifier_params.exponent = values.ridge_exponent;
+}
+template <typename TNoise>
+void SetupModifier(const FractalValues &values, fBm<TNoise, CombineModifier<TurbulenceModifier, RidgeModifier> > &fbm)
+{
+   fbm.modifier_params.mod1.offset = values.turbulence_offset;
+   fbm.modifier_params.mod1.scale = values.turbulence_scale;
+   fbm.modifier_params.mod2.offset = values.ridge_offset;
+   fbm.modifier_params.mod2.gain = values.ridge_gain;
+   fbm.modifier_params.mod2.exponent = values.ridge_exponent;
+}
+
+template <typename TNoise, typename TModifier>
+void Setup(const FractalValues &values, fBm<TNoise, TModifier> &fbm)
+{
+   fbm.params.octaves = values.octaves;
+   fbm.params.amplitude = values.amplitude;
+   fbm.params.persistence = values.persistence;
+   fbm.params.frequency = values.frequency;
+   fbm.params.lacunarity = values.lacunarity;
+   fbm.params.epsilon = values.amplitude_threshold;
+   SetupNoise(values, fbm);
+   SetupModifier(values, fbm);
+   fbm.prepare();
+}
+
+inline float Remap(const FractalValues &values, float out)
+{
+   if (values.remap_output)
+   {
+      out = values.output_min + (values.output_max - values.output_min) * (out - values.fractal_min) / (values.fractal_max - values.fractal_min);
+      
+      if (values.clamp_output)
+      {
+         out = Clamp(out, values.output_min, values.output_max);
+      }
+   }
+   
+   return out;
+}
+
+// Remap along with the output gradient, 0 where the output is clamped
+inline float Remap(const FractalValues &values, float out, Vec3 &grad)
+{
+   if (values.remap_output)
+   {
+      float scale = (values.output_max - values.output_min) / (values.fractal_max - values.fractal_min);
+      float rv = Remap(values, out);
+      
+      grad *= scale;
+      
+      if (values.clamp_output && (rv <= values.output_min || rv >= values.output_max))
+      {
+         grad = Vec3(0.0f, 0.0f, 0.0f);
+      }
+      
+      return rv;
+   }
+   
+   return out;
+}
+
+// Evaluates one of the fBm<Noise, Modifier> specializations
+
+class FractalEvaluator
+{
+public:
+   
+   virtual ~FractalEvaluator()
+   {
+   }
+   
+   // Bind parameter values
+   virtual void setup(const FractalValues &values) = 0;
+   
+   // Evaluate using bound values
+   // filterWidth is the sample footprint for octaves fading, 0 to disable
+   virtual float eval(const Vec3 &P, float filterWidth) const = 0;
+   
+   // Evaluate using per-sample values
+   virtual float eval(const FractalValues &values, const Vec3 &P, float filterWidth) const = 0;
+   
+   // Same as above, also computing the gradient of the output
+   virtual float eval(const Vec3 &P, float filterWidth, Vec3 &grad) const = 0;
+   virtual float eval(const FractalValues &values, const Vec3 &P, float filterWidth, Vec3 &grad) const = 0;
+   
+   // Evaluate n points (x, y and z arrays) using bound values
+   virtual void eval(size_t n, const float *x, const float *y, const float *z, float *out, float filterWidth) const = 0;
+   
+   // Whether the gradient is accumulated with the octaves (see
+   // OctaveGradients), otherwise it costs 3 more evaluations
+   virtual bool analyticGradient() const = 0;
+};
+
+template <typename TNoise, typename TModifier>
+class TFractalEvaluator : public FractalEvaluator
+{
+public:
+   
+   TFractalEvaluator()
+      : _fbm(0, 1.0f, 0.5f, 1.0f, 2.0f)
+      , _dampen(true)
+   {
+   }
+   
+   virtual ~TFractalEvaluator()
+   {
+   }
+   
+   virtual void setup(const FractalValues &values)
+   {
+      Setup(values, _fbm);
+      _dampen = values.dampen_output;
+   }
+   
+   virtual float eval(const Vec3 &P, float filterWidth) const
+   {
+      return _fbm.eval(P, _dampen, filterWidth);
+   }
+   
+   virtual float eval(const FractalValues &values, const Vec3 &P, float filterWidth) const
+   {
+      fBm<TNoise, TModifier> fbm(values.octaves, values.amplitude, values.persistence, values.frequency, values.lacunarity);
+      Setup(values, fbm);
+      return fbm.eval(P, values.dampen_output, filterWidth);
+   }
+   
+   virtual float eval(const Vec3 &P, float filterWidth, Vec3 &grad) const
+   {
+      return _fbm.eval(P, grad, _dampen, filterWidth);
+   }
+   
+   virtual float eval(const FractalValues &values, const Vec3 &P, float filterWidth, Vec3 &grad) const
+   {
+      fBm<TNoise, TModifier> fbm(values.octaves, values.amplitude, values.persistence, values.frequency, values.lacunarity);
+      Setup(values, fbm);
+      return fbm.eval(P, grad, values.dampen_output, filterWidth);
+   }
+   
+   virtual void eval(size_t n, const float *x, const float *y, const float *z, float *out, float filterWidth) const
+   {
+      _fbm.eval(n, x, y, z, out, _dampen, filterWidth);
+   }
+   
+   virtual bool analyticGradient() const
+   {
+      return OctaveGradients<TNoise>::value;
+   }
+   
+private:
+   
+   fBm<TNoise, TModifier> _fbm;
+   bool _dampen;
+};
+
+// Index in FractalData::evaluators
+inline int ModifierIndex(bool turbulent, bool ridged)
+{
+   return (turbulent ? 1 : 0) + (ridged ? 2 : 0);
+}
+
+template <typename TNoise>
+FractalEvaluator* CreateEvaluator(int modifier)
+{
+   switch (modifier)
+   {
+   case 1:
+      return new TFractalEvaluator<TNoise, TurbulenceModifier>();
+   case 2:
+      return new TFractalEvaluator<TNoise, RidgeModifier>();
+   case 3:
+      return new TFractalEvaluator<TNoise, CombineModifier<TurbulenceModifier, RidgeModifier> >();
+   case 0:
+   default:
+      return new TFractalEvaluator<TNoise, DefaultModifier>();
+   }
+}
+
+inline FractalEvaluator* CreateEvaluator(NoiseType type, int modifier)
+{
+   switch (type)
+   {
+   case NT_value:
+      return CreateEvaluator<ValueNoise>(modifier);
+   case NT_perlin:
+      return CreateEvaluator<PerlinNoise>(modifier);
+   case NT_flow:
+      return CreateEvaluator<FlowNoise>(modifier);
+   case NT_simplex4d:
+      return CreateEvaluator<Simplex4DNoise>(modifier);
+   case NT_simplex:
+   default:
+      return CreateEvaluator<SimplexNoise>(modifier);
+   }
+}
+
+// Evaluate n points given in SoA layout (x, y and z arrays) with the
+// evaluator's bound values and remap them as the fractal shader does.
+// For callers shading many points at once (texture bakers, lookdev tools),
+// noise lookups run vectorized across points (see fBm::eval).
+inline void EvalFractalBatch(const FractalEvaluator &evaluator, const FractalValues &values, size_t n, const float *x, const float *y, const float *z, float *out, float filterWidth=0.0f)
+{
+   evaluator.eval(n, x, y, z, out, filterWidth);
+   
+   if (values.remap_output)
+   {
+      for (size_t i=0; i<n; ++i)
+      {
+         out[i] = Remap(values, out[i]);
+      }
+   }
+}
+
+// Number of octaves evaluated per point for the given values, used for
+// shading statistics
+inline int EvaluatedOctaves(const FractalValues &values, float filterWidth)
+{
+   fBmBase fbm(values.octaves, values.amplitude, values.persistence, values.frequency, values.lacunarity);
+   fbm.params.epsilon = values.amplitude_threshold;
+   fbm.prepareOctaves();
+   // no fading with turbulence or ridges (see OctaveFading)
+   return fbm.evaluatedOctaves(values.dampen_output, (values.turbulent || values.ridged ? 0.0f : filterWidth));
+}
+
+// Number of baked samples per lattice cell of the finest octave
+#ifndef FRACTAL_BAKE_SAMPLES_PER_CELL
+#  define FRACTAL_BAKE_SAMPLES_PER_CELL 4
+#endif
+
+// Lattice frequency of the finest octave
+inline float FinestFrequency(const FractalValues &values)
+{
+   float frequency = fabsf(values.frequency);
+   
+   if (values.lacunarity > 1.0f && values.octaves > 1.0f)
+   {
+      frequency *= powf(values.lacunarity, ceilf(values.octaves) - 1.0f);
+   }
+   
+   return frequency;
+}
+
+// Baked grid sample spacing resolving the finest octave, 0 if none
+inline float BakeSpacing(const FractalValues &values)
+{
+   float frequency = FinestFrequency(values);
+   
+   return (frequency > 0.0f ? 1.0f / (frequency * FRACTAL_BAKE_SAMPLES_PER_CELL) : 0.0f);
+}
+
+// Caches an evaluator output for its bound values, before remapping
+class FractalBakeSource : public BakeSource
+{
+public:
+   
+   FractalBakeSource()
+      : _evaluator(0)
+   {
+   }
+   
+   virtual ~FractalBakeSource()
+   {
+   }
+   
+   inline void bind(const FractalEvaluator *evaluator)
+   {
+      _evaluator = evaluator;
+   }
+   
+   virtual void value(const Vec3 &P, float *out) const
+   {
+      out[0] = _evaluator->eval(P, 0.0f);
+   }
+   
+   virtual void values(size_t n, const float *x, const float *y, const float *z, float *out) const
+   {
+      _evaluator->eval(n, x, y, z, out, 0.0f);
+   }
+   
+private:
+   
+   const FractalEvaluator *_evaluator;
+};
+
+// Largest input offset from a reused sample, as a fraction of the finest
+// octave lattice cell size (see ReuseDistance)
+#ifndef FRACTAL_REUSE_DEFAULT_DISTANCE
+#  define FRACTAL_REUSE_DEFAULT_DISTANCE 0.05f
+#endif
+
+// Largest input offset from a reused sample for the given values and
+// fraction of the finest octave lattice cell, 0 if none
+inline float ReuseDistance(const FractalValues &values, float cellFraction)
+{
+   float frequency = FinestFrequency(values);
+   
+   return (frequency > 0.0f && cellFraction > 0.0f ? cellFraction / frequency : 0.0f);
+}
+
+// Identity of a shading point, all but its time
+struct ShadingPointKey
+{
+   const void *object;
+   unsigned int primitive;
+   // barycentric coordinates in the primitive
+   float bu;
+   float bv;
+   // pixel and pixel sample
+   int x;
+   int y;
+   int sample;
+   
+   inline bool operator==(const ShadingPointKey &rhs) const
+   {
+      return (object == rhs.object && primitive == rhs.primitive && bu == rhs.bu && bv == rhs.bv &&
+              x == rhs.x && y == rhs.y && sample == rhs.sample);
+   }
+};
+
+// Last point evaluated by a thread along with the fractal gradient there.
+//
+// When the same shading point is evaluated at several times, its input only
+// moving slightly in between, and comes back within maxDistance of the
+// stored input, the first order expansion of the fractal around the stored
+// input is used instead of evaluating all octaves again. Any other sample is
+// evaluated, so the output doesn't depend on the shading order. Expansions
+// always start from an evaluated point so that errors don't accumulate.
+//
+// The key only matches the same hit point at another time. Camera samples
+// each have their own time so they never match: in practice this is the
+// displacement of deforming geometry, evaluated once per motion key at each
+// vertex. Each stored point also pays for a gradient evaluation, which is
+// only worth it when the evaluator has an analytic gradient and the
+// following keys are reused.
+class FractalSampleReuse
+{
+public:
+   
+   FractalSampleReuse()
+      : _valid(false)
+      , _time(0.0f)
+      , _value(0.0f)
+   {
+   }
+   
+   inline void reset()
+   {
+      _valid = false;
+   }
+   
+   // Evaluates using the evaluator bound values without octaves fading.
+   // Sets reused to tell which of the expansion or evaluation was used.
+   inline float eval(const FractalEvaluator *evaluator, const ShadingPointKey &key, float time, const Vec3 &P, float maxDistance, bool &reused)
+   {
+      if (_valid && time != _time && key == _key)
+      {
+         Vec3 D = P - _P;
+         
+         if (Dot(D, D) <= maxDistance * maxDistance)
+         {
+            reused = true;
+            return _value + Dot(_grad, D);
+         }
+      }
+      
+      _value = evaluator->eval(P, 0.0f, _grad);
+      _P = P;
+      _key = key;
+      _time = time;
+      _valid = true;
+      reused = false;
+      
+      return _value;
+   }
+   
+private:
+   
+   bool _valid;
+   ShadingPointKey _key;
+   float _time;
+   Vec3 _P;
+   Vec3 _grad;
+   float _value;
+};
+
+#endif
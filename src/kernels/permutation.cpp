@@ -0,0 +1,128 @@
+/*
+MIT License
+
+Copyright (c) 2016 Gaetan Guidet
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "permutation.h"
+#include "atomic.h"
+#include "../stegu/simplexnoise1234.h"
+#include <map>
+
+namespace
+{
+   struct Entry
+   {
+      // first so that released tables can be cast back to their entry
+      PermutationTable table;
+      int seed;
+      int refs;
+   };
+   
+   typedef std::map<int, Entry*> Registry;
+   
+   SpinLock gLock;
+   Registry gRegistry;
+   
+   void Build(int seed, PermutationTable &table)
+   {
+      unsigned char values[256];
+      
+      const unsigned char *reference = SimplexNoise1234::permutation();
+      
+      for (int i=0; i<256; ++i)
+      {
+         values[i] = reference[i];
+      }
+      
+      if (seed != 0)
+      {
+         // Fisher-Yates shuffle of the reference table driven by a xorshift
+         // generator, seeds are scrambled first so that consecutive ones
+         // give unrelated sequences
+         uint32_t state = (uint32_t)seed * 2654435761u;
+         state ^= (state >> 16);
+         if (state == 0)
+         {
+            state = 0x9E3779B9u;
+         }
+         
+         for (int i=255; i>0; --i)
+         {
+            state ^= (state << 13);
+            state ^= (state >> 17);
+            state ^= (state << 5);
+            
+            int j = int(state % uint32_t(i + 1));
+            
+            unsigned char tmp = values[i];
+            values[i] = values[j];
+            values[j] = tmp;
+         }
+      }
+      
+      for (int i=0; i<512; ++i)
+      {
+         table.perm[i] = values[i & 255];
+         table.iperm[i] = values[i & 255];
+      }
+   }
+}
+
+const PermutationTable* AcquirePermutationTable(int seed)
+{
+   ScopedSpinLock lock(gLock);
+   
+   Registry::iterator it = gRegistry.find(seed);
+   
+   if (it == gRegistry.end())
+   {
+      Entry *entry = new Entry();
+      entry->seed = seed;
+      entry->refs = 0;
+      Build(seed, entry->table);
+      it = gRegistry.insert(Registry::value_type(seed, entry)).first;
+   }
+   
+   ++(it->second->refs);
+   
+   return &(it->second->table);
+}
+
+void ReleasePermutationTable(const PermutationTable *table)
+{
+   if (!table)
+   {
+      return;
+   }
+   
+   const Entry *entry = reinterpret_cast<const Entry*>(table);
+   
+   ScopedSpinLock lock(gLock);
+   
+   Registry::iterator it = gRegistry.find(entry->seed);
+   
+   if (it != gRegistry.end() && it->second == entry && --(it->second->refs) <= 0)
+   {
+      delete it->second;
+      gRegistry.erase(it);
+   }
+}
@@ -0,0 +1,49 @@
+/*
+MIT License
+
+Copyright (c) 2016 Gaetan Guidet
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __noise_kernels_permutation_h__
+#define __noise_kernels_permutation_h__
+
+// Seeded lattice permutation tables for the simplex and flow noises. Nothing
+// in here depends on Arnold.
+
+// Same layout as the reference table in simplexnoise1234.cpp
+struct PermutationTable
+{
+   // 256 values repeated twice
+   unsigned char perm[512];
+   // same values widened to 32 bits for SIMD gathers
+   int iperm[512];
+};
+
+// Table for the given seed, built on the first request and shared by all
+// the requesters of the same seed. Seed 0 is the reference permutation.
+//
+// Meant to be called at update time, not per sample. Every acquired table
+// must be released.
+const PermutationTable* AcquirePermutationTable(int seed);
+
+void ReleasePermutationTable(const PermutationTable *table);
+
+#endif
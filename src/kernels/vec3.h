@@ -0,0 +1,116 @@
+/*
+MIT License
+
+Copyright (c) 2016 Gaetan Guidet
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __noise_kernels_vec3_h__
+#define __noise_kernels_vec3_h__
+
+#include <cmath>
+
+// Minimal 3D vector used by the noise kernels, see ToVec3/ToAtVector in
+// common.h for conversions from/to Arnold's AtVector
+
+struct Vec3
+{
+   float x;
+   float y;
+   float z;
+   
+   inline Vec3()
+   {
+   }
+   
+   inline Vec3(float _x, float _y, float _z)
+      : x(_x), y(_y), z(_z)
+   {
+   }
+   
+   inline Vec3 operator-() const
+   {
+      return Vec3(-x, -y, -z);
+   }
+   
+   inline Vec3 operator+(const Vec3 &rhs) const
+   {
+      return Vec3(x + rhs.x, y + rhs.y, z + rhs.z);
+   }
+   
+   inline Vec3 operator-(const Vec3 &rhs) const
+   {
+      return Vec3(x - rhs.x, y - rhs.y, z - rhs.z);
+   }
+   
+   inline Vec3 operator*(float s) const
+   {
+      return Vec3(x * s, y * s, z * s);
+   }
+   
+   inline Vec3& operator+=(const Vec3 &rhs)
+   {
+      x += rhs.x;
+      y += rhs.y;
+      z += rhs.z;
+      return *this;
+   }
+   
+   inline Vec3& operator-=(const Vec3 &rhs)
+   {
+      x -= rhs.x;
+      y -= rhs.y;
+      z -= rhs.z;
+      return *this;
+   }
+   
+   inline Vec3& operator*=(float s)
+   {
+      x *= s;
+      y *= s;
+      z *= s;
+      return *this;
+   }
+};
+
+inline Vec3 operator*(float s, const Vec3 &v)
+{
+   return v * s;
+}
+
+inline float Dot(const Vec3 &v0, const Vec3 &v1)
+{
+   return v0.x * v1.x + v0.y * v1.y + v0.z * v1.z;
+}
+
+inline float Length(const Vec3 &v)
+{
+   return sqrtf(Dot(v, v));
+}
+
+// Same as AiClamp: min(max(v, lo), hi)
+template <typename T>
+inline T Clamp(T v, T lo, T hi)
+{
+   T rv = (v > lo ? v : lo);
+   return (rv < hi ? rv : hi);
+}
+
+#endif
@@ -0,0 +1,363 @@
+/*
+MIT License
+
+Copyright (c) 2016 Gaetan Guidet
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __noise_kernels_voronoi_h__
+#define __noise_kernels_voronoi_h__
+
+// Voronoi (cellular) noise kernels. Nothing in here depends on Arnold.
+
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <stdint.h>
+#include "vec3.h"
+#include "../libnoise/noisegen.h"
+
+// Number of entries in the per thread feature point cache, as a power of 2
+#ifndef VORONOI_CACHE_BITS
+#  define VORONOI_CACHE_BITS 10
+#endif
+
+
+inline float ManhattanDistance(const Vec3 &p1, const Vec3 &p2)
+{
+   return fabsf(p1.x - p2.x) + fabsf(p1.y - p2.y) + fabsf(p1.z - p2.z);
+}
+
+inline float EuclidianDistance(const Vec3 &p1, const Vec3 &p2)
+{
+   return Length(p1 - p2);
+}
+
+inline float ChebyshevDistance(const Vec3 &p1, const Vec3 &p2)
+{
+   Vec3 diff = p1 - p2;
+   return std::max(std::max(fabsf(diff.x), fabsf(diff.y)), fabsf(diff.z));
+}
+
+enum DistanceFunc
+{
+   DF_euclidian = 0,
+   DF_manhattan,
+   DF_chebyshev
+};
+
+// Distance metrics used by the cell search
+
+struct EuclidianMetric
+{
+   static inline float Distance(const Vec3 &p1, const Vec3 &p2)
+   {
+      return EuclidianDistance(p1, p2);
+   }
+};
+
+struct ManhattanMetric
+{
+   static inline float Distance(const Vec3 &p1, const Vec3 &p2)
+   {
+      return ManhattanDistance(p1, p2);
+   }
+};
+
+struct ChebyshevMetric
+{
+   static inline float Distance(const Vec3 &p1, const Vec3 &p2)
+   {
+      return ChebyshevDistance(p1, p2);
+   }
+};
+
+inline void InsertFeature(const Vec3 &Pcur, float dist, Vec3 Pf[4], float f[4])
+{
+   if (dist < f[0])
+   {
+      Pf[3] = Pf[2];
+      f[3] = f[2];
+      
+      Pf[2] = Pf[1];
+      f[2] = f[1];
+      
+      Pf[1] = Pf[0];
+      f[1] = f[0];
+      
+      Pf[0] = Pcur;
+      f[0] = dist;
+   }
+   else if (dist < f[1])
+   {
+      Pf[3] = Pf[2];
+      f[3] = f[2];
+      
+      Pf[2] = Pf[1];
+      f[2] = f[1];
+      
+      Pf[1] = Pcur;
+      f[1] = dist;
+   }
+   else if (dist < f[2])
+   {
+      Pf[3] = Pf[2];
+      f[3] = f[2];
+      
+      Pf[2] = Pcur;
+      f[2] = dist;
+   }
+   else if (dist < f[3])
+   {
+      Pf[3] = Pcur;
+      f[3] = dist;
+   }
+}
+
+// Jittered feature point of a cell
+inline Vec3 FeaturePoint(int x, int y, int z, int seed)
+{
+   Vec3 P;
+   P.x = x + float(noise::ValueNoise3D(x, y, z, seed));
+   P.y = y + float(noise::ValueNoise3D(x, y, z, seed+1));
+   P.z = z + float(noise::ValueNoise3D(x, y, z, seed+2));
+   return P;
+}
+
+// Feature points computed on every lookup, same interface as FeatureCache
+struct FeaturePoints
+{
+   inline Vec3 get(int x, int y, int z, int seed) const
+   {
+      return FeaturePoint(x, y, z, seed);
+   }
+};
+
+// Direct mapped cache of cell feature points.
+//
+// Each shading thread owns one (see VoronoiData) so no synchronization is
+// needed. Only pays off when consecutive samples are close to each other
+// (camera rays over a surface, texture baking): with incoherent samples
+// almost every lookup misses and the cache is slower than FeaturePoints.
+class FeatureCache
+{
+public:
+   
+   static const unsigned int Size = (1 << VORONOI_CACHE_BITS);
+   
+   FeatureCache()
+      : _hits(0)
+      , _misses(0)
+   {
+      for (unsigned int i=0; i<Size; ++i)
+      {
+         _entries[i].valid = false;
+      }
+   }
+   
+   inline const Vec3& get(int x, int y, int z, int seed)
+   {
+      unsigned int h = (unsigned int)x * 73856093u ^ (unsigned int)y * 19349663u ^ (unsigned int)z * 83492791u ^ (unsigned int)seed * 2654435761u;
+      Entry &e = _entries[(h ^ (h >> VORONOI_CACHE_BITS)) & (Size - 1)];
+      
+      if (e.valid && e.x == x && e.y == y && e.z == z && e.seed == seed)
+      {
+         ++_hits;
+      }
+      else
+      {
+         ++_misses;
+         e.valid = true;
+         e.x = x;
+         e.y = y;
+         e.z = z;
+         e.seed = seed;
+         e.P = FeaturePoint(x, y, z, seed);
+      }
+      
+      return e.P;
+   }
+   
+   inline uint64_t hits() const
+   {
+      return _hits;
+   }
+   
+   inline uint64_t misses() const
+   {
+      return _misses;
+   }
+   
+private:
+   
+   struct Entry
+   {
+      int x;
+      int y;
+      int z;
+      int seed;
+      bool valid;
+      Vec3 P;
+   };
+   
+   Entry _entries[Size];
+   uint64_t _hits;
+   uint64_t _misses;
+};
+
+// Find the 4 closest feature points to P in the 5x5x5 cells around it.
+//
+// ValueNoise3D places the feature point of cell c anywhere in (c - 1, c + 3]
+// (see IntValueNoise3D in noisegen.cpp), too wide for distance bounds to
+// prune enough cells to pay for themselves, so all of them are visited.
+// Feature points are read from cells (FeatureCache or FeaturePoints).
+template <typename Metric, typename TCells>
+void FindFeatures(TCells &cells, const Vec3 &P, int seed, Vec3 Pf[4], float f[4])
+{
+   int xbase = int(floorf(P.x));
+   int ybase = int(floorf(P.y));
+   int zbase = int(floorf(P.z));
+   
+   // Inside each unit cube, there is a seed point at a random position.  Go
+   // through each of the nearby cubes until we find a cube with a seed point
+   // that is closest to the specified position.
+   for (int zcur=zbase-2; zcur<=zbase+2; ++zcur)
+   {
+      for (int ycur=ybase-2; ycur<=ybase+2; ++ycur)
+      {
+         for (int xcur=xbase-2; xcur<=xbase+2; ++xcur)
+         {
+            // Calculate the position and distance to the seed point inside of this unit cube.
+            Vec3 Pcur = cells.get(xcur, ycur, zcur, seed);
+            
+            InsertFeature(Pcur, Metric::Distance(P, Pcur), Pf, f);
+         }
+      }
+   }
+}
+
+template <typename TCells>
+void FindFeatures(DistanceFunc func, TCells &cells, const Vec3 &P, int seed, Vec3 Pf[4], float f[4])
+{
+   switch (func)
+   {
+   case DF_manhattan:
+      FindFeatures<ManhattanMetric>(cells, P, seed, Pf, f);
+      break;
+   case DF_chebyshev:
+      FindFeatures<ChebyshevMetric>(cells, P, seed, Pf, f);
+      break;
+   case DF_euclidian:
+   default:
+      FindFeatures<EuclidianMetric>(cells, P, seed, Pf, f);
+   }
+}
+
+enum OutputMode
+{
+   OM_constant = 0,
+   OM_f1,
+   OM_f2,
+   OM_f3,
+   OM_f4,
+   OM_add,
+   OM_sub,
+   OM_mul,
+   OM_weighted
+};
+
+// Combine the closest feature points (as found by FindFeatures) for the given
+// output mode. weights (4 values) are only read in OM_weighted mode
+inline float VoronoiOutput(OutputMode mode, float displacement, const Vec3 Pf[4], const float f[4], const float *weights)
+{
+   switch (mode)
+   {
+   case OM_constant:
+      return displacement * 0.5f * (1.0f + float(noise::ValueNoise3D(int(floorf(Pf[0].x)), int(floorf(Pf[0].y)), int(floorf(Pf[0].z)))));
+   case OM_f1:
+      return displacement * f[0];
+   case OM_f2:
+      return displacement * f[1];
+   case OM_f3:
+      return displacement * f[2];
+   case OM_f4:
+      return displacement * f[3];
+   case OM_add:
+      return displacement * (f[0] + f[1]);
+   case OM_sub:
+      return displacement * (f[1] - f[0]);
+   case OM_mul:
+      return displacement * (f[0] * f[1]);
+   case OM_weighted:
+      return displacement * (weights[0] * f[0] + weights[1] * f[1] + weights[2] * f[2] + weights[3] * f[3]);
+   default:
+      return 0.0f;
+   }
+}
+
+// Fully resolved voronoi parameters
+struct VoronoiValues
+{
+   float displacement;
+   float frequency;
+   int seed;
+   DistanceFunc distance_func;
+   OutputMode output_mode;
+   // only read in OM_weighted mode
+   float weights[4];
+};
+
+template <typename Metric, typename TCells>
+void EvalVoronoiBatch(TCells &cells, const VoronoiValues &values, size_t n, const float *x, const float *y, const float *z, float *out)
+{
+   for (size_t i=0; i<n; ++i)
+   {
+      Vec3 P(x[i] * values.frequency, y[i] * values.frequency, z[i] * values.frequency);
+      Vec3 Pf[4] = {P, P, P, P};
+      float f[4] = {2147483647.0f, 2147483647.0f, 2147483647.0f, 2147483647.0f};
+      
+      FindFeatures<Metric>(cells, P, values.seed, Pf, f);
+      
+      out[i] = VoronoiOutput(values.output_mode, values.displacement, Pf, f, values.weights);
+   }
+}
+
+// Evaluate n points given in SoA layout (x, y and z arrays) as the voronoi
+// shader does, with the metric dispatch hoisted out of the points loop.
+// cells is a FeatureCache, which must not be shared with other threads, or
+// FeaturePoints.
+template <typename TCells>
+void EvalVoronoiBatch(TCells &cells, const VoronoiValues &values, size_t n, const float *x, const float *y, const float *z, float *out)
+{
+   switch (values.distance_func)
+   {
+   case DF_manhattan:
+      EvalVoronoiBatch<ManhattanMetric>(cells, values, n, x, y, z, out);
+      break;
+   case DF_chebyshev:
+      EvalVoronoiBatch<ChebyshevMetric>(cells, values, n, x, y, z, out);
+      break;
+   case DF_euclidian:
+   default:
+      EvalVoronoiBatch<EuclidianMetric>(cells, values, n, x, y, z, out);
+   }
+}
+
+#endif
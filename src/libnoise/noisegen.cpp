@@ -1,220 +1,803 @@
-// noisegen.cpp
-//
-// Copyright (C) 2003, 2004 Jason Bevins
-//
-// This library is free software; you can redistribute it and/or modify it
-// under the terms of the GNU Lesser General Public License as published by
-// the Free Software Foundation; either version 2.1 of the License, or (at
-// your option) any later version.
-//
-// This library is distributed in the hope that it will be useful, but WITHOUT
-// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
-// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
-// License (COPYING.txt) for more details.
-//
-// You should have received a copy of the GNU Lesser General Public License
-// along with this library; if not, write to the Free Software Foundation,
-// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
-//
-// The developer's email is jlbezigvins@gmzigail.com (for great email, take
-// off every 'zig'.)
-//
-
-#include "noisegen.h"
-#include "interp.h"
-#include "vectortable.h"
-
-using namespace noise;
-
-// Specifies the version of the coherent-noise functions to use.
-// - Set to 2 to use the current version.
-// - Set to 1 to use the flawed version from the original version of libnoise.
-// If your application requires coherent-noise values that were generated by
-// an earlier version of libnoise, change this constant to the appropriate
-// value and recompile libnoise.
-#define NOISE_VERSION 2
-
-// These constants control certain parameters that all coherent-noise
-// functions require.
-#if (NOISE_VERSION == 1)
-// Constants used by the original version of libnoise.
-// Because X_NOISE_GEN is not relatively prime to the other values, and
-// Z_NOISE_GEN is close to 256 (the number of random gradient vectors),
-// patterns show up in high-frequency coherent noise.
-const int X_NOISE_GEN = 1;
-const int Y_NOISE_GEN = 31337;
-const int Z_NOISE_GEN = 263;
-const int SEED_NOISE_GEN = 1013;
-const int SHIFT_NOISE_GEN = 13;
-#else
-// Constants used by the current version of libnoise.
-const int X_NOISE_GEN = 1619;
-const int Y_NOISE_GEN = 31337;
-const int Z_NOISE_GEN = 6971;
-const int SEED_NOISE_GEN = 1013;
-const int SHIFT_NOISE_GEN = 8;
-#endif
-
-double noise::GradientCoherentNoise3D (double x, double y, double z, int seed,
-  NoiseQuality noiseQuality)
-{
-  // Create a unit-length cube aligned along an integer boundary.  This cube
-  // surrounds the input point.
-  int x0 = (x > 0.0? (int)x: (int)x - 1);
-  int x1 = x0 + 1;
-  int y0 = (y > 0.0? (int)y: (int)y - 1);
-  int y1 = y0 + 1;
-  int z0 = (z > 0.0? (int)z: (int)z - 1);
-  int z1 = z0 + 1;
-
-  // Map the difference between the coordinates of the input value and the
-  // coordinates of the cube's outer-lower-left vertex onto an S-curve.
-  double xs = 0, ys = 0, zs = 0;
-  switch (noiseQuality) {
-    case QUALITY_FAST:
-      xs = (x - (double)x0);
-      ys = (y - (double)y0);
-      zs = (z - (double)z0);
-      break;
-    case QUALITY_STD:
-      xs = SCurve3 (x - (double)x0);
-      ys = SCurve3 (y - (double)y0);
-      zs = SCurve3 (z - (double)z0);
-      break;
-    case QUALITY_BEST:
-      xs = SCurve5 (x - (double)x0);
-      ys = SCurve5 (y - (double)y0);
-      zs = SCurve5 (z - (double)z0);
-      break;
-  }
-
-  // Now calculate the noise values at each vertex of the cube.  To generate
-  // the coherent-noise value at the input point, interpolate these eight
-  // noise values using the S-curve value as the interpolant (trilinear
-  // interpolation.)
-  double n0, n1, ix0, ix1, iy0, iy1;
-  n0   = GradientNoise3D (x, y, z, x0, y0, z0, seed);
-  n1   = GradientNoise3D (x, y, z, x1, y0, z0, seed);
-  ix0  = LinearInterp (n0, n1, xs);
-  n0   = GradientNoise3D (x, y, z, x0, y1, z0, seed);
-  n1   = GradientNoise3D (x, y, z, x1, y1, z0, seed);
-  ix1  = LinearInterp (n0, n1, xs);
-  iy0  = LinearInterp (ix0, ix1, ys);
-  n0   = GradientNoise3D (x, y, z, x0, y0, z1, seed);
-  n1   = GradientNoise3D (x, y, z, x1, y0, z1, seed);
-  ix0  = LinearInterp (n0, n1, xs);
-  n0   = GradientNoise3D (x, y, z, x0, y1, z1, seed);
-  n1   = GradientNoise3D (x, y, z, x1, y1, z1, seed);
-  ix1  = LinearInterp (n0, n1, xs);
-  iy1  = LinearInterp (ix0, ix1, ys);
-
-  return LinearInterp (iy0, iy1, zs);
-}
-
-double noise::GradientNoise3D (double fx, double fy, double fz, int ix,
-  int iy, int iz, int seed)
-{
-  // Randomly generate a gradient vector given the integer coordinates of the
-  // input value.  This implementation generates a random number and uses it
-  // as an index into a normalized-vector lookup table.
-  int vectorIndex = (
-      X_NOISE_GEN    * ix
-    + Y_NOISE_GEN    * iy
-    + Z_NOISE_GEN    * iz
-    + SEED_NOISE_GEN * seed)
-    & 0xffffffff;
-  vectorIndex ^= (vectorIndex >> SHIFT_NOISE_GEN);
-  vectorIndex &= 0xff;
-
-  double xvGradient = g_randomVectors[(vectorIndex << 2)    ];
-  double yvGradient = g_randomVectors[(vectorIndex << 2) + 1];
-  double zvGradient = g_randomVectors[(vectorIndex << 2) + 2];
-
-  // Set up us another vector equal to the distance between the two vectors
-  // passed to this function.
-  double xvPoint = (fx - (double)ix);
-  double yvPoint = (fy - (double)iy);
-  double zvPoint = (fz - (double)iz);
-
-  // Now compute the dot product of the gradient vector with the distance
-  // vector.  The resulting value is gradient noise.  Apply a scaling value
-  // so that this noise value ranges from -1.0 to 1.0.
-  return ((xvGradient * xvPoint)
-    + (yvGradient * yvPoint)
-    + (zvGradient * zvPoint)) * 2.12;
-}
-
-int noise::IntValueNoise3D (int x, int y, int z, int seed)
-{
-  // All constants are primes and must remain prime in order for this noise
-  // function to work correctly.
-  int n = (
-      X_NOISE_GEN    * x
-    + Y_NOISE_GEN    * y
-    + Z_NOISE_GEN    * z
-    + SEED_NOISE_GEN * seed)
-    & 0x7fffffff;
-  n = (n >> 13) ^ n;
-  return (n * (n * n * 60493 + 19990303) + 1376312589) & 0x7fffffff;
-}
-
-double noise::ValueCoherentNoise3D (double x, double y, double z, int seed,
-  NoiseQuality noiseQuality)
-{
-  // Create a unit-length cube aligned along an integer boundary.  This cube
-  // surrounds the input point.
-  int x0 = (x > 0.0? (int)x: (int)x - 1);
-  int x1 = x0 + 1;
-  int y0 = (y > 0.0? (int)y: (int)y - 1);
-  int y1 = y0 + 1;
-  int z0 = (z > 0.0? (int)z: (int)z - 1);
-  int z1 = z0 + 1;
-
-  // Map the difference between the coordinates of the input value and the
-  // coordinates of the cube's outer-lower-left vertex onto an S-curve.
-  double xs = 0, ys = 0, zs = 0;
-  switch (noiseQuality) {
-    case QUALITY_FAST:
-      xs = (x - (double)x0);
-      ys = (y - (double)y0);
-      zs = (z - (double)z0);
-      break;
-    case QUALITY_STD:
-      xs = SCurve3 (x - (double)x0);
-      ys = SCurve3 (y - (double)y0);
-      zs = SCurve3 (z - (double)z0);
-      break;
-    case QUALITY_BEST:
-      xs = SCurve5 (x - (double)x0);
-      ys = SCurve5 (y - (double)y0);
-      zs = SCurve5 (z - (double)z0);
-      break;
-  }
-
-  // Now calculate the noise values at each vertex of the cube.  To generate
-  // the coherent-noise value at the input point, interpolate these eight
-  // noise values using the S-curve value as the interpolant (trilinear
-  // interpolation.)
-  double n0, n1, ix0, ix1, iy0, iy1;
-  n0   = ValueNoise3D (x0, y0, z0, seed);
-  n1   = ValueNoise3D (x1, y0, z0, seed);
-  ix0  = LinearInterp (n0, n1, xs);
-  n0   = ValueNoise3D (x0, y1, z0, seed);
-  n1   = ValueNoise3D (x1, y1, z0, seed);
-  ix1  = LinearInterp (n0, n1, xs);
-  iy0  = LinearInterp (ix0, ix1, ys);
-  n0   = ValueNoise3D (x0, y0, z1, seed);
-  n1   = ValueNoise3D (x1, y0, z1, seed);
-  ix0  = LinearInterp (n0, n1, xs);
-  n0   = ValueNoise3D (x0, y1, z1, seed);
-  n1   = ValueNoise3D (x1, y1, z1, seed);
-  ix1  = LinearInterp (n0, n1, xs);
-  iy1  = LinearInterp (ix0, ix1, ys);
-  return LinearInterp (iy0, iy1, zs);
-}
-
-double noise::ValueNoise3D (int x, int y, int z, int seed)
-{
-  return 1.0 - ((double)IntValueNoise3D (x, y, z, seed) / 1073741824.0);
-}
-
+// noisegen.cpp
+//
+// Copyright (C) 2003, 2004 Jason Bevins
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// The developer's email is jlbezigvins@gmzigail.com (for great email, take
+// off every 'zig'.)
+//
+
+#include "noisegen.h"
+#include "interp.h"
+#include "vectortable.h"
+
+using namespace noise;
+
+// Specifies the version of the coherent-noise functions to use.
+// - Set to 2 to use the current version.
+// - Set to 1 to use the flawed version from the original version of libnoise.
+// If your application requires coherent-noise values that were generated by
+// an earlier version of libnoise, change this constant to the appropriate
+// value and recompile libnoise.
+#define NOISE_VERSION 2
+
+// These constants control certain parameters that all coherent-noise
+// functions require.
+#if (NOISE_VERSION == 1)
+// Constants used by the original version of libnoise.
+// Because X_NOISE_GEN is not relatively prime to the other values, and
+// Z_NOISE_GEN is close to 256 (the number of random gradient vectors),
+// patterns show up in high-frequency coherent noise.
+const int X_NOISE_GEN = 1;
+const int Y_NOISE_GEN = 31337;
+const int Z_NOISE_GEN = 263;
+const int SEED_NOISE_GEN = 1013;
+const int SHIFT_NOISE_GEN = 13;
+#else
+// Constants used by the current version of libnoise.
+const int X_NOISE_GEN = 1619;
+const int Y_NOISE_GEN = 31337;
+const int Z_NOISE_GEN = 6971;
+const int SEED_NOISE_GEN = 1013;
+const int SHIFT_NOISE_GEN = 8;
+#endif
+
+double noise::GradientCoherentNoise3D (double x, double y, double z, int seed,
+  NoiseQuality noiseQuality)
+{
+  // Create a unit-length cube aligned along an integer boundary.  This cube
+  // surrounds the input point.
+  int x0 = (x > 0.0? (int)x: (int)x - 1);
+  int x1 = x0 + 1;
+  int y0 = (y > 0.0? (int)y: (int)y - 1);
+  int y1 = y0 + 1;
+  int z0 = (z > 0.0? (int)z: (int)z - 1);
+  int z1 = z0 + 1;
+
+  // Map the difference between the coordinates of the input value and the
+  // coordinates of the cube's outer-lower-left vertex onto an S-curve.
+  double xs = 0, ys = 0, zs = 0;
+  switch (noiseQuality) {
+    case QUALITY_FAST:
+      xs = (x - (double)x0);
+      ys = (y - (double)y0);
+      zs = (z - (double)z0);
+      break;
+    case QUALITY_STD:
+      xs = SCurve3 (x - (double)x0);
+      ys = SCurve3 (y - (double)y0);
+      zs = SCurve3 (z - (double)z0);
+      break;
+    case QUALITY_BEST:
+      xs = SCurve5 (x - (double)x0);
+      ys = SCurve5 (y - (double)y0);
+      zs = SCurve5 (z - (double)z0);
+      break;
+  }
+
+  // Now calculate the noise values at each vertex of the cube.  To generate
+  // the coherent-noise value at the input point, interpolate these eight
+  // noise values using the S-curve value as the interpolant (trilinear
+  // interpolation.)
+  double n0, n1, ix0, ix1, iy0, iy1;
+  n0   = GradientNoise3D (x, y, z, x0, y0, z0, seed);
+  n1   = GradientNoise3D (x, y, z, x1, y0, z0, seed);
+  ix0  = LinearInterp (n0, n1, xs);
+  n0   = GradientNoise3D (x, y, z, x0, y1, z0, seed);
+  n1   = GradientNoise3D (x, y, z, x1, y1, z0, seed);
+  ix1  = LinearInterp (n0, n1, xs);
+  iy0  = LinearInterp (ix0, ix1, ys);
+  n0   = GradientNoise3D (x, y, z, x0, y0, z1, seed);
+  n1   = GradientNoise3D (x, y, z, x1, y0, z1, seed);
+  ix0  = LinearInterp (n0, n1, xs);
+  n0   = GradientNoise3D (x, y, z, x0, y1, z1, seed);
+  n1   = GradientNoise3D (x, y, z, x1, y1, z1, seed);
+  ix1  = LinearInterp (n0, n1, xs);
+  iy1  = LinearInterp (ix0, ix1, ys);
+
+  return LinearInterp (iy0, iy1, zs);
+}
+
+double noise::GradientNoise3D (double fx, double fy, double fz, int ix,
+  int iy, int iz, int seed)
+{
+  // Randomly generate a gradient vector given the integer coordinates of the
+  // input value.  This implementation generates a random number and uses it
+  // as an index into a normalized-vector lookup table.
+  int vectorIndex = (
+      X_NOISE_GEN    * ix
+    + Y_NOISE_GEN    * iy
+    + Z_NOISE_GEN    * iz
+    + SEED_NOISE_GEN * seed)
+    & 0xffffffff;
+  vectorIndex ^= (vectorIndex >> SHIFT_NOISE_GEN);
+  vectorIndex &= 0xff;
+
+  double xvGradient = g_randomVectors[(vectorIndex << 2)    ];
+  double yvGradient = g_randomVectors[(vectorIndex << 2) + 1];
+  double zvGradient = g_randomVectors[(vectorIndex << 2) + 2];
+
+  // Set up us another vector equal to the distance between the two vectors
+  // passed to this function.
+  double xvPoint = (fx - (double)ix);
+  double yvPoint = (fy - (double)iy);
+  double zvPoint = (fz - (double)iz);
+
+  // Now compute the dot product of the gradient vector with the distance
+  // vector.  The resulting value is gradient noise.  Apply a scaling value
+  // so that this noise value ranges from -1.0 to 1.0.
+  return ((xvGradient * xvPoint)
+    + (yvGradient * yvPoint)
+    + (zvGradient * zvPoint)) * 2.12;
+}
+
+int noise::IntValueNoise3D (int x, int y, int z, int seed)
+{
+  // All constants are primes and must remain prime in order for this noise
+  // function to work correctly.
+  int n = (
+      X_NOISE_GEN    * x
+    + Y_NOISE_GEN    * y
+    + Z_NOISE_GEN    * z
+    + SEED_NOISE_GEN * seed)
+    & 0x7fffffff;
+  n = (n >> 13) ^ n;
+  return (n * (n * n * 60493 + 19990303) + 1376312589) & 0x7fffffff;
+}
+
+double noise::ValueCoherentNoise3D (double x, double y, double z, int seed,
+  NoiseQuality noiseQuality)
+{
+  // Create a unit-length cube aligned along an integer boundary.  This cube
+  // surrounds the input point.
+  int x0 = (x > 0.0? (int)x: (int)x - 1);
+  int x1 = x0 + 1;
+  int y0 = (y > 0.0? (int)y: (int)y - 1);
+  int y1 = y0 + 1;
+  int z0 = (z > 0.0? (int)z: (int)z - 1);
+  int z1 = z0 + 1;
+
+  // Map the difference between the coordinates of the input value and the
+  // coordinates of the cube's outer-lower-left vertex onto an S-curve.
+  double xs = 0, ys = 0, zs = 0;
+  switch (noiseQuality) {
+    case QUALITY_FAST:
+      xs = (x - (double)x0);
+      ys = (y - (double)y0);
+      zs = (z - (double)z0);
+      break;
+    case QUALITY_STD:
+      xs = SCurve3 (x - (double)x0);
+      ys = SCurve3 (y - (double)y0);
+      zs = SCurve3 (z - (double)z0);
+      break;
+    case QUALITY_BEST:
+      xs = SCurve5 (x - (double)x0);
+      ys = SCurve5 (y - (double)y0);
+      zs = SCurve5 (z - (double)z0);
+      break;
+  }
+
+  // Now calculate the noise values at each vertex of the cube.  To generate
+  // the coherent-noise value at the input point, interpolate these eight
+  // noise values using the S-curve value as the interpolant (trilinear
+  // interpolation.)
+  double n0, n1, ix0, ix1, iy0, iy1;
+  n0   = ValueNoise3D (x0, y0, z0, seed);
+  n1   = ValueNoise3D (x1, y0, z0, seed);
+  ix0  = LinearInterp (n0, n1, xs);
+  n0   = ValueNoise3D (x0, y1, z0, seed);
+  n1   = ValueNoise3D (x1, y1, z0, seed);
+  ix1  = LinearInterp (n0, n1, xs);
+  iy0  = LinearInterp (ix0, ix1, ys);
+  n0   = ValueNoise3D (x0, y0, z1, seed);
+  n1   = ValueNoise3D (x1, y0, z1, seed);
+  ix0  = LinearInterp (n0, n1, xs);
+  n0   = ValueNoise3D (x0, y1, z1, seed);
+  n1   = ValueNoise3D (x1, y1, z1, seed);
+  ix1  = LinearInterp (n0, n1, xs);
+  iy1  = LinearInterp (ix0, ix1, ys);
+  return LinearInterp (iy0, iy1, zs);
+}
+
+double noise::ValueNoise3D (int x, int y, int z, int seed)
+{
+  return 1.0 - ((double)IntValueNoise3D (x, y, z, seed) / 1073741824.0);
+}
+
+
+// Single precision versions
+
+namespace
+{
+
+  // Same cell selection as the double precision functions (points lying on an
+  // integer boundary <= 0 use the lower cell), without the branch.
+  inline int LatticeFloor (float x)
+  {
+    return (int)x - (x <= 0.0f ? 1 : 0);
+  }
+
+  template <NoiseQuality noiseQuality>
+  inline float SCurve (float a);
+
+  template <>
+  inline float SCurve<QUALITY_FAST> (float a)
+  {
+    return a;
+  }
+
+  template <>
+  inline float SCurve<QUALITY_STD> (float a)
+  {
+    return SCurve3 (a);
+  }
+
+  template <>
+  inline float SCurve<QUALITY_BEST> (float a)
+  {
+    return SCurve5 (a);
+  }
+
+  template <NoiseQuality noiseQuality>
+  inline float SCurveDerivative (float a);
+
+  template <>
+  inline float SCurveDerivative<QUALITY_FAST> (float)
+  {
+    return 1.0f;
+  }
+
+  template <>
+  inline float SCurveDerivative<QUALITY_STD> (float a)
+  {
+    return SCurve3Derivative (a);
+  }
+
+  template <>
+  inline float SCurveDerivative<QUALITY_BEST> (float a)
+  {
+    return SCurve5Derivative (a);
+  }
+
+}
+
+template <NoiseQuality noiseQuality>
+float noise::GradientCoherentNoise3DF (float x, float y, float z, int seed)
+{
+  // Create a unit-length cube aligned along an integer boundary.  This cube
+  // surrounds the input point.
+  int x0 = LatticeFloor (x);
+  int x1 = x0 + 1;
+  int y0 = LatticeFloor (y);
+  int y1 = y0 + 1;
+  int z0 = LatticeFloor (z);
+  int z1 = z0 + 1;
+
+  // Map the difference between the coordinates of the input value and the
+  // coordinates of the cube's outer-lower-left vertex onto an S-curve.
+  float xs = SCurve<noiseQuality> (x - (float)x0);
+  float ys = SCurve<noiseQuality> (y - (float)y0);
+  float zs = SCurve<noiseQuality> (z - (float)z0);
+
+  // Now calculate the noise values at each vertex of the cube.
+  float n0, n1, ix0, ix1, iy0, iy1;
+  n0   = GradientNoise3DF (x, y, z, x0, y0, z0, seed);
+  n1   = GradientNoise3DF (x, y, z, x1, y0, z0, seed);
+  ix0  = LinearInterp (n0, n1, xs);
+  n0   = GradientNoise3DF (x, y, z, x0, y1, z0, seed);
+  n1   = GradientNoise3DF (x, y, z, x1, y1, z0, seed);
+  ix1  = LinearInterp (n0, n1, xs);
+  iy0  = LinearInterp (ix0, ix1, ys);
+  n0   = GradientNoise3DF (x, y, z, x0, y0, z1, seed);
+  n1   = GradientNoise3DF (x, y, z, x1, y0, z1, seed);
+  ix0  = LinearInterp (n0, n1, xs);
+  n0   = GradientNoise3DF (x, y, z, x0, y1, z1, seed);
+  n1   = GradientNoise3DF (x, y, z, x1, y1, z1, seed);
+  ix1  = LinearInterp (n0, n1, xs);
+  iy1  = LinearInterp (ix0, ix1, ys);
+
+  return LinearInterp (iy0, iy1, zs);
+}
+
+float noise::GradientNoise3DF (float fx, float fy, float fz, int ix,
+  int iy, int iz, int seed)
+{
+  int vectorIndex = (
+      X_NOISE_GEN    * ix
+    + Y_NOISE_GEN    * iy
+    + Z_NOISE_GEN    * iz
+    + SEED_NOISE_GEN * seed)
+    & 0xffffffff;
+  vectorIndex ^= (vectorIndex >> SHIFT_NOISE_GEN);
+  vectorIndex &= 0xff;
+
+  const float *gradient = g_randomVectorsF + (vectorIndex << 2);
+
+  float xvPoint = (fx - (float)ix);
+  float yvPoint = (fy - (float)iy);
+  float zvPoint = (fz - (float)iz);
+
+  return ((gradient[0] * xvPoint)
+    + (gradient[1] * yvPoint)
+    + (gradient[2] * zvPoint)) * 2.12f;
+}
+
+template <NoiseQuality noiseQuality>
+float noise::ValueCoherentNoise3DF (float x, float y, float z, int seed)
+{
+  // Create a unit-length cube aligned along an integer boundary.  This cube
+  // surrounds the input point.
+  int x0 = LatticeFloor (x);
+  int x1 = x0 + 1;
+  int y0 = LatticeFloor (y);
+  int y1 = y0 + 1;
+  int z0 = LatticeFloor (z);
+  int z1 = z0 + 1;
+
+  // Map the difference between the coordinates of the input value and the
+  // coordinates of the cube's outer-lower-left vertex onto an S-curve.
+  float xs = SCurve<noiseQuality> (x - (float)x0);
+  float ys = SCurve<noiseQuality> (y - (float)y0);
+  float zs = SCurve<noiseQuality> (z - (float)z0);
+
+  // Now calculate the noise values at each vertex of the cube.
+  float n0, n1, ix0, ix1, iy0, iy1;
+  n0   = ValueNoise3DF (x0, y0, z0, seed);
+  n1   = ValueNoise3DF (x1, y0, z0, seed);
+  ix0  = LinearInterp (n0, n1, xs);
+  n0   = ValueNoise3DF (x0, y1, z0, seed);
+  n1   = ValueNoise3DF (x1, y1, z0, seed);
+  ix1  = LinearInterp (n0, n1, xs);
+  iy0  = LinearInterp (ix0, ix1, ys);
+  n0   = ValueNoise3DF (x0, y0, z1, seed);
+  n1   = ValueNoise3DF (x1, y0, z1, seed);
+  ix0  = LinearInterp (n0, n1, xs);
+  n0   = ValueNoise3DF (x0, y1, z1, seed);
+  n1   = ValueNoise3DF (x1, y1, z1, seed);
+  ix1  = LinearInterp (n0, n1, xs);
+  iy1  = LinearInterp (ix0, ix1, ys);
+  return LinearInterp (iy0, iy1, zs);
+}
+
+float noise::ValueNoise3DF (int x, int y, int z, int seed)
+{
+  return 1.0f - ((float)IntValueNoise3D (x, y, z, seed) / 1073741824.0f);
+}
+
+// Batched lattice versions
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define NOISE_LATTICE_SSE2
+#  include <emmintrin.h>
+#endif
+
+namespace
+{
+
+  // Both hashes start with a linear combination of the lattice coordinates:
+  // the linear part of corner i, at (x0 + (i & 1), y0 + ((i >> 1) & 1),
+  // z0 + (i >> 2)), is the one of corner 0 plus a per corner constant.  The
+  // corners are in the order the unbatched functions interpolate them.
+
+  template <NoiseHash noiseHash>
+  struct LatticeHash;
+
+  template <>
+  struct LatticeHash<HASH_LEGACY>
+  {
+    static const uint32 X = X_NOISE_GEN;
+    static const uint32 Y = Y_NOISE_GEN;
+    static const uint32 Z = Z_NOISE_GEN;
+    static const uint32 SEED = SEED_NOISE_GEN;
+
+    static inline uint32 GradientIndex (uint32 n)
+    {
+      return (n ^ (n >> SHIFT_NOISE_GEN)) & 0xff;
+    }
+
+    // IntValueNoise3D computes this in signed arithmetic. Optimizing
+    // compilers assume it doesn't overflow, hence that its result is
+    // positive, and drop its final mask: match the values renders have
+    // always used.
+    static inline uint32 Value (uint32 n)
+    {
+      n &= 0x7fffffff;
+      n = (n >> 13) ^ n;
+      return n * (n * n * 60493 + 19990303) + 1376312589;
+    }
+  };
+
+  template <>
+  struct LatticeHash<HASH_XX>
+  {
+    static const uint32 X = 0x9e3779b1;
+    static const uint32 Y = 0x27d4eb2f;
+    static const uint32 Z = 0x165667b1;
+    static const uint32 SEED = 0x85ebca77;
+
+    static inline uint32 Mix (uint32 h)
+    {
+      h ^= h >> 15;
+      h *= 0x85ebca77;
+      h ^= h >> 13;
+      h *= 0xc2b2ae3d;
+      h ^= h >> 16;
+      return h;
+    }
+
+    static inline uint32 GradientIndex (uint32 n)
+    {
+      return Mix (n) & 0xff;
+    }
+
+    static inline uint32 Value (uint32 n)
+    {
+      return Mix (n) & 0x7fffffff;
+    }
+  };
+
+  template <NoiseHash noiseHash>
+  inline uint32 LatticeLinear (int x, int y, int z, int seed)
+  {
+    typedef LatticeHash<noiseHash> Hash;
+    return Hash::X * (uint32)x + Hash::Y * (uint32)y + Hash::Z * (uint32)z
+      + Hash::SEED * (uint32)seed;
+  }
+
+  // Same interpolation order as the unbatched functions
+  inline float InterpCorners (const float n[8], float xs, float ys, float zs)
+  {
+    float ix0, ix1, iy0, iy1;
+    ix0  = LinearInterp (n[0], n[1], xs);
+    ix1  = LinearInterp (n[2], n[3], xs);
+    iy0  = LinearInterp (ix0, ix1, ys);
+    ix0  = LinearInterp (n[4], n[5], xs);
+    ix1  = LinearInterp (n[6], n[7], xs);
+    iy1  = LinearInterp (ix0, ix1, ys);
+    return LinearInterp (iy0, iy1, zs);
+  }
+
+  // Partial derivatives of InterpCorners() along xs, ys and zs
+  inline void InterpCornersDerivatives (const float n[8], float xs, float ys,
+    float zs, float &dxs, float &dys, float &dzs)
+  {
+    float ix0 = LinearInterp (n[0], n[1], xs);
+    float ix1 = LinearInterp (n[2], n[3], xs);
+    float ix2 = LinearInterp (n[4], n[5], xs);
+    float ix3 = LinearInterp (n[6], n[7], xs);
+    dxs = LinearInterp (LinearInterp (n[1] - n[0], n[3] - n[2], ys),
+      LinearInterp (n[5] - n[4], n[7] - n[6], ys), zs);
+    dys = LinearInterp (ix1 - ix0, ix3 - ix2, zs);
+    dzs = LinearInterp (ix2, ix3, ys) - LinearInterp (ix0, ix1, ys);
+  }
+
+#ifdef NOISE_LATTICE_SSE2
+
+  // SSE2 has no 32-bit low multiply
+  inline __m128i MulLo (__m128i a, __m128i b)
+  {
+    __m128i even = _mm_mul_epu32 (a, b);
+    __m128i odd = _mm_mul_epu32 (_mm_srli_epi64 (a, 32), _mm_srli_epi64 (b, 32));
+    return _mm_unpacklo_epi32 (_mm_shuffle_epi32 (even, _MM_SHUFFLE (0, 0, 2, 0)),
+      _mm_shuffle_epi32 (odd, _MM_SHUFFLE (0, 0, 2, 0)));
+  }
+
+  template <NoiseHash noiseHash>
+  struct LatticeLanes;
+
+  template <>
+  struct LatticeLanes<HASH_LEGACY>
+  {
+    static inline __m128i GradientIndex (__m128i n)
+    {
+      return _mm_and_si128 (_mm_xor_si128 (n, _mm_srli_epi32 (n, SHIFT_NOISE_GEN)),
+        _mm_set1_epi32 (0xff));
+    }
+
+    static inline __m128i Value (__m128i n)
+    {
+      const __m128i mask = _mm_set1_epi32 (0x7fffffff);
+      n = _mm_and_si128 (n, mask);
+      n = _mm_xor_si128 (_mm_srli_epi32 (n, 13), n);
+      __m128i n2 = _mm_add_epi32 (MulLo (MulLo (n, n), _mm_set1_epi32 (60493)),
+        _mm_set1_epi32 (19990303));
+      // no final mask, see LatticeHash<HASH_LEGACY>::Value
+      return _mm_add_epi32 (MulLo (n, n2), _mm_set1_epi32 (1376312589));
+    }
+  };
+
+  template <>
+  struct LatticeLanes<HASH_XX>
+  {
+    static inline __m128i Mix (__m128i h)
+    {
+      h = _mm_xor_si128 (h, _mm_srli_epi32 (h, 15));
+      h = MulLo (h, _mm_set1_epi32 ((int)0x85ebca77));
+      h = _mm_xor_si128 (h, _mm_srli_epi32 (h, 13));
+      h = MulLo (h, _mm_set1_epi32 ((int)0xc2b2ae3d));
+      return _mm_xor_si128 (h, _mm_srli_epi32 (h, 16));
+    }
+
+    static inline __m128i GradientIndex (__m128i n)
+    {
+      return _mm_and_si128 (Mix (n), _mm_set1_epi32 (0xff));
+    }
+
+    static inline __m128i Value (__m128i n)
+    {
+      return _mm_and_si128 (Mix (n), _mm_set1_epi32 (0x7fffffff));
+    }
+  };
+
+  // Linear hash parts of the z0 (lo) and z1 (hi) faces of the cell
+  template <NoiseHash noiseHash>
+  inline void CornerLinear (int x0, int y0, int z0, int seed, __m128i &lo,
+    __m128i &hi)
+  {
+    typedef LatticeHash<noiseHash> Hash;
+    lo = _mm_add_epi32 (_mm_set1_epi32 ((int)LatticeLinear<noiseHash> (x0, y0, z0, seed)),
+      _mm_setr_epi32 (0, (int)Hash::X, (int)Hash::Y, (int)(Hash::X + Hash::Y)));
+    hi = _mm_add_epi32 (lo, _mm_set1_epi32 ((int)Hash::Z));
+  }
+
+  // Gradient vectors of 4 corners, one component per register
+  inline void CornerVectors (__m128i index, __m128 &gx, __m128 &gy, __m128 &gz)
+  {
+    int idx[4];
+    _mm_storeu_si128 ((__m128i*)idx, index);
+    gx = _mm_loadu_ps (g_randomVectorsF + (idx[0] << 2));
+    gy = _mm_loadu_ps (g_randomVectorsF + (idx[1] << 2));
+    gz = _mm_loadu_ps (g_randomVectorsF + (idx[2] << 2));
+    __m128 gw = _mm_loadu_ps (g_randomVectorsF + (idx[3] << 2));
+    _MM_TRANSPOSE4_PS (gx, gy, gz, gw);
+  }
+
+  // Gradient noise of 4 corners
+  inline __m128 CornerGradients (__m128 gx, __m128 gy, __m128 gz, __m128 xv,
+    __m128 yv, __m128 zv)
+  {
+    return _mm_mul_ps (_mm_add_ps (_mm_add_ps (_mm_mul_ps (gx, xv),
+      _mm_mul_ps (gy, yv)), _mm_mul_ps (gz, zv)), _mm_set1_ps (2.12f));
+  }
+
+  inline __m128 CornerGradients (__m128i index, __m128 xv, __m128 yv, __m128 zv)
+  {
+    __m128 gx, gy, gz;
+    CornerVectors (index, gx, gy, gz);
+    return CornerGradients (gx, gy, gz, xv, yv, zv);
+  }
+
+#endif
+
+}
+
+template <NoiseQuality noiseQuality, NoiseHash noiseHash>
+float noise::GradientLatticeNoise3DF (float x, float y, float z, int seed)
+{
+  int x0 = LatticeFloor (x);
+  int y0 = LatticeFloor (y);
+  int z0 = LatticeFloor (z);
+
+  float xs = SCurve<noiseQuality> (x - (float)x0);
+  float ys = SCurve<noiseQuality> (y - (float)y0);
+  float zs = SCurve<noiseQuality> (z - (float)z0);
+
+  float n[8];
+
+#ifdef NOISE_LATTICE_SSE2
+  __m128i lo, hi;
+  CornerLinear<noiseHash> (x0, y0, z0, seed, lo, hi);
+
+  // Same per corner offsets as GradientNoise3DF()
+  __m128i ix = _mm_add_epi32 (_mm_set1_epi32 (x0), _mm_setr_epi32 (0, 1, 0, 1));
+  __m128i iy = _mm_add_epi32 (_mm_set1_epi32 (y0), _mm_setr_epi32 (0, 0, 1, 1));
+  __m128 xv = _mm_sub_ps (_mm_set1_ps (x), _mm_cvtepi32_ps (ix));
+  __m128 yv = _mm_sub_ps (_mm_set1_ps (y), _mm_cvtepi32_ps (iy));
+
+  _mm_storeu_ps (n, CornerGradients (LatticeLanes<noiseHash>::GradientIndex (lo),
+    xv, yv, _mm_set1_ps (z - (float)z0)));
+  _mm_storeu_ps (n + 4, CornerGradients (LatticeLanes<noiseHash>::GradientIndex (hi),
+    xv, yv, _mm_set1_ps (z - (float)(z0 + 1))));
+#else
+  for (int i = 0; i < 8; ++i) {
+    int ix = x0 + (i & 1);
+    int iy = y0 + ((i >> 1) & 1);
+    int iz = z0 + (i >> 2);
+    const float *gradient = g_randomVectorsF + (LatticeHash<noiseHash>::GradientIndex (
+      LatticeLinear<noiseHash> (ix, iy, iz, seed)) << 2);
+    n[i] = ((gradient[0] * (x - (float)ix))
+      + (gradient[1] * (y - (float)iy))
+      + (gradient[2] * (z - (float)iz))) * 2.12f;
+  }
+#endif
+
+  return InterpCorners (n, xs, ys, zs);
+}
+
+namespace
+{
+
+  // Values of the 8 corners of the cell, same mapping as ValueNoise3DF()
+  template <NoiseHash noiseHash>
+  inline void ValueCorners (int x0, int y0, int z0, int seed, float n[8])
+  {
+#ifdef NOISE_LATTICE_SSE2
+    __m128i lo, hi;
+    CornerLinear<noiseHash> (x0, y0, z0, seed, lo, hi);
+
+    const __m128 one = _mm_set1_ps (1.0f);
+    const __m128 scale = _mm_set1_ps (1073741824.0f);
+    _mm_storeu_ps (n, _mm_sub_ps (one, _mm_div_ps (
+      _mm_cvtepi32_ps (LatticeLanes<noiseHash>::Value (lo)), scale)));
+    _mm_storeu_ps (n + 4, _mm_sub_ps (one, _mm_div_ps (
+      _mm_cvtepi32_ps (LatticeLanes<noiseHash>::Value (hi)), scale)));
+#else
+    for (int i = 0; i < 8; ++i) {
+      uint32 v = LatticeHash<noiseHash>::Value (LatticeLinear<noiseHash> (
+        x0 + (i & 1), y0 + ((i >> 1) & 1), z0 + (i >> 2), seed));
+      n[i] = 1.0f - ((float)(int)v / 1073741824.0f);
+    }
+#endif
+  }
+
+}
+
+template <NoiseQuality noiseQuality, NoiseHash noiseHash>
+float noise::ValueLatticeNoise3DF (float x, float y, float z, int seed)
+{
+  int x0 = LatticeFloor (x);
+  int y0 = LatticeFloor (y);
+  int z0 = LatticeFloor (z);
+
+  float xs = SCurve<noiseQuality> (x - (float)x0);
+  float ys = SCurve<noiseQuality> (y - (float)y0);
+  float zs = SCurve<noiseQuality> (z - (float)z0);
+
+  float n[8];
+  ValueCorners<noiseHash> (x0, y0, z0, seed, n);
+
+  return InterpCorners (n, xs, ys, zs);
+}
+
+template <NoiseQuality noiseQuality, NoiseHash noiseHash>
+float noise::GradientLatticeNoise3DFD (float x, float y, float z, int seed,
+  float *dx, float *dy, float *dz)
+{
+  int x0 = LatticeFloor (x);
+  int y0 = LatticeFloor (y);
+  int z0 = LatticeFloor (z);
+
+  float fx = x - (float)x0;
+  float fy = y - (float)y0;
+  float fz = z - (float)z0;
+
+  float xs = SCurve<noiseQuality> (fx);
+  float ys = SCurve<noiseQuality> (fy);
+  float zs = SCurve<noiseQuality> (fz);
+
+  // Corner noise values, linear in x, y and z, and their gradient vectors
+  float n[8], gx[8], gy[8], gz[8];
+
+#ifdef NOISE_LATTICE_SSE2
+  __m128i lo, hi;
+  CornerLinear<noiseHash> (x0, y0, z0, seed, lo, hi);
+
+  __m128i ix = _mm_add_epi32 (_mm_set1_epi32 (x0), _mm_setr_epi32 (0, 1, 0, 1));
+  __m128i iy = _mm_add_epi32 (_mm_set1_epi32 (y0), _mm_setr_epi32 (0, 0, 1, 1));
+  __m128 xv = _mm_sub_ps (_mm_set1_ps (x), _mm_cvtepi32_ps (ix));
+  __m128 yv = _mm_sub_ps (_mm_set1_ps (y), _mm_cvtepi32_ps (iy));
+  __m128 vx, vy, vz;
+
+  CornerVectors (LatticeLanes<noiseHash>::GradientIndex (lo), vx, vy, vz);
+  _mm_storeu_ps (n, CornerGradients (vx, vy, vz, xv, yv, _mm_set1_ps (z - (float)z0)));
+  _mm_storeu_ps (gx, vx);
+  _mm_storeu_ps (gy, vy);
+  _mm_storeu_ps (gz, vz);
+
+  CornerVectors (LatticeLanes<noiseHash>::GradientIndex (hi), vx, vy, vz);
+  _mm_storeu_ps (n + 4, CornerGradients (vx, vy, vz, xv, yv, _mm_set1_ps (z - (float)(z0 + 1))));
+  _mm_storeu_ps (gx + 4, vx);
+  _mm_storeu_ps (gy + 4, vy);
+  _mm_storeu_ps (gz + 4, vz);
+#else
+  for (int i = 0; i < 8; ++i) {
+    int ix = x0 + (i & 1);
+    int iy = y0 + ((i >> 1) & 1);
+    int iz = z0 + (i >> 2);
+    const float *gradient = g_randomVectorsF + (LatticeHash<noiseHash>::GradientIndex (
+      LatticeLinear<noiseHash> (ix, iy, iz, seed)) << 2);
+    n[i] = ((gradient[0] * (x - (float)ix))
+      + (gradient[1] * (y - (float)iy))
+      + (gradient[2] * (z - (float)iz))) * 2.12f;
+    gx[i] = gradient[0];
+    gy[i] = gradient[1];
+    gz[i] = gradient[2];
+  }
+#endif
+
+  float dxs, dys, dzs;
+  InterpCornersDerivatives (n, xs, ys, zs, dxs, dys, dzs);
+
+  *dx = SCurveDerivative<noiseQuality> (fx) * dxs + 2.12f * InterpCorners (gx, xs, ys, zs);
+  *dy = SCurveDerivative<noiseQuality> (fy) * dys + 2.12f * InterpCorners (gy, xs, ys, zs);
+  *dz = SCurveDerivative<noiseQuality> (fz) * dzs + 2.12f * InterpCorners (gz, xs, ys, zs);
+
+  return InterpCorners (n, xs, ys, zs);
+}
+
+template <NoiseQuality noiseQuality, NoiseHash noiseHash>
+float noise::ValueLatticeNoise3DFD (float x, float y, float z, int seed,
+  float *dx, float *dy, float *dz)
+{
+  int x0 = LatticeFloor (x);
+  int y0 = LatticeFloor (y);
+  int z0 = LatticeFloor (z);
+
+  float fx = x - (float)x0;
+  float fy = y - (float)y0;
+  float fz = z - (float)z0;
+
+  float xs = SCurve<noiseQuality> (fx);
+  float ys = SCurve<noiseQuality> (fy);
+  float zs = SCurve<noiseQuality> (fz);
+
+  float n[8];
+  ValueCorners<noiseHash> (x0, y0, z0, seed, n);
+
+  float dxs, dys, dzs;
+  InterpCornersDerivatives (n, xs, ys, zs, dxs, dys, dzs);
+
+  *dx = SCurveDerivative<noiseQuality> (fx) * dxs;
+  *dy = SCurveDerivative<noiseQuality> (fy) * dys;
+  *dz = SCurveDerivative<noiseQuality> (fz) * dzs;
+
+  return InterpCorners (n, xs, ys, zs);
+}
+
+namespace noise
+{
+  template float GradientLatticeNoise3DF<QUALITY_FAST, HASH_LEGACY> (float, float, float, int);
+  template float GradientLatticeNoise3DF<QUALITY_STD, HASH_LEGACY> (float, float, float, int);
+  template float GradientLatticeNoise3DF<QUALITY_BEST, HASH_LEGACY> (float, float, float, int);
+  template float GradientLatticeNoise3DF<QUALITY_FAST, HASH_XX> (float, float, float, int);
+  template float GradientLatticeNoise3DF<QUALITY_STD, HASH_XX> (float, float, float, int);
+  template float GradientLatticeNoise3DF<QUALITY_BEST, HASH_XX> (float, float, float, int);
+  template float ValueLatticeNoise3DF<QUALITY_FAST, HASH_LEGACY> (float, float, float, int);
+  template float ValueLatticeNoise3DF<QUALITY_STD, HASH_LEGACY> (float, float, float, int);
+  template float ValueLatticeNoise3DF<QUALITY_BEST, HASH_LEGACY> (float, float, float, int);
+  template float ValueLatticeNoise3DF<QUALITY_FAST, HASH_XX> (float, float, float, int);
+  template float ValueLatticeNoise3DF<QUALITY_STD, HASH_XX> (float, float, float, int);
+  template float ValueLatticeNoise3DF<QUALITY_BEST, HASH_XX> (float, float, float, int);
+  template float GradientLatticeNoise3DFD<QUALITY_FAST, HASH_LEGACY> (float, float, float, int, float*, float*, float*);
+  template float GradientLatticeNoise3DFD<QUALITY_STD, HASH_LEGACY> (float, float, float, int, float*, float*, float*);
+  template float GradientLatticeNoise3DFD<QUALITY_BEST, HASH_LEGACY> (float, float, float, int, float*, float*, float*);
+  template float GradientLatticeNoise3DFD<QUALITY_FAST, HASH_XX> (float, float, float, int, float*, float*, float*);
+  template float GradientLatticeNoise3DFD<QUALITY_STD, HASH_XX> (float, float, float, int, float*, float*, float*);
+  template float GradientLatticeNoise3DFD<QUALITY_BEST, HASH_XX> (float, float, float, int, float*, float*, float*);
+  template float ValueLatticeNoise3DFD<QUALITY_FAST, HASH_LEGACY> (float, float, float, int, float*, float*, float*);
+  template float ValueLatticeNoise3DFD<QUALITY_STD, HASH_LEGACY> (float, float, float, int, float*, float*, float*);
+  template float ValueLatticeNoise3DFD<QUALITY_BEST, HASH_LEGACY> (float, float, float, int, float*, float*, float*);
+  template float ValueLatticeNoise3DFD<QUALITY_FAST, HASH_XX> (float, float, float, int, float*, float*, float*);
+  template float ValueLatticeNoise3DFD<QUALITY_STD, HASH_XX> (float, float, float, int, float*, float*, float*);
+  template float ValueLatticeNoise3DFD<QUALITY_BEST, HASH_XX> (float, float, float, int, float*, float*, float*);
+  template float GradientCoherentNoise3DF<QUALITY_FAST> (float, float, float, int);
+  template float GradientCoherentNoise3DF<QUALITY_STD> (float, float, float, int);
+  template float GradientCoherentNoise3DF<QUALITY_BEST> (float, float, float, int);
+  template float ValueCoherentNoise3DF<QUALITY_FAST> (float, float, float, int);
+  template float ValueCoherentNoise3DF<QUALITY_STD> (float, float, float, int);
+  template float ValueCoherentNoise3DF<QUALITY_BEST> (float, float, float, int);
+}
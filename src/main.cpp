@@ -34,6 +34,8 @@ SOFTWARE.
 extern const AtNodeMethods *DistortPointMtd;
 extern const AtNodeMethods *VoronoiMtd;
 extern const AtNodeMethods *FractalMtd;
+extern const AtNodeMethods *FractalBumpMtd;
+extern const AtNodeMethods *CurlNoiseMtd;
 
 namespace SSTR
 {
@@ -44,6 +46,55 @@ namespace SSTR
    AtString output_mode("output_mode");
    AtString custom_input("custom_input");
    AtString base_noise("base_noise");
+   AtString amplitude("amplitude");
+   AtString frequency("frequency");
+   AtString octaves("octaves");
+   AtString persistence("persistence");
+   AtString lacunarity("lacunarity");
+   AtString value_seed("value_seed");
+   AtString value_quality("value_quality");
+   AtString perlin_seed("perlin_seed");
+   AtString perlin_quality("perlin_quality");
+   AtString flow_power("flow_power");
+   AtString flow_time("flow_time");
+   AtString turbulent("turbulent");
+   AtString turbulence_offset("turbulence_offset");
+   AtString turbulence_scale("turbulence_scale");
+   AtString ridged("ridged");
+   AtString ridge_offset("ridge_offset");
+   AtString ridge_gain("ridge_gain");
+   AtString ridge_exponent("ridge_exponent");
+   AtString dampen_output("dampen_output");
+   AtString remap_output("remap_output");
+   AtString fractal_min("fractal_min");
+   AtString fractal_max("fractal_max");
+   AtString output_min("output_min");
+   AtString output_max("output_max");
+   AtString clamp_output("clamp_output");
+   AtString auto_octaves("auto_octaves");
+   AtString auto_octaves_scale("auto_octaves_scale");
+   AtString amplitude_threshold("amplitude_threshold");
+   AtString bake("bake");
+   AtString bake_bound_min("bake_bound_min");
+   AtString bake_bound_max("bake_bound_max");
+   AtString bake_interpolation("bake_interpolation");
+   AtString bake_memory("bake_memory");
+   AtString volume_cache("volume_cache");
+   AtString volume_cache_memory("volume_cache_memory");
+   AtString motion_reuse("motion_reuse");
+   AtString motion_reuse_distance("motion_reuse_distance");
+   AtString feature_cache("feature_cache");
+   AtString threads("threads");
+   AtString power("power");
+   AtString roughness("roughness");
+   AtString simplex_seed("simplex_seed");
+   AtString flow_seed("flow_seed");
+   AtString lattice_hash("lattice_hash");
+   AtString time("time");
+   AtString noise_stats("noise_stats");
+   AtString noise_stats_file("noise_stats_file");
+   AtString bump_height("bump_height");
+   AtString output("output");
 }
 
 node_loader
@@ -71,6 +122,20 @@ node_loader
       node->methods = VoronoiMtd;
       strcpy(node->version, AI_VERSION);
       return true;
+   case 3:
+      node->name = PREFIX "fractal_bump";
+      node->node_type = AI_NODE_SHADER;
+      node->output_type = AI_TYPE_VECTOR;
+      node->methods = FractalBumpMtd;
+      strcpy(node->version, AI_VERSION);
+      return true;
+   case 4:
+      node->name = PREFIX "curl_noise";
+      node->node_type = AI_NODE_SHADER;
+      node->output_type = AI_TYPE_VECTOR;
+      node->methods = CurlNoiseMtd;
+      strcpy(node->version, AI_VERSION);
+      return true;
    default:
       return false;
    }
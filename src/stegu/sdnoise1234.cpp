@@ -339,6 +339,14 @@ float sdnoise2( float x, float y, float *dnoise_dx, float *dnoise_dy )
  */
 float sdnoise3( float x, float y, float z,
                 float *dnoise_dx, float *dnoise_dy, float *dnoise_dz )
+{
+    return sdnoise3( x, y, z, dnoise_dx, dnoise_dy, dnoise_dz, perm );
+}
+
+/* 3D simplex noise with derivatives, custom permutation table */
+float sdnoise3( float x, float y, float z,
+                float *dnoise_dx, float *dnoise_dy, float *dnoise_dz,
+                const unsigned char *perm )
 {
     float n0, n1, n2, n3; /* Noise contributions from the four simplex corners */
     float noise;          /* Return value */
@@ -492,6 +500,100 @@ float sdnoise3( float x, float y, float z,
     return noise;
 }
 
+/** Three 3D simplex noise fields with derivatives, sharing the simplex
+ * cell traversal and the corner falloffs. Field 0 is sdnoise3, fields 1 and
+ * 2 hash the corner's field 0 hash once more to pick decorrelated gradients.
+ * noise receives the 3 values, dnoise the 3 gradients (x, y, z per field).
+ */
+void sdnoise3x3( float x, float y, float z, const unsigned char *perm,
+                 float *noise, float *dnoise )
+{
+    int c, n;
+
+    /* Skew the input space to determine which simplex cell we're in */
+    float s = (x+y+z)*F3;
+    float xs = x+s;
+    float ys = y+s;
+    float zs = z+s;
+    int i = FASTFLOOR(xs);
+    int j = FASTFLOOR(ys);
+    int k = FASTFLOOR(zs);
+
+    float t = (float)(i+j+k)*G3;
+    float X0 = i-t; /* Unskew the cell origin back to (x,y,z) space */
+    float Y0 = j-t;
+    float Z0 = k-t;
+    float x0 = x-X0; /* The x,y,z distances from the cell origin */
+    float y0 = y-Y0;
+    float z0 = z-Z0;
+
+    /* Same simplex and corners as sdnoise3 */
+    int i1, j1, k1;
+    int i2, j2, k2;
+
+    if(x0>=y0) {
+      if(y0>=z0)
+        { i1=1; j1=0; k1=0; i2=1; j2=1; k2=0; } /* X Y Z order */
+        else if(x0>=z0) { i1=1; j1=0; k1=0; i2=1; j2=0; k2=1; } /* X Z Y order */
+        else { i1=0; j1=0; k1=1; i2=1; j2=0; k2=1; } /* Z X Y order */
+      }
+    else { // x0<y0
+      if(y0<z0) { i1=0; j1=0; k1=1; i2=0; j2=1; k2=1; } /* Z Y X order */
+      else if(x0<z0) { i1=0; j1=1; k1=0; i2=0; j2=1; k2=1; } /* Y Z X order */
+      else { i1=0; j1=1; k1=0; i2=1; j2=1; k2=0; } /* Y X Z order */
+    }
+
+    float cx[4], cy[4], cz[4]; /* Offsets from the four corners */
+    int ci[4], cj[4], ck[4];   /* Corners in (i,j,k) coords, relative to the cell */
+
+    cx[0] = x0; cy[0] = y0; cz[0] = z0;
+    cx[1] = x0 - i1 + G3; cy[1] = y0 - j1 + G3; cz[1] = z0 - k1 + G3;
+    cx[2] = x0 - i2 + 2.0f * G3; cy[2] = y0 - j2 + 2.0f * G3; cz[2] = z0 - k2 + 2.0f * G3;
+    cx[3] = x0 - 1.0f + 3.0f * G3; cy[3] = y0 - 1.0f + 3.0f * G3; cz[3] = z0 - 1.0f + 3.0f * G3;
+    ci[0] = 0; cj[0] = 0; ck[0] = 0;
+    ci[1] = i1; cj[1] = j1; ck[1] = k1;
+    ci[2] = i2; cj[2] = j2; ck[2] = k2;
+    ci[3] = 1; cj[3] = 1; ck[3] = 1;
+
+    /* Wrap the integer indices at 256, to avoid indexing perm[] out of bounds */
+    int ii = i & 0xff;
+    int jj = j & 0xff;
+    int kk = k & 0xff;
+
+    for(c=0; c<3; ++c) {
+      noise[c] = 0.0f;
+      dnoise[3*c] = dnoise[3*c+1] = dnoise[3*c+2] = 0.0f;
+    }
+
+    /* The falloff t^4 and its derivative -8 t^3 (x,y,z) are computed once per
+     * corner for all three fields */
+    for(n=0; n<4; ++n) {
+      float tc = 0.6f - cx[n]*cx[n] - cy[n]*cy[n] - cz[n]*cz[n];
+      if(tc < 0.0f) continue;
+      float t2 = tc * tc;
+      float t4 = t2 * t2;
+      float t3 = t2 * tc;
+      int hash = perm[ii + ci[n] + perm[jj + cj[n] + perm[kk + ck[n]]]];
+      for(c=0; c<3; ++c) {
+        float gx, gy, gz;
+        grad3( c == 0 ? hash : perm[hash + c], &gx, &gy, &gz );
+        float gdot = gx * cx[n] + gy * cy[n] + gz * cz[n];
+        noise[c] += t4 * gdot;
+        dnoise[3*c] += t4 * gx - 8.0f * t3 * gdot * cx[n];
+        dnoise[3*c+1] += t4 * gy - 8.0f * t3 * gdot * cy[n];
+        dnoise[3*c+2] += t4 * gz - 8.0f * t3 * gdot * cz[n];
+      }
+    }
+
+    /* Scale to match sdnoise3 */
+    for(c=0; c<3; ++c) {
+      noise[c] *= 28.0f;
+      dnoise[3*c] *= 28.0f;
+      dnoise[3*c+1] *= 28.0f;
+      dnoise[3*c+2] *= 28.0f;
+    }
+}
+
 // The skewing and unskewing factors are hairy again for the 4D case
 #define F4 0.309016994f // F4 = (Math.sqrt(5.0)-1.0)/4.0
 #define G4 0.138196601f // G4 = (5.0-Math.sqrt(5.0))/20.0
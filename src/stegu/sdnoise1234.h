@@ -56,6 +56,17 @@ float sdnoise2( float x, float y, float *dnoise_dx, float *dnoise_dy );
 float sdnoise3( float x, float y, float z,
                 float *dnoise_dx, float *dnoise_dy, float *dnoise_dz );
 
+/* Same as above, hashing lattice points with the given permutation table
+ * (256 values repeated twice) instead of the reference one */
+float sdnoise3( float x, float y, float z,
+                float *dnoise_dx, float *dnoise_dy, float *dnoise_dz,
+                const unsigned char *perm );
+
+/* Three decorrelated sdnoise3 fields at once, sharing the lattice work.
+ * Writes 3 values to noise and 9 derivatives (3 per field) to dnoise */
+void sdnoise3x3( float x, float y, float z, const unsigned char *perm,
+                 float *noise, float *dnoise );
+
 /** 4D simplex noise with derivatives.
  * If the last four arguments are not null, the analytic derivative
  * (the 4D gradient of the scalar noise field) is also calculated.
@@ -237,6 +237,11 @@ float SimplexNoise1234::noise(float x, float y) {
 
 // 3D simplex noise
 float SimplexNoise1234::noise(float x, float y, float z) {
+  return noise(x, y, z, perm);
+}
+
+// 3D simplex noise, custom permutation table
+float SimplexNoise1234::noise(float x, float y, float z, const unsigned char *perm) {
 
 // Simple skewing factors for the 3D case
 #define F3 0.333333333f
@@ -333,18 +338,157 @@ float SimplexNoise1234::noise(float x, float y, float z) {
     return 32.0f * (n0 + n1 + n2 + n3); // TODO: The scale factor is preliminary!
   }
 
+// Gradient direction used by grad(hash, x, y, z)
+void SimplexNoise1234::gradvec( int hash, float *gx, float *gy, float *gz ) {
+    int h = hash & 15;
+    float su = (h&1) ? -1.0f : 1.0f;
+    float sv = (h&2) ? -1.0f : 1.0f;
+    *gx = *gy = *gz = 0.0f;
+    if (h<8) *gx += su; else *gy += su;
+    if (h<4) *gy += sv; else if (h==12||h==14) *gx += sv; else *gz += sv;
+}
 
-// 4D simplex noise
-float SimplexNoise1234::noise(float x, float y, float z, float w) {
-  
-  // The skewing and unskewing factors are hairy again for the 4D case
+// Adds the derivative of the contribution t^4 * dot(g, d) of one corner,
+// with t = 0.6 - |d|^2 > 0: t^4 * g - 8 * t^3 * dot(g, d) * d
+static inline void AddCornerDerivative(float t, float gdot, float gx, float gy, float gz,
+                                       float x, float y, float z,
+                                       float *dx, float *dy, float *dz) {
+    float t2 = t * t;
+    float t4 = t2 * t2;
+    float s = -8.0f * t2 * t * gdot;
+    *dx += t4 * gx + s * x;
+    *dy += t4 * gy + s * y;
+    *dz += t4 * gz + s * z;
+}
+
+// 3D simplex noise and its analytic gradient, custom permutation table.
+// Same value as noise(x, y, z, perm)
+float SimplexNoise1234::noise(float x, float y, float z, const unsigned char *perm,
+                              float *dnoise_dx, float *dnoise_dy, float *dnoise_dz) {
+
+    float n0, n1, n2, n3; // Noise contributions from the four corners
+    float dx = 0.0f, dy = 0.0f, dz = 0.0f;
+    float gx, gy, gz;
+
+    // Skew the input space to determine which simplex cell we're in
+    float s = (x+y+z)*F3;
+    float xs = x+s;
+    float ys = y+s;
+    float zs = z+s;
+    int i = FASTFLOOR(xs);
+    int j = FASTFLOOR(ys);
+    int k = FASTFLOOR(zs);
+
+    float t = (float)(i+j+k)*G3; 
+    float X0 = i-t;
+    float Y0 = j-t;
+    float Z0 = k-t;
+    float x0 = x-X0;
+    float y0 = y-Y0;
+    float z0 = z-Z0;
+
+    int i1, j1, k1;
+    int i2, j2, k2;
+
+    if(x0>=y0) {
+      if(y0>=z0)
+        { i1=1; j1=0; k1=0; i2=1; j2=1; k2=0; }
+        else if(x0>=z0) { i1=1; j1=0; k1=0; i2=1; j2=0; k2=1; }
+        else { i1=0; j1=0; k1=1; i2=1; j2=0; k2=1; }
+      }
+    else {
+      if(y0<z0) { i1=0; j1=0; k1=1; i2=0; j2=1; k2=1; }
+      else if(x0<z0) { i1=0; j1=1; k1=0; i2=0; j2=1; k2=1; }
+      else { i1=0; j1=1; k1=0; i2=1; j2=1; k2=0; }
+    }
+
+    float x1 = x0 - i1 + G3;
+    float y1 = y0 - j1 + G3;
+    float z1 = z0 - k1 + G3;
+    float x2 = x0 - i2 + 2.0f*G3;
+    float y2 = y0 - j2 + 2.0f*G3;
+    float z2 = z0 - k2 + 2.0f*G3;
+    float x3 = x0 - 1.0f + 3.0f*G3;
+    float y3 = y0 - 1.0f + 3.0f*G3;
+    float z3 = z0 - 1.0f + 3.0f*G3;
+
+    int ii = i & 0xff;
+    int jj = j & 0xff;
+    int kk = k & 0xff;
+
+    float t0 = 0.6f - x0*x0 - y0*y0 - z0*z0;
+    if(t0 < 0.0f) n0 = 0.0f;
+    else {
+      int h = perm[ii+perm[jj+perm[kk]]];
+      float g = grad(h, x0, y0, z0);
+      gradvec(h, &gx, &gy, &gz);
+      AddCornerDerivative(t0, g, gx, gy, gz, x0, y0, z0, &dx, &dy, &dz);
+      t0 *= t0;
+      n0 = t0 * t0 * g;
+    }
+
+    float t1 = 0.6f - x1*x1 - y1*y1 - z1*z1;
+    if(t1 < 0.0f) n1 = 0.0f;
+    else {
+      int h = perm[ii+i1+perm[jj+j1+perm[kk+k1]]];
+      float g = grad(h, x1, y1, z1);
+      gradvec(h, &gx, &gy, &gz);
+      AddCornerDerivative(t1, g, gx, gy, gz, x1, y1, z1, &dx, &dy, &dz);
+      t1 *= t1;
+      n1 = t1 * t1 * g;
+    }
+
+    float t2 = 0.6f - x2*x2 - y2*y2 - z2*z2;
+    if(t2 < 0.0f) n2 = 0.0f;
+    else {
+      int h = perm[ii+i2+perm[jj+j2+perm[kk+k2]]];
+      float g = grad(h, x2, y2, z2);
+      gradvec(h, &gx, &gy, &gz);
+      AddCornerDerivative(t2, g, gx, gy, gz, x2, y2, z2, &dx, &dy, &dz);
+      t2 *= t2;
+      n2 = t2 * t2 * g;
+    }
+
+    float t3 = 0.6f - x3*x3 - y3*y3 - z3*z3;
+    if(t3<0.0f) n3 = 0.0f;
+    else {
+      int h = perm[ii+1+perm[jj+1+perm[kk+1]]];
+      float g = grad(h, x3, y3, z3);
+      gradvec(h, &gx, &gy, &gz);
+      AddCornerDerivative(t3, g, gx, gy, gz, x3, y3, z3, &dx, &dy, &dz);
+      t3 *= t3;
+      n3 = t3 * t3 * g;
+    }
+
+    *dnoise_dx = 32.0f * dx;
+    *dnoise_dy = 32.0f * dy;
+    *dnoise_dz = 32.0f * dz;
+
+    return 32.0f * (n0 + n1 + n2 + n3);
+  }
+
+
+// The skewing and unskewing factors are hairy again for the 4D case
 #define F4 0.309016994f // F4 = (Math.sqrt(5.0)-1.0)/4.0
 #define G4 0.138196601f // G4 = (5.0-Math.sqrt(5.0))/20.0
 
+// 4D simplex noise
+float SimplexNoise1234::noise(float x, float y, float z, float w) {
+    return noise(x, y, z, w, skew4(w), perm);
+  }
+
+// w part of the 4D skew
+float SimplexNoise1234::skew4(float w) {
+    return w * F4;
+  }
+
+// 4D simplex noise, w skew computed by the caller, custom permutation table
+float SimplexNoise1234::noise(float x, float y, float z, float w, float wf4, const unsigned char *perm) {
+
     float n0, n1, n2, n3, n4; // Noise contributions from the five corners
 
     // Skew the (x,y,z,w) space to determine which cell of 24 simplices we're in
-    float s = (x + y + z + w) * F4; // Factor for 4D skewing
+    float s = (x + y + z) * F4 + wf4; // Factor for 4D skewing
     float xs = x + s;
     float ys = y + s;
     float zs = z + s;
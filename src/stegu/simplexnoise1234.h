@@ -42,6 +42,37 @@ class SimplexNoise1234 {
     static float noise( float x, float y, float z );
     static float noise( float x, float y, float z, float w );
 
+/** Batch 3D float Perlin noise: evaluates n points given as separate x, y
+ *  and z arrays and writes the results to out. Points are processed 8 (AVX2)
+ *  or 4 (SSE2) at a time depending on the running CPU, results are the same
+ *  as calling noise(x[i], y[i], z[i]) for each point.
+ *  (implemented in simplexnoise1234_batch.cpp)
+ */
+    static void noise( int n, const float *x, const float *y, const float *z,
+                       float *out );
+
+/** Same as above, hashing lattice points with the given permutation table
+ *  (256 values repeated twice) instead of the reference one. iperm holds the
+ *  same values widened to 32 bits for the SIMD gathers.
+ */
+    static float noise( float x, float y, float z, const unsigned char *perm );
+    static float noise( float x, float y, float z, const unsigned char *perm,
+                        float *dnoise_dx, float *dnoise_dy, float *dnoise_dz );
+    static void noise( int n, const float *x, const float *y, const float *z,
+                       float *out, const unsigned char *perm, const int *iperm );
+
+/** 4D noise for callers sharing the w coordinate between many points: wf4
+ *  is skew4(w), the w part of the 4D skew, computed once by the caller.
+ *  Hashes lattice points with the given permutation table.
+ */
+    static float noise( float x, float y, float z, float w, float wf4,
+                        const unsigned char *perm );
+    static float skew4( float w );
+
+/** The reference permutation table (512 entries)
+ */
+    static const unsigned char* permutation() { return perm; }
+
 /** 1D, 2D, 3D and 4D float Perlin noise, with a specified integer period
  */
     static float pnoise( float x, int px );
@@ -55,6 +86,7 @@ class SimplexNoise1234 {
     static float grad( int hash, float x );
     static float grad( int hash, float x, float y );
     static float grad( int hash, float x, float y , float z );
+    static void gradvec( int hash, float *gx, float *gy, float *gz );
     static float grad( int hash, float x, float y, float z, float t );
 
 };
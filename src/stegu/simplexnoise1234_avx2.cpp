@@ -0,0 +1,91 @@
+/*
+MIT License
+
+Copyright (c) 2016 Gaetan Guidet
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// AVX2 instantiation of the lane kernels, the whole translation unit is
+// compiled for AVX2 and only called when the running CPU supports it.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+
+#if defined(__clang__)
+#  pragma clang attribute push (__attribute__((target("avx2"))), apply_to=function)
+#elif defined(__GNUC__)
+#  pragma GCC target("avx2")
+#endif
+
+#include <immintrin.h>
+
+namespace
+{
+   // 8 lanes
+   
+   struct AVX2
+   {
+      typedef __m256 Float;
+      typedef __m256i Int;
+      
+      static const int Width = 8;
+      
+      static inline Float Load(const float *p) { return _mm256_loadu_ps(p); }
+      static inline void Store(float *p, Float v) { _mm256_storeu_ps(p, v); }
+      static inline Float Set(float f) { return _mm256_set1_ps(f); }
+      static inline Int SetI(int i) { return _mm256_set1_epi32(i); }
+      static inline Float Add(Float a, Float b) { return _mm256_add_ps(a, b); }
+      static inline Float Sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+      static inline Float Mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+      static inline Float Xor(Float a, Float b) { return _mm256_xor_ps(a, b); }
+      static inline Float And(Float a, Float b) { return _mm256_and_ps(a, b); }
+      static inline Float AndNot(Float a, Float b) { return _mm256_andnot_ps(a, b); }
+      static inline Float Or(Float a, Float b) { return _mm256_or_ps(a, b); }
+      static inline Float Select(Float mask, Float a, Float b) { return _mm256_blendv_ps(b, a, mask); }
+      static inline Float CmpGE(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+      static inline Float CmpLE(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+      static inline Float CmpLT(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+      static inline Int AddI(Int a, Int b) { return _mm256_add_epi32(a, b); }
+      static inline Int AndI(Int a, Int b) { return _mm256_and_si256(a, b); }
+      static inline Int CmpEqI(Int a, Int b) { return _mm256_cmpeq_epi32(a, b); }
+      static inline Int CmpLTI(Int a, Int b) { return _mm256_cmpgt_epi32(b, a); }
+      static inline Int ToInt(Float a) { return _mm256_cvttps_epi32(a); }
+      static inline Float ToFloat(Int a) { return _mm256_cvtepi32_ps(a); }
+      static inline Int AsInt(Float a) { return _mm256_castps_si256(a); }
+      static inline Float AsFloat(Int a) { return _mm256_castsi256_ps(a); }
+      
+      static inline Int Gather(const int *table, Int index)
+      {
+         return _mm256_i32gather_epi32(table, index, 4);
+      }
+   };
+}
+
+#include "simplexnoise1234_lanes.h"
+
+void SimplexNoiseBatchAVX2(const int *perm, int n, const float *x, const float *y, const float *z, float *out)
+{
+   NoiseLanes<AVX2>(perm, n, x, y, z, out);
+}
+
+#if defined(__clang__)
+#  pragma clang attribute pop
+#endif
+
+#endif
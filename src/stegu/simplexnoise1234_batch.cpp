@@ -0,0 +1,175 @@
+/*
+MIT License
+
+Copyright (c) 2016 Gaetan Guidet
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// SimplexNoise1234::noise(int n, ...) with runtime dispatch to the SSE2 or
+// AVX2 lane kernels (see simplexnoise1234_lanes.h)
+
+#include "simplexnoise1234.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#  define SIMPLEX_BATCH_X86
+#  include <emmintrin.h>
+#  ifdef _MSC_VER
+#    include <intrin.h>
+#  endif
+#endif
+
+#ifdef SIMPLEX_BATCH_X86
+
+// simplexnoise1234_avx2.cpp
+void SimplexNoiseBatchAVX2(const int *perm, int n, const float *x, const float *y, const float *z, float *out);
+
+namespace
+{
+   // perm[] widened to 32 bits for gathers
+   const int* IntPermutation(const unsigned char *perm)
+   {
+      struct Table
+      {
+         int values[512];
+         
+         Table(const unsigned char *p)
+         {
+            for (int i=0; i<512; ++i)
+            {
+               values[i] = p[i];
+            }
+         }
+      };
+      
+      static Table table(perm);
+      
+      return table.values;
+   }
+   
+   bool HasAVX2()
+   {
+#if defined(_MSC_VER)
+      int info[4];
+      __cpuid(info, 0);
+      if (info[0] < 7)
+      {
+         return false;
+      }
+      __cpuid(info, 1);
+      // OSXSAVE and AVX
+      if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+      {
+         return false;
+      }
+      // OS saves YMM registers
+      if ((_xgetbv(0) & 6) != 6)
+      {
+         return false;
+      }
+      __cpuidex(info, 7, 0);
+      return ((info[1] & (1 << 5)) != 0);
+#elif defined(__GNUC__)
+      __builtin_cpu_init();
+      return (__builtin_cpu_supports("avx2") != 0);
+#else
+      return false;
+#endif
+   }
+   
+   // 4 lanes
+   
+   struct SSE
+   {
+      typedef __m128 Float;
+      typedef __m128i Int;
+      
+      static const int Width = 4;
+      
+      static inline Float Load(const float *p) { return _mm_loadu_ps(p); }
+      static inline void Store(float *p, Float v) { _mm_storeu_ps(p, v); }
+      static inline Float Set(float f) { return _mm_set1_ps(f); }
+      static inline Int SetI(int i) { return _mm_set1_epi32(i); }
+      static inline Float Add(Float a, Float b) { return _mm_add_ps(a, b); }
+      static inline Float Sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+      static inline Float Mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+      static inline Float Xor(Float a, Float b) { return _mm_xor_ps(a, b); }
+      static inline Float And(Float a, Float b) { return _mm_and_ps(a, b); }
+      static inline Float AndNot(Float a, Float b) { return _mm_andnot_ps(a, b); }
+      static inline Float Or(Float a, Float b) { return _mm_or_ps(a, b); }
+      static inline Float Select(Float mask, Float a, Float b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+      static inline Float CmpGE(Float a, Float b) { return _mm_cmpge_ps(a, b); }
+      static inline Float CmpLE(Float a, Float b) { return _mm_cmple_ps(a, b); }
+      static inline Float CmpLT(Float a, Float b) { return _mm_cmplt_ps(a, b); }
+      static inline Int AddI(Int a, Int b) { return _mm_add_epi32(a, b); }
+      static inline Int AndI(Int a, Int b) { return _mm_and_si128(a, b); }
+      static inline Int CmpEqI(Int a, Int b) { return _mm_cmpeq_epi32(a, b); }
+      static inline Int CmpLTI(Int a, Int b) { return _mm_cmplt_epi32(a, b); }
+      static inline Int ToInt(Float a) { return _mm_cvttps_epi32(a); }
+      static inline Float ToFloat(Int a) { return _mm_cvtepi32_ps(a); }
+      static inline Int AsInt(Float a) { return _mm_castps_si128(a); }
+      static inline Float AsFloat(Int a) { return _mm_castsi128_ps(a); }
+      
+      static inline Int Gather(const int *table, Int index)
+      {
+         int idx[4];
+         _mm_storeu_si128((__m128i*)idx, index);
+         return _mm_set_epi32(table[idx[3]], table[idx[2]], table[idx[1]], table[idx[0]]);
+      }
+   };
+}
+
+#include "simplexnoise1234_lanes.h"
+
+#endif
+
+void SimplexNoise1234::noise(int n, const float *x, const float *y, const float *z, float *out)
+{
+#ifdef SIMPLEX_BATCH_X86
+   noise(n, x, y, z, out, perm, IntPermutation(perm));
+#else
+   noise(n, x, y, z, out, perm, 0);
+#endif
+}
+
+void SimplexNoise1234::noise(int n, const float *x, const float *y, const float *z, float *out, const unsigned char *perm, const int *iperm)
+{
+   int done = 0;
+   
+#ifdef SIMPLEX_BATCH_X86
+   static const bool hasAVX2 = HasAVX2();
+   
+   if (hasAVX2)
+   {
+      SimplexNoiseBatchAVX2(iperm, n, x, y, z, out);
+      done = n - (n % 8);
+   }
+   
+   if (n - done >= SSE::Width)
+   {
+      NoiseLanes<SSE>(iperm, n - done, x + done, y + done, z + done, out + done);
+      done = n - (n % SSE::Width);
+   }
+#endif
+   
+   for (int i=done; i<n; ++i)
+   {
+      out[i] = noise(x[i], y[i], z[i], perm);
+   }
+}
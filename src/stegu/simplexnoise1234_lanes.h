@@ -0,0 +1,175 @@
+/*
+MIT License
+
+Copyright (c) 2016 Gaetan Guidet
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Lane kernels for SimplexNoise1234::noise(int n, ...)
+//
+// Included by simplexnoise1234_batch.cpp (SSE2) and simplexnoise1234_avx2.cpp
+// (AVX2) after defining the lane type V they are instantiated with. Everything
+// lives in an anonymous namespace so that each translation unit gets its own
+// copy compiled for its own instruction set.
+//
+// The kernels follow the scalar code operation for operation (same evaluation
+// order, no fused multiply-add) so that results are bit identical.
+
+#ifndef __simplexnoise1234_lanes_h__
+#define __simplexnoise1234_lanes_h__
+
+#define SIMPLEX_LANES_F3 0.333333333f
+#define SIMPLEX_LANES_G3 0.166666667f
+
+namespace
+{
+   // Lane version of SimplexNoise1234::grad(hash, x, y, z)
+   template <typename V>
+   inline typename V::Float Grad(typename V::Int hash, typename V::Float x, typename V::Float y, typename V::Float z)
+   {
+      typedef typename V::Float Float;
+      typedef typename V::Int Int;
+      
+      Int h = V::AndI(hash, V::SetI(15));
+      Float signbit = V::Set(-0.0f);
+      
+      Float hlt8 = V::AsFloat(V::CmpLTI(h, V::SetI(8)));
+      Float hlt4 = V::AsFloat(V::CmpLTI(h, V::SetI(4)));
+      Float h12or14 = V::AsFloat(V::CmpEqI(V::AndI(h, V::SetI(13)), V::SetI(12)));
+      
+      Float u = V::Select(hlt8, x, y);
+      Float v = V::Select(hlt4, y, V::Select(h12or14, x, z));
+      
+      Float usign = V::And(V::AsFloat(V::CmpEqI(V::AndI(h, V::SetI(1)), V::SetI(1))), signbit);
+      Float vsign = V::And(V::AsFloat(V::CmpEqI(V::AndI(h, V::SetI(2)), V::SetI(2))), signbit);
+      
+      return V::Add(V::Xor(u, usign), V::Xor(v, vsign));
+   }
+   
+   // Lane version of one corner contribution
+   template <typename V>
+   inline typename V::Float Corner(typename V::Int hash, typename V::Float x, typename V::Float y, typename V::Float z)
+   {
+      typedef typename V::Float Float;
+      
+      Float t = V::Sub(V::Sub(V::Sub(V::Set(0.6f), V::Mul(x, x)), V::Mul(y, y)), V::Mul(z, z));
+      Float t2 = V::Mul(t, t);
+      Float n = V::Mul(V::Mul(t2, t2), Grad<V>(hash, x, y, z));
+      // n = 0 where t < 0
+      return V::AndNot(V::CmpLT(t, V::Set(0.0f)), n);
+   }
+   
+   // Same as FASTFLOOR macro in simplexnoise1234.cpp
+   template <typename V>
+   inline typename V::Int FastFloor(typename V::Float x)
+   {
+      // (int)x, minus 1 (all bits set) where x <= 0
+      return V::AddI(V::ToInt(x), V::AsInt(V::CmpLE(x, V::Set(0.0f))));
+   }
+   
+   // Boolean mask to 0/1 integer
+   template <typename V>
+   inline typename V::Int MaskToInt(typename V::Float mask)
+   {
+      return V::AndI(V::AsInt(mask), V::SetI(1));
+   }
+   
+   template <typename V>
+   inline typename V::Int Hash(const int *perm, typename V::Int i, typename V::Int j, typename V::Int k)
+   {
+      return V::Gather(perm, V::AddI(i, V::Gather(perm, V::AddI(j, V::Gather(perm, k)))));
+   }
+   
+   template <typename V>
+   inline void Noise(const int *perm, const float *px, const float *py, const float *pz, float *out)
+   {
+      typedef typename V::Float Float;
+      typedef typename V::Int Int;
+      
+      Float x = V::Load(px);
+      Float y = V::Load(py);
+      Float z = V::Load(pz);
+      
+      // Skew the input space to determine which simplex cell we're in
+      Float s = V::Mul(V::Add(V::Add(x, y), z), V::Set(SIMPLEX_LANES_F3));
+      Int i = FastFloor<V>(V::Add(x, s));
+      Int j = FastFloor<V>(V::Add(y, s));
+      Int k = FastFloor<V>(V::Add(z, s));
+      
+      Float t = V::Mul(V::ToFloat(V::AddI(V::AddI(i, j), k)), V::Set(SIMPLEX_LANES_G3));
+      Float x0 = V::Sub(x, V::Sub(V::ToFloat(i), t));
+      Float y0 = V::Sub(y, V::Sub(V::ToFloat(j), t));
+      Float z0 = V::Sub(z, V::Sub(V::ToFloat(k), t));
+      
+      // Determine which simplex we are in, branch free version of the
+      // if/else chain in the scalar code
+      Float a = V::CmpGE(x0, y0);
+      Float b = V::CmpGE(y0, z0);
+      Float c = V::CmpGE(x0, z0);
+      
+      Float i1m = V::And(a, V::Or(b, c));
+      Float j1m = V::AndNot(a, b);
+      Float k1m = V::AndNot(b, V::AndNot(V::And(a, c), V::AsFloat(V::SetI(-1))));
+      Float i2m = V::Or(a, V::And(b, c));
+      Float j2m = V::Or(V::AndNot(a, V::AsFloat(V::SetI(-1))), b);
+      Float k2m = V::Or(V::AndNot(b, V::AsFloat(V::SetI(-1))), V::AndNot(V::Or(a, c), V::AsFloat(V::SetI(-1))));
+      
+      Int i1 = MaskToInt<V>(i1m);
+      Int j1 = MaskToInt<V>(j1m);
+      Int k1 = MaskToInt<V>(k1m);
+      Int i2 = MaskToInt<V>(i2m);
+      Int j2 = MaskToInt<V>(j2m);
+      Int k2 = MaskToInt<V>(k2m);
+      
+      Float x1 = V::Add(V::Sub(x0, V::ToFloat(i1)), V::Set(SIMPLEX_LANES_G3));
+      Float y1 = V::Add(V::Sub(y0, V::ToFloat(j1)), V::Set(SIMPLEX_LANES_G3));
+      Float z1 = V::Add(V::Sub(z0, V::ToFloat(k1)), V::Set(SIMPLEX_LANES_G3));
+      Float x2 = V::Add(V::Sub(x0, V::ToFloat(i2)), V::Set(2.0f*SIMPLEX_LANES_G3));
+      Float y2 = V::Add(V::Sub(y0, V::ToFloat(j2)), V::Set(2.0f*SIMPLEX_LANES_G3));
+      Float z2 = V::Add(V::Sub(z0, V::ToFloat(k2)), V::Set(2.0f*SIMPLEX_LANES_G3));
+      Float x3 = V::Add(V::Sub(x0, V::Set(1.0f)), V::Set(3.0f*SIMPLEX_LANES_G3));
+      Float y3 = V::Add(V::Sub(y0, V::Set(1.0f)), V::Set(3.0f*SIMPLEX_LANES_G3));
+      Float z3 = V::Add(V::Sub(z0, V::Set(1.0f)), V::Set(3.0f*SIMPLEX_LANES_G3));
+      
+      // Wrap the integer indices at 256
+      Int ii = V::AndI(i, V::SetI(0xff));
+      Int jj = V::AndI(j, V::SetI(0xff));
+      Int kk = V::AndI(k, V::SetI(0xff));
+      Int one = V::SetI(1);
+      
+      Float n0 = Corner<V>(Hash<V>(perm, ii, jj, kk), x0, y0, z0);
+      Float n1 = Corner<V>(Hash<V>(perm, V::AddI(ii, i1), V::AddI(jj, j1), V::AddI(kk, k1)), x1, y1, z1);
+      Float n2 = Corner<V>(Hash<V>(perm, V::AddI(ii, i2), V::AddI(jj, j2), V::AddI(kk, k2)), x2, y2, z2);
+      Float n3 = Corner<V>(Hash<V>(perm, V::AddI(ii, one), V::AddI(jj, one), V::AddI(kk, one)), x3, y3, z3);
+      
+      V::Store(out, V::Mul(V::Set(32.0f), V::Add(V::Add(V::Add(n0, n1), n2), n3)));
+   }
+   
+   template <typename V>
+   inline void NoiseLanes(const int *perm, int n, const float *x, const float *y, const float *z, float *out)
+   {
+      for (int i=0; i+V::Width<=n; i+=V::Width)
+      {
+         Noise<V>(perm, x+i, y+i, z+i, out+i);
+      }
+   }
+}
+
+#endif
@@ -301,6 +301,14 @@ float srdnoise2( float x, float y, float angle, float *dnoise_dx, float *dnoise_
 
 float srdnoise3( float x, float y, float z, float angle,
                  float *dnoise_dx, float *dnoise_dy, float *dnoise_dz )
+  {
+    return srdnoise3( x, y, z, angle, dnoise_dx, dnoise_dy, dnoise_dz, perm );
+  }
+
+/* 3D simplex noise with rotating gradients, custom permutation table */
+float srdnoise3( float x, float y, float z, float angle,
+                 float *dnoise_dx, float *dnoise_dy, float *dnoise_dz,
+                 const unsigned char *perm )
   {
     float n0, n1, n2, n3; /* Noise contributions from the four simplex corners */
     float noise;          /* Return value */
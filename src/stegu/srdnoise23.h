@@ -55,3 +55,9 @@ float srdnoise2( float x, float y, float t, float *dnoise_dx, float *dnoise_dy )
  */
 float srdnoise3( float x, float y, float z, float t, float *dnoise_dx, float *dnoise_dy, float *dnoise_dz );
 
+/**
+ * Same as above, hashing lattice points with the given permutation table
+ * (256 values repeated twice) instead of the reference one
+ */
+float srdnoise3( float x, float y, float z, float t, float *dnoise_dx, float *dnoise_dy, float *dnoise_dz, const unsigned char *perm );
+
@@ -23,6 +23,7 @@ SOFTWARE.
 */
 
 #include "common.h"
+#include "kernels/voronoi.h"
 
 AI_SHADER_NODE_EXPORT_METHODS(VoronoiMtd);
 
@@ -38,14 +39,8 @@ enum VoronoiParams
    p_weight2,
    p_weight3,
    p_weight4,
-   p_seed
-};
-
-enum DistanceFunc
-{
-   DF_euclidian = 0,
-   DF_manhattan,
-   DF_chebyshev
+   p_seed,
+   p_feature_cache
 };
 
 static const char *DistanceFuncNames[] =
@@ -56,19 +51,6 @@ static const char *DistanceFuncNames[] =
    NULL
 };
 
-enum OutputMode
-{
-   OM_constant = 0,
-   OM_f1,
-   OM_f2,
-   OM_f3,
-   OM_f4,
-   OM_add,
-   OM_sub,
-   OM_mul,
-   OM_weighted
-};
-
 static const char *OutputModeNames[] =
 {
    "constant",
@@ -83,22 +65,6 @@ static const char *OutputModeNames[] =
    NULL
 };
 
-float ManhattanDistance(const AtVector &p1, const AtVector &p2)
-{
-   return fabsf(p1.x - p2.x) + fabsf(p1.y - p2.y) + fabsf(p1.z - p2.z);
-}
-
-float EuclidianDistance(const AtVector &p1, const AtVector &p2)
-{
-   return AiV3Length(p1 - p2);
-}
-
-float ChebyshevDistance(const AtVector &p1, const AtVector &p2)
-{
-   AtVector diff = p1 - p2;
-   return std::max(std::max(fabsf(diff.x), fabsf(diff.y)), fabsf(diff.z));
-}
-
 namespace SSTR
 {
    extern AtString linkable;
@@ -106,6 +72,8 @@ namespace SSTR
    extern AtString distance_func;
    extern AtString output_mode;
    extern AtString custom_input;
+   extern AtString feature_cache;
+   extern AtString threads;
 }
 
 node_parameters
@@ -121,6 +89,7 @@ node_parameters
    AiParameterFlt("weight3", 0.0f);
    AiParameterFlt("weight4", 0.0f);
    AiParameterInt("seed", 0);
+   AiParameterBool(SSTR::feature_cache, false);
 }
 
 struct VoronoiData
@@ -129,8 +98,44 @@ struct VoronoiData
    bool evalCustomInput;
    DistanceFunc distanceFunc;
    OutputMode outputMode;
+   // per thread feature point caches indexed by sg->tid, only when enabled
+   // (see node_update). Threads beyond numCaches evaluate directly
+   FeatureCache *caches;
+   int numCaches;
+   ShaderStats stats;
+   
+   VoronoiData()
+      : caches(0)
+      , numCaches(0)
+   {
+   }
+   
+   ~VoronoiData()
+   {
+      delete[] caches;
+   }
 };
 
+static void ReportCacheStats(AtNode *node, const VoronoiData *data)
+{
+   uint64_t hits = 0;
+   uint64_t misses = 0;
+   
+   for (int i=0; i<data->numCaches; ++i)
+   {
+      hits += data->caches[i].hits();
+      misses += data->caches[i].misses();
+   }
+   
+   if (hits + misses > 0)
+   {
+      AiMsgInfo("[voronoi] %s: feature point cache (%u entries) %llu hits, %llu misses (%.2f%% hit rate)",
+                AiNodeGetName(node), FeatureCache::Size,
+                (unsigned long long) hits, (unsigned long long) misses,
+                100.0 * double(hits) / double(hits + misses));
+   }
+}
+
 node_initialize
 {
    AiNodeSetLocalData(node, new VoronoiData());
@@ -142,19 +147,50 @@ node_update
 
    data->input = (Input) AiNodeGetInt(node, SSTR::input);
    data->evalCustomInput = AiNodeIsLinked(node, SSTR::custom_input);
+   
+   if (data->input == I_Pref && !data->evalCustomInput)
+   {
+      ResetMissingPref();
+   }
+   
    data->distanceFunc = (DistanceFunc) AiNodeGetInt(node, SSTR::distance_func);
    data->outputMode = (OutputMode) AiNodeGetInt(node, SSTR::output_mode);
+   data->stats.update("voronoi", node);
+   
+   // Caches only pay off for coherent samples, they are opt-in. Allocate one
+   // per render thread here rather than on the shading path, all threads
+   // when their count is automatic.
+   int numCaches = 0;
+   
+   if (AiNodeGetBool(node, SSTR::feature_cache))
+   {
+      int threads = AiNodeGetInt(AiUniverseGetOptions(), SSTR::threads);
+      numCaches = ((threads > 0 && threads < AI_MAX_THREADS) ? threads : AI_MAX_THREADS);
+   }
+   
+   if (numCaches != data->numCaches)
+   {
+      ReportCacheStats(node, data);
+      delete[] data->caches;
+      data->caches = (numCaches > 0 ? new FeatureCache[numCaches] : 0);
+      data->numCaches = numCaches;
+   }
 }
 
 node_finish
 {
    VoronoiData *data = (VoronoiData*) AiNodeGetLocalData(node);
+   
+   data->stats.report("voronoi", node);
+   ReportCacheStats(node, data);
+   
    delete data;
 }
 
 shader_evaluate
 {
    VoronoiData *data = (VoronoiData*) AiNodeGetLocalData(node);
+   ShaderSample sample(data->stats, sg->tid);
    
    AtVector P;
    if (data->evalCustomInput)
@@ -170,126 +206,39 @@ shader_evaluate
    float frequency = AiShaderEvalParamFlt(p_frequency);
    int seed = AiShaderEvalParamInt(p_seed);
    
-   float (*evalDist)(const AtVector&, const AtVector&);
-   
-   switch (data->distanceFunc)
-   {
-   case DF_manhattan:
-      evalDist = &ManhattanDistance;
-      break;
-   case DF_chebyshev:
-      evalDist = &ChebyshevDistance;
-      break;
-   case DF_euclidian:
-   default:
-      evalDist = &EuclidianDistance;
-   }
-   
    P *= frequency;
    
-   int xbase = int(floorf(P.x));
-   int ybase = int(floorf(P.y));
-   int zbase = int(floorf(P.z));
-   
-   AtVector Pf[4] = {P, P, P, P};
+   Vec3 Pv = ToVec3(P);
+   Vec3 Pf[4] = {Pv, Pv, Pv, Pv};
    float f[4] = {2147483647.0f, 2147483647.0f, 2147483647.0f, 2147483647.0f};
-   AtVector Pcur;
    
-   // Inside each unit cube, there is a seed point at a random position.  Go
-   // through each of the nearby cubes until we find a cube with a seed point
-   // that is closest to the specified position.
-   for (int zcur=zbase-2; zcur<=zbase+2; ++zcur)
+   if (sg->tid < data->numCaches)
    {
-      for (int ycur=ybase-2; ycur<=ybase+2; ++ycur)
-      {
-         for (int xcur=xbase-2; xcur<=xbase+2; ++xcur)
-         {
-            // Calculate the position and distance to the seed point inside of this unit cube.
-            Pcur.x = xcur + float(noise::ValueNoise3D(xcur, ycur, zcur, seed));
-            Pcur.y = ycur + float(noise::ValueNoise3D(xcur, ycur, zcur, seed+1));
-            Pcur.z = zcur + float(noise::ValueNoise3D(xcur, ycur, zcur, seed+2));
-            
-            float dist = evalDist(P, Pcur);
-
-            if (dist < f[0])
-            {
-               Pf[3] = Pf[2];
-               f[3] = f[2];
-               
-               Pf[2] = Pf[1];
-               f[2] = f[1];
-               
-               Pf[1] = Pf[0];
-               f[1] = f[0];
-               
-               Pf[0] = Pcur;
-               f[0] = dist;
-            }
-            else if (dist < f[1])
-            {
-               Pf[3] = Pf[2];
-               f[3] = f[2];
-               
-               Pf[2] = Pf[1];
-               f[2] = f[1];
-               
-               Pf[1] = Pcur;
-               f[1] = dist;
-            }
-            else if (dist < f[2])
-            {
-               Pf[3] = Pf[2];
-               f[3] = f[2];
-               
-               Pf[2] = Pcur;
-               f[2] = dist;
-            }
-            else if (dist < f[3])
-            {
-               Pf[3] = Pcur;
-               f[3] = dist;
-            }
-         }
-      }
+      FindFeatures(data->distanceFunc, data->caches[sg->tid], Pv, seed, Pf, f);
+   }
+   else
+   {
+      FeaturePoints points;
+      FindFeatures(data->distanceFunc, points, Pv, seed, Pf, f);
+   }
+   
+   if (sample.counting())
+   {
+      // the whole 5x5x5 neighbourhood
+      sample.addCells(125);
    }
    
-   switch (data->outputMode)
+   if (data->outputMode == OM_weighted)
+   {
+      float w[4];
+      w[0] = AiShaderEvalParamFlt(p_weight1);
+      w[1] = AiShaderEvalParamFlt(p_weight2);
+      w[2] = AiShaderEvalParamFlt(p_weight3);
+      w[3] = AiShaderEvalParamFlt(p_weight4);
+      sg->out.FLT() = VoronoiOutput(data->outputMode, displacement, Pf, f, w);
+   }
+   else
    {
-   case OM_constant:
-      sg->out.FLT() = displacement * 0.5f * (1.0f + float(noise::ValueNoise3D(int(floorf(Pf[0].x)), int(floorf(Pf[0].y)), int(floorf(Pf[0].z)))));
-      break;
-   case OM_f1:
-      sg->out.FLT() = displacement * f[0];
-      break;
-   case OM_f2:
-      sg->out.FLT() = displacement * f[1];
-      break;
-   case OM_f3:
-      sg->out.FLT() = displacement * f[2];
-      break;
-   case OM_f4:
-      sg->out.FLT() = displacement * f[3];
-      break;
-   case OM_add:
-      sg->out.FLT() = displacement * (f[0] + f[1]);
-      break;
-   case OM_sub:
-      sg->out.FLT() = displacement * (f[1] - f[0]);
-      break;
-   case OM_mul:
-      sg->out.FLT() = displacement * (f[0] * f[1]);
-      break;
-   case OM_weighted:
-      {
-         float w1 = AiShaderEvalParamFlt(p_weight1);
-         float w2 = AiShaderEvalParamFlt(p_weight2);
-         float w3 = AiShaderEvalParamFlt(p_weight3);
-         float w4 = AiShaderEvalParamFlt(p_weight4);
-         sg->out.FLT() = displacement * (w1 * f[0] + w2 * f[1] + w3 * f[2] + w4 * f[3]);
-      }
-      break;
-   default:
-      sg->out.FLT() = 0.0f;
-      break;
+      sg->out.FLT() = VoronoiOutput(data->outputMode, displacement, Pf, f, 0);
    }
 }
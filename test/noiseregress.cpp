@@ -0,0 +1,1245 @@
+/*
+MIT License
+
+Copyright (c) 2016 Gaetan Guidet
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Shader output regression tool.
+//
+// Samples the fractal, distort_point and voronoi shader kernels over fixed 3D
+// point grids for a set of parameter presets and either writes the results
+// as reference buffers or compares them against previously written ones.
+//
+// Usage: noiseregress (-write <dir> | -compare <dir>) [options]
+//   -filter <str>     only run cases whose name contains str
+//   -exact            require bit exact results, ignoring case tolerances
+//   -ulps <n>         override the ULP tolerance of all cases
+//   -abs <x>          override the absolute tolerance of all cases
+//   -verbose          print the first mismatching values of failed cases
+//   -batch            evaluate through the batch entry points (Eval*Batch),
+//                     compared against the same references
+//
+// A value matches its reference when it is within the ULP or the absolute
+// tolerance of the case. The exit code is 0 only when all cases match.
+//
+// -write creates the output directory if needed. Reference files are named
+// <case>.<grid>.ref ('/' in case names replaced by '_'). They hold the
+// "NOISEREF" magic, then version, components per point and point count as
+// 32 bits unsigned integers, then the float values, all in native byte order.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <cerrno>
+#if defined(_MSC_VER)
+#  include <direct.h>
+#else
+#  include <sys/stat.h>
+#  include <sys/types.h>
+#endif
+#include "kernels/fractal.h"
+#include "kernels/distort_point.h"
+#include "kernels/curl_noise.h"
+#include "kernels/voronoi.h"
+
+// Point grids
+
+struct Grid
+{
+   std::string name;
+   std::vector<Vec3> points;
+};
+
+void MakeGrid(const char *name, const Vec3 &origin, float spacing, int res, Grid &grid)
+{
+   grid.name = name;
+   grid.points.clear();
+   grid.points.reserve(res * res * res);
+   
+   for (int k=0; k<res; ++k)
+   {
+      for (int j=0; j<res; ++j)
+      {
+         for (int i=0; i<res; ++i)
+         {
+            grid.points.push_back(Vec3(origin.x + i * spacing, origin.y + j * spacing, origin.z + k * spacing));
+         }
+      }
+   }
+}
+
+// Test cases
+
+struct Tolerance
+{
+   int ulps;
+   float abs;
+   
+   Tolerance(int u=0, float a=0.0f)
+      : ulps(u), abs(a)
+   {
+   }
+};
+
+class Case
+{
+public:
+   
+   Case(const std::string &name, int components, const Tolerance &tolerance)
+      : _name(name), _components(components), _tolerance(tolerance)
+   {
+   }
+   
+   virtual ~Case()
+   {
+   }
+   
+   const std::string& name() const
+   {
+      return _name;
+   }
+   
+   int components() const
+   {
+      return _components;
+   }
+   
+   const Tolerance& tolerance() const
+   {
+      return _tolerance;
+   }
+   
+   // Write components() values to out
+   virtual void sample(const Vec3 &P, float *out) = 0;
+   
+   // Same for n points given as x, y and z arrays
+   virtual void sample(size_t n, const float *x, const float *y, const float *z, float *out)
+   {
+      for (size_t i=0; i<n; ++i)
+      {
+         sample(Vec3(x[i], y[i], z[i]), out + i * _components);
+      }
+   }
+   
+private:
+   
+   std::string _name;
+   int _components;
+   Tolerance _tolerance;
+};
+
+class FractalCase : public Case
+{
+public:
+   
+   FractalCase(const std::string &name, NoiseType type, const FractalValues &values, const Tolerance &tolerance, float filterWidth=0.0f)
+      : Case(name, 1, tolerance)
+      , _values(values)
+      , _filterWidth(filterWidth)
+      , _evaluator(CreateEvaluator(type, ModifierIndex(values.turbulent, values.ridged)))
+   {
+      _evaluator->setup(_values);
+   }
+   
+   virtual ~FractalCase()
+   {
+      delete _evaluator;
+   }
+   
+   virtual void sample(const Vec3 &P, float *out)
+   {
+      out[0] = Remap(_values, _evaluator->eval(P, _filterWidth));
+   }
+   
+   virtual void sample(size_t n, const float *x, const float *y, const float *z, float *out)
+   {
+      EvalFractalBatch(*_evaluator, _values, n, x, y, z, out, _filterWidth);
+   }
+   
+private:
+   
+   FractalCase(const FractalCase&);
+   FractalCase& operator=(const FractalCase&);
+   
+   FractalValues _values;
+   float _filterWidth;
+   FractalEvaluator *_evaluator;
+};
+
+// Octaves fading must not move the average output (see OctaveFading): for
+// each filter width, the shift of the fractal mean over a block of points
+// around P from the unfiltered one. Values are 0 while the shift is within
+// limit, the excess otherwise.
+class FractalFadeMeanCase : public Case
+{
+public:
+   
+   enum
+   {
+      Widths = 3,
+      BlockSize = 4
+   };
+   
+   FractalFadeMeanCase(const std::string &name, NoiseType type, const FractalValues &values, const Tolerance &tolerance, float limit)
+      : Case(name, Widths, tolerance)
+      , _values(values)
+      , _limit(limit)
+      , _evaluator(CreateEvaluator(type, ModifierIndex(values.turbulent, values.ridged)))
+   {
+      _evaluator->setup(_values);
+   }
+   
+   virtual ~FractalFadeMeanCase()
+   {
+      delete _evaluator;
+   }
+   
+   virtual void sample(const Vec3 &P, float *out)
+   {
+      static const float FilterWidths[Widths] = {0.02f, 0.05f, 0.1f};
+      
+      float unfiltered = mean(P, 0.0f);
+      
+      for (int i=0; i<Widths; ++i)
+      {
+         float shift = fabsf(mean(P, FilterWidths[i]) - unfiltered);
+         out[i] = (shift > _limit ? shift - _limit : 0.0f);
+      }
+   }
+   
+private:
+   
+   FractalFadeMeanCase(const FractalFadeMeanCase&);
+   FractalFadeMeanCase& operator=(const FractalFadeMeanCase&);
+   
+   // BlockSize^3 points spread over several cells of the first octave
+   float mean(const Vec3 &P, float filterWidth) const
+   {
+      float sum = 0.0f;
+      
+      for (int k=0; k<BlockSize; ++k)
+      {
+         for (int j=0; j<BlockSize; ++j)
+         {
+            for (int i=0; i<BlockSize; ++i)
+            {
+               Vec3 offset(1.37f * i + 0.13f * j, 1.29f * j + 0.17f * k, 1.31f * k + 0.11f * i);
+               sum += _evaluator->eval(P + offset, filterWidth);
+            }
+         }
+      }
+      
+      return sum / float(BlockSize * BlockSize * BlockSize);
+   }
+   
+   FractalValues _values;
+   float _limit;
+   FractalEvaluator *_evaluator;
+};
+
+// Same as the fractal_bump shader: remapped output followed by its gradient
+class FractalGradientCase : public Case
+{
+public:
+   
+   FractalGradientCase(const std::string &name, NoiseType type, const FractalValues &values, const Tolerance &tolerance)
+      : Case(name, 4, tolerance)
+      , _values(values)
+      , _evaluator(CreateEvaluator(type, ModifierIndex(values.turbulent, values.ridged)))
+   {
+      _evaluator->setup(_values);
+   }
+   
+   virtual ~FractalGradientCase()
+   {
+      delete _evaluator;
+   }
+   
+   virtual void sample(const Vec3 &P, float *out)
+   {
+      Vec3 grad;
+      out[0] = Remap(_values, _evaluator->eval(P, 0.0f, grad), grad);
+      out[1] = grad.x;
+      out[2] = grad.y;
+      out[3] = grad.z;
+   }
+   
+private:
+   
+   FractalGradientCase(const FractalGradientCase&);
+   FractalGradientCase& operator=(const FractalGradientCase&);
+   
+   FractalValues _values;
+   FractalEvaluator *_evaluator;
+};
+
+// Same as the fractal shader with motion reuse enabled: the output at P
+// followed by the one of the same shading point at another time sample,
+// moved to a nearby input and expanded around P
+class FractalReuseCase : public Case
+{
+public:
+   
+   FractalReuseCase(const std::string &name, NoiseType type, const FractalValues &values, const Tolerance &tolerance, float cellFraction)
+      : Case(name, 2, tolerance)
+      , _values(values)
+      , _evaluator(CreateEvaluator(type, ModifierIndex(values.turbulent, values.ridged)))
+      , _distance(ReuseDistance(values, cellFraction))
+   {
+      _evaluator->setup(_values);
+   }
+   
+   virtual ~FractalReuseCase()
+   {
+      delete _evaluator;
+   }
+   
+   virtual void sample(const Vec3 &P, float *out)
+   {
+      ShadingPointKey key = {this, 0, 0.25f, 0.5f, 0, 0, 0};
+      bool reused = false;
+      Vec3 offset = (0.5f * _distance) * Vec3(0.6f, -0.48f, 0.64f);
+      _reuse.reset();
+      out[0] = Remap(_values, _reuse.eval(_evaluator, key, 0.0f, P, _distance, reused));
+      out[1] = Remap(_values, _reuse.eval(_evaluator, key, 0.5f, P + offset, _distance, reused));
+   }
+   
+private:
+   
+   FractalReuseCase(const FractalReuseCase&);
+   FractalReuseCase& operator=(const FractalReuseCase&);
+   
+   FractalValues _values;
+   FractalEvaluator *_evaluator;
+   FractalSampleReuse _reuse;
+   float _distance;
+};
+
+// Same as the fractal shader with bake enabled, points outside the bounds are
+// evaluated directly
+class BakedFractalCase : public Case
+{
+public:
+   
+   BakedFractalCase(const std::string &name, NoiseType type, const FractalValues &values, const Tolerance &tolerance,
+                    const Vec3 &bmin, const Vec3 &bmax, BakeInterpolation interpolation)
+      : Case(name, 1, tolerance)
+      , _values(values)
+      , _interpolation(interpolation)
+      , _evaluator(CreateEvaluator(type, ModifierIndex(values.turbulent, values.ridged)))
+      , _grid(bmin, bmax, BakeSpacing(values), 64 << 20)
+   {
+      _evaluator->setup(_values);
+      _source.bind(_evaluator);
+   }
+   
+   virtual ~BakedFractalCase()
+   {
+      delete _evaluator;
+   }
+   
+   virtual void sample(const Vec3 &P, float *out)
+   {
+      float rv = (_grid.contains(P) ? _grid.lookup(_source, P, _interpolation) : _evaluator->eval(P, 0.0f));
+      out[0] = Remap(_values, rv);
+   }
+   
+private:
+   
+   BakedFractalCase(const BakedFractalCase&);
+   BakedFractalCase& operator=(const BakedFractalCase&);
+   
+   FractalValues _values;
+   BakeInterpolation _interpolation;
+   FractalEvaluator *_evaluator;
+   FractalBakeSource _source;
+   BakedGrid _grid;
+};
+
+class DistortPointCase : public Case
+{
+public:
+   
+   DistortPointCase(const std::string &name, NoiseType type, const DistortPointValues &values, const Tolerance &tolerance, bool volumeCache=false)
+      : Case(name, 3, tolerance)
+      , _type(type)
+      , _values(values)
+      , _evaluator(CreateDistortPointEvaluator(type))
+      , _bricks(0)
+   {
+      _evaluator->setup(values);
+      
+      if (volumeCache)
+      {
+         _source.bind(type, values);
+         _bricks = new BrickCache(3, BakeSpacing(values), 64 << 20);
+      }
+   }
+   
+   virtual ~DistortPointCase()
+   {
+      delete _bricks;
+      delete _evaluator;
+   }
+   
+   // Same as the distort_point shader_evaluate
+   virtual void sample(const Vec3 &P, float *out)
+   {
+      float offset[3];
+      
+      if (_bricks && _bricks->lookup(_source, P, offset))
+      {
+         out[0] = P.x + offset[0];
+         out[1] = P.y + offset[1];
+         out[2] = P.z + offset[2];
+         return;
+      }
+      
+      Vec3 rv = _evaluator->eval(P, _values.filter_width);
+      out[0] = rv.x;
+      out[1] = rv.y;
+      out[2] = rv.z;
+   }
+   
+   virtual void sample(size_t n, const float *x, const float *y, const float *z, float *out)
+   {
+      if (_bricks)
+      {
+         Case::sample(n, x, y, z, out);
+         return;
+      }
+      
+      std::vector<float> rv(3 * n);
+      
+      EvalDistortPointBatch(_type, _values, n, x, y, z, &rv[0], &rv[n], &rv[2 * n]);
+      
+      for (size_t i=0; i<n; ++i, out+=3)
+      {
+         out[0] = rv[i];
+         out[1] = rv[n + i];
+         out[2] = rv[2 * n + i];
+      }
+   }
+   
+private:
+   
+   DistortPointCase(const DistortPointCase&);
+   DistortPointCase& operator=(const DistortPointCase&);
+   
+   NoiseType _type;
+   DistortPointValues _values;
+   DistortPointEvaluator *_evaluator;
+   DistortPointBakeSource _source;
+   BrickCache *_bricks;
+};
+
+class CurlNoiseCase : public Case
+{
+public:
+   
+   CurlNoiseCase(const std::string &name, const CurlNoiseValues &values, const Tolerance &tolerance)
+      : Case(name, 3, tolerance)
+      , _values(values)
+   {
+   }
+   
+   virtual void sample(const Vec3 &P, float *out)
+   {
+      Vec3 curl = CurlNoise(_values, P);
+      out[0] = curl.x;
+      out[1] = curl.y;
+      out[2] = curl.z;
+   }
+   
+private:
+   
+   CurlNoiseValues _values;
+};
+
+class VoronoiCase : public Case
+{
+public:
+   
+   VoronoiCase(const std::string &name, DistanceFunc func, OutputMode mode, float frequency, int seed, const Tolerance &tolerance, bool featureCache=false)
+      : Case(name, 1, tolerance)
+      , _func(func)
+      , _mode(mode)
+      , _frequency(frequency)
+      , _seed(seed)
+      , _displacement(0.5f)
+      , _cache(featureCache ? new FeatureCache() : 0)
+   {
+      _weights[0] = -1.0f;
+      _weights[1] = 1.0f;
+      _weights[2] = 0.5f;
+      _weights[3] = -0.25f;
+   }
+   
+   virtual ~VoronoiCase()
+   {
+      delete _cache;
+   }
+   
+   // Same as the voronoi shader_evaluate
+   virtual void sample(const Vec3 &inP, float *out)
+   {
+      Vec3 P = inP * _frequency;
+      Vec3 Pf[4] = {P, P, P, P};
+      float f[4] = {2147483647.0f, 2147483647.0f, 2147483647.0f, 2147483647.0f};
+      
+      if (_cache)
+      {
+         FindFeatures(_func, *_cache, P, _seed, Pf, f);
+      }
+      else
+      {
+         FindFeatures(_func, _points, P, _seed, Pf, f);
+      }
+      
+      out[0] = VoronoiOutput(_mode, _displacement, Pf, f, _weights);
+   }
+   
+   virtual void sample(size_t n, const float *x, const float *y, const float *z, float *out)
+   {
+      VoronoiValues values;
+      values.displacement = _displacement;
+      values.frequency = _frequency;
+      values.seed = _seed;
+      values.distance_func = _func;
+      values.output_mode = _mode;
+      for (int i=0; i<4; ++i)
+      {
+         values.weights[i] = _weights[i];
+      }
+      
+      if (_cache)
+      {
+         EvalVoronoiBatch(*_cache, values, n, x, y, z, out);
+      }
+      else
+      {
+         EvalVoronoiBatch(_points, values, n, x, y, z, out);
+      }
+   }
+   
+private:
+   
+   VoronoiCase(const VoronoiCase&);
+   VoronoiCase& operator=(const VoronoiCase&);
+   
+   DistanceFunc _func;
+   OutputMode _mode;
+   float _frequency;
+   int _seed;
+   float _displacement;
+   float _weights[4];
+   FeaturePoints _points;
+   // 0 unless feature_cache is on
+   FeatureCache *_cache;
+};
+
+// Parameter presets, based on the shaders default values
+
+FractalValues DefaultFractalValues()
+{
+   FractalValues values;
+   values.amplitude = 1.0f;
+   values.frequency = 1.0f;
+   values.octaves = 6;
+   values.persistence = 0.5f;
+   values.lacunarity = 2.0f;
+   values.amplitude_threshold = 0.0f;
+   values.value_seed = 0;
+   values.value_quality = NQ_std;
+   values.perlin_seed = 0;
+   values.perlin_quality = NQ_std;
+   values.lattice_hash = NH_legacy;
+   values.flow_power = 0.25f;
+   values.flow_time = 0.0f;
+   values.time = 0.0f;
+   values.permutation = 0;
+   values.turbulent = false;
+   values.turbulence_offset = -0.5f;
+   values.turbulence_scale = 2.0f;
+   values.ridged = false;
+   values.ridge_offset = 1.0f;
+   values.ridge_gain = 2.0f;
+   values.ridge_exponent = 0.0f;
+   values.dampen_output = true;
+   // keep raw fBm values by default, remapping is covered by its own cases
+   values.remap_output = false;
+   values.fractal_min = -1.0f;
+   values.fractal_max = 1.0f;
+   values.output_min = 0.0f;
+   values.output_max = 1.0f;
+   values.clamp_output = true;
+   return values;
+}
+
+DistortPointValues DefaultDistortPointValues()
+{
+   DistortPointValues values;
+   values.frequency = 1.0f;
+   values.power = 1.0f;
+   values.roughness = 3;
+   values.filter_width = 0.0f;
+   values.value_seed = 0;
+   values.perlin_seed = 0;
+   values.lattice_hash = NH_legacy;
+   values.flow_power = 0.25f;
+   values.flow_time = 0.0f;
+   values.time = 0.0f;
+   values.permutation = 0;
+   return values;
+}
+
+static const char *NoiseNames[] = {"value", "perlin", "simplex", "flow"};
+
+// Float libnoise kernels are documented to stay within 1e-5 of the double
+// versions, the other kernels are expected to only differ by rounding
+Tolerance NoiseTolerance(NoiseType type)
+{
+   switch (type)
+   {
+   case NT_value:
+   case NT_perlin:
+      return Tolerance(4, 1.0e-5f);
+   case NT_simplex:
+   case NT_flow:
+   case NT_simplex4d:
+   default:
+      return Tolerance(4, 1.0e-6f);
+   }
+}
+
+void BuildCases(std::vector<Case*> &cases)
+{
+   static const char *ModifierNames[] = {"default", "turbulence", "ridge", "turbulence+ridge"};
+   static const int Octaves[] = {1, 6};
+   
+   // fractal
+   
+   for (int t=0; t<4; ++t)
+   {
+      NoiseType type = NoiseType(t);
+      
+      for (int m=0; m<4; ++m)
+      {
+         for (int o=0; o<2; ++o)
+         {
+            FractalValues values = DefaultFractalValues();
+            values.turbulent = ((m & 1) != 0);
+            values.ridged = ((m & 2) != 0);
+            values.octaves = Octaves[o];
+            
+            char name[256];
+            sprintf(name, "fractal/%s/%s/o%d", NoiseNames[t], ModifierNames[m], Octaves[o]);
+            cases.push_back(new FractalCase(name, type, values, NoiseTolerance(type)));
+         }
+      }
+   }
+   
+   {
+      FractalValues values = DefaultFractalValues();
+      values.value_quality = NQ_fast;
+      values.value_seed = 17;
+      cases.push_back(new FractalCase("fractal/value/fast_seed17", NT_value, values, NoiseTolerance(NT_value)));
+      
+      values = DefaultFractalValues();
+      values.value_quality = NQ_best;
+      cases.push_back(new FractalCase("fractal/value/best", NT_value, values, NoiseTolerance(NT_value)));
+      
+      values = DefaultFractalValues();
+      values.perlin_quality = NQ_fast;
+      values.perlin_seed = 17;
+      cases.push_back(new FractalCase("fractal/perlin/fast_seed17", NT_perlin, values, NoiseTolerance(NT_perlin)));
+      
+      values = DefaultFractalValues();
+      values.perlin_quality = NQ_best;
+      cases.push_back(new FractalCase("fractal/perlin/best", NT_perlin, values, NoiseTolerance(NT_perlin)));
+      
+      values = DefaultFractalValues();
+      values.lattice_hash = NH_xxhash;
+      cases.push_back(new FractalCase("fractal/value/xxhash", NT_value, values, NoiseTolerance(NT_value)));
+      cases.push_back(new FractalCase("fractal/perlin/xxhash", NT_perlin, values, NoiseTolerance(NT_perlin)));
+      
+      values = DefaultFractalValues();
+      values.flow_time = 0.75f;
+      values.flow_power = 0.5f;
+      cases.push_back(new FractalCase("fractal/flow/animated", NT_flow, values, NoiseTolerance(NT_flow)));
+      
+      // permutation tables are kept until exit
+      values = DefaultFractalValues();
+      values.permutation = AcquirePermutationTable(7);
+      cases.push_back(new FractalCase("fractal/simplex/seed7", NT_simplex, values, NoiseTolerance(NT_simplex)));
+      
+      values.flow_time = 0.75f;
+      values.flow_power = 0.5f;
+      cases.push_back(new FractalCase("fractal/flow/seed7", NT_flow, values, NoiseTolerance(NT_flow)));
+      
+      values = DefaultFractalValues();
+      values.time = 0.37f;
+      cases.push_back(new FractalCase("fractal/simplex4d/animated", NT_simplex4d, values, NoiseTolerance(NT_simplex4d)));
+      
+      values.ridged = true;
+      values.permutation = AcquirePermutationTable(7);
+      cases.push_back(new FractalCase("fractal/simplex4d/ridge_seed7", NT_simplex4d, values, NoiseTolerance(NT_simplex4d)));
+      
+      values = DefaultFractalValues();
+      values.frequency = 3.7f;
+      values.amplitude = 1.5f;
+      values.persistence = 0.65f;
+      values.lacunarity = 2.3f;
+      values.dampen_output = false;
+      cases.push_back(new FractalCase("fractal/simplex/custom_fbm", NT_simplex, values, NoiseTolerance(NT_simplex)));
+      
+      values = DefaultFractalValues();
+      values.ridged = true;
+      values.ridge_exponent = 0.8f;
+      cases.push_back(new FractalCase("fractal/perlin/ridge_exponent", NT_perlin, values, NoiseTolerance(NT_perlin)));
+      
+      values = DefaultFractalValues();
+      values.remap_output = true;
+      cases.push_back(new FractalCase("fractal/simplex/remap_clamp", NT_simplex, values, NoiseTolerance(NT_simplex)));
+      
+      values = DefaultFractalValues();
+      values.remap_output = true;
+      values.clamp_output = false;
+      values.fractal_min = -0.5f;
+      values.fractal_max = 0.5f;
+      values.output_min = 1.0f;
+      values.output_max = -1.0f;
+      cases.push_back(new FractalCase("fractal/simplex/remap_inverted", NT_simplex, values, NoiseTolerance(NT_simplex)));
+      
+      values = DefaultFractalValues();
+      values.octaves = 10;
+      cases.push_back(new FractalCase("fractal/perlin/auto_octaves", NT_perlin, values, NoiseTolerance(NT_perlin), 0.02f));
+      
+      values.ridged = true;
+      cases.push_back(new FractalCase("fractal/simplex/ridge_auto_octaves", NT_simplex, values, NoiseTolerance(NT_simplex), 0.02f));
+      
+      for (int m=0; m<4; ++m)
+      {
+         values = DefaultFractalValues();
+         values.turbulent = ((m & 1) != 0);
+         values.ridged = ((m & 2) != 0);
+         values.octaves = 8;
+         
+         char name[256];
+         sprintf(name, "fractal_fade_mean/perlin/%s", ModifierNames[m]);
+         cases.push_back(new FractalFadeMeanCase(name, NT_perlin, values, Tolerance(4, 1.0e-6f), 0.05f));
+      }
+      
+      values = DefaultFractalValues();
+      values.octaves = 4.5f;
+      cases.push_back(new FractalCase("fractal/perlin/fractional_octaves", NT_perlin, values, NoiseTolerance(NT_perlin)));
+      
+      values = DefaultFractalValues();
+      values.octaves = 10;
+      values.amplitude_threshold = 0.01f;
+      cases.push_back(new FractalCase("fractal/simplex/amplitude_threshold", NT_simplex, values, NoiseTolerance(NT_simplex)));
+      
+      // gradients scale rounding differences by the octave frequencies
+      values = DefaultFractalValues();
+      cases.push_back(new FractalGradientCase("fractal_gradient/simplex/default", NT_simplex, values, Tolerance(4, 1.0e-4f)));
+      values.ridged = true;
+      cases.push_back(new FractalGradientCase("fractal_gradient/simplex/ridged", NT_simplex, values, Tolerance(4, 1.0e-4f)));
+      values = DefaultFractalValues();
+      cases.push_back(new FractalGradientCase("fractal_gradient/value/default", NT_value, values, Tolerance(4, 1.0e-4f)));
+      cases.push_back(new FractalGradientCase("fractal_gradient/perlin/default", NT_perlin, values, Tolerance(4, 1.0e-4f)));
+      values.turbulent = true;
+      cases.push_back(new FractalGradientCase("fractal_gradient/perlin/turbulent", NT_perlin, values, Tolerance(4, 1.0e-4f)));
+      
+      values = DefaultFractalValues();
+      cases.push_back(new FractalReuseCase("fractal_reuse/simplex/default", NT_simplex, values, Tolerance(4, 1.0e-5f), FRACTAL_REUSE_DEFAULT_DISTANCE));
+      cases.push_back(new FractalReuseCase("fractal_reuse/perlin/default", NT_perlin, values, Tolerance(4, 1.0e-5f), FRACTAL_REUSE_DEFAULT_DISTANCE));
+      
+      values = DefaultFractalValues();
+      values.octaves = 3;
+      cases.push_back(new BakedFractalCase("fractal/simplex/baked_linear", NT_simplex, values, NoiseTolerance(NT_simplex),
+                                           Vec3(-1.0f, -1.0f, -1.0f), Vec3(2.0f, 2.0f, 2.0f), BI_linear));
+      cases.push_back(new BakedFractalCase("fractal/perlin/baked_cubic", NT_perlin, values, NoiseTolerance(NT_perlin),
+                                           Vec3(-1.0f, -1.0f, -1.0f), Vec3(2.0f, 2.0f, 2.0f), BI_cubic));
+   }
+   
+   // distort_point
+   
+   for (int t=0; t<4; ++t)
+   {
+      NoiseType type = NoiseType(t);
+      
+      for (int r=1; r<=3; r+=2)
+      {
+         DistortPointValues values = DefaultDistortPointValues();
+         values.roughness = r;
+         
+         char name[256];
+         sprintf(name, "distort_point/%s/r%d", NoiseNames[t], r);
+         cases.push_back(new DistortPointCase(name, type, values, NoiseTolerance(type)));
+      }
+   }
+   
+   {
+      DistortPointValues values = DefaultDistortPointValues();
+      values.frequency = 2.5f;
+      values.power = 0.3f;
+      values.value_seed = 5;
+      values.perlin_seed = 5;
+      values.flow_time = 0.5f;
+      
+      for (int t=0; t<4; ++t)
+      {
+         char name[256];
+         sprintf(name, "distort_point/%s/custom", NoiseNames[t]);
+         cases.push_back(new DistortPointCase(name, NoiseType(t), values, NoiseTolerance(NoiseType(t))));
+      }
+      
+      values = DefaultDistortPointValues();
+      values.roughness = 8;
+      values.filter_width = 0.05f;
+      cases.push_back(new DistortPointCase("distort_point/simplex/auto_octaves", NT_simplex, values, NoiseTolerance(NT_simplex)));
+      
+      values.filter_width = 0.0f;
+      cases.push_back(new DistortPointCase("distort_point/simplex/volume_cache", NT_simplex, values, NoiseTolerance(NT_simplex), true));
+      
+      values = DefaultDistortPointValues();
+      values.permutation = AcquirePermutationTable(-3);
+      cases.push_back(new DistortPointCase("distort_point/simplex/seed-3", NT_simplex, values, NoiseTolerance(NT_simplex)));
+      
+      values = DefaultDistortPointValues();
+      values.time = 0.37f;
+      cases.push_back(new DistortPointCase("distort_point/simplex4d/animated", NT_simplex4d, values, NoiseTolerance(NT_simplex4d)));
+   }
+   
+   // curl_noise
+   //
+   // Sums of derivatives scaled by the octave frequencies, same tolerance as
+   // the fractal gradients
+   {
+      CurlNoiseValues values;
+      values.frequency = 1.0f;
+      values.power = 1.0f;
+      values.roughness = 3;
+      values.filter_width = 0.0f;
+      values.permutation = 0;
+      cases.push_back(new CurlNoiseCase("curl_noise/default", values, Tolerance(4, 1.0e-4f)));
+      
+      values.frequency = 2.5f;
+      values.permutation = AcquirePermutationTable(7);
+      cases.push_back(new CurlNoiseCase("curl_noise/freq2.5_seed7", values, Tolerance(4, 1.0e-4f)));
+   }
+   
+   // voronoi
+   //
+   // The cell search must select the same feature points, the distances only
+   // allow for rounding. constant mode outputs the value of the nearest cell
+   // so any difference is a different cell.
+   
+   static const char *MetricNames[] = {"euclidian", "manhattan", "chebyshev"};
+   static const char *ModeNames[] = {"constant", "f1", "f2", "f3", "f4", "add", "sub", "mul", "weighted"};
+   
+   for (int d=0; d<3; ++d)
+   {
+      for (int m=0; m<=OM_weighted; ++m)
+      {
+         char name[256];
+         sprintf(name, "voronoi/%s/%s", MetricNames[d], ModeNames[m]);
+         Tolerance tolerance = (m == OM_constant ? Tolerance(0, 0.0f) : Tolerance(4, 1.0e-6f));
+         cases.push_back(new VoronoiCase(name, DistanceFunc(d), OutputMode(m), 1.0f, 0, tolerance));
+      }
+   }
+   
+   cases.push_back(new VoronoiCase("voronoi/euclidian/f2/freq2.5_seed7", DF_euclidian, OM_f2, 2.5f, 7, Tolerance(4, 1.0e-6f)));
+   cases.push_back(new VoronoiCase("voronoi/euclidian/weighted/feature_cache", DF_euclidian, OM_weighted, 1.0f, 0, Tolerance(4, 1.0e-6f), true));
+}
+
+// Reference files
+
+static const char RefMagic[8] = {'N', 'O', 'I', 'S', 'E', 'R', 'E', 'F'};
+static const unsigned int RefVersion = 1;
+
+std::string RefPath(const std::string &dir, const Case &c, const Grid &grid)
+{
+   std::string name = c.name();
+   for (size_t i=0; i<name.length(); ++i)
+   {
+      if (name[i] == '/')
+      {
+         name[i] = '_';
+      }
+   }
+   return dir + "/" + name + "." + grid.name + ".ref";
+}
+
+// Create dir and its missing parents
+bool MakeDirs(const std::string &dir)
+{
+   for (size_t i=1; i<=dir.length(); ++i)
+   {
+      if (i < dir.length() && dir[i] != '/' && dir[i] != '\\')
+      {
+         continue;
+      }
+      
+      std::string sub = dir.substr(0, i);
+      if (sub[sub.length() - 1] == ':')
+      {
+         // drive letter
+         continue;
+      }
+#if defined(_MSC_VER)
+      int rv = _mkdir(sub.c_str());
+#else
+      int rv = mkdir(sub.c_str(), 0755);
+#endif
+      if (rv != 0 && errno != EEXIST)
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+bool WriteRef(const std::string &path, unsigned int components, const std::vector<float> &values)
+{
+   FILE *f = fopen(path.c_str(), "wb");
+   if (!f)
+   {
+      return false;
+   }
+   
+   unsigned int header[3] = {RefVersion, components, (unsigned int)(values.size() / components)};
+   
+   bool rv = (fwrite(RefMagic, 1, 8, f) == 8 &&
+              fwrite(header, sizeof(unsigned int), 3, f) == 3 &&
+              fwrite(&values[0], sizeof(float), values.size(), f) == values.size());
+   
+   fclose(f);
+   
+   return rv;
+}
+
+bool ReadRef(const std::string &path, unsigned int components, std::vector<float> &values)
+{
+   FILE *f = fopen(path.c_str(), "rb");
+   if (!f)
+   {
+      return false;
+   }
+   
+   char magic[8];
+   unsigned int header[3];
+   
+   bool rv = (fread(magic, 1, 8, f) == 8 &&
+              memcmp(magic, RefMagic, 8) == 0 &&
+              fread(header, sizeof(unsigned int), 3, f) == 3 &&
+              header[0] == RefVersion &&
+              header[1] == components);
+   
+   if (rv)
+   {
+      values.resize(header[1] * header[2]);
+      rv = (values.size() == 0 || fread(&values[0], sizeof(float), values.size(), f) == values.size());
+   }
+   
+   fclose(f);
+   
+   return rv;
+}
+
+// Comparison
+
+// Map float bits to integers ordered as the floats they represent
+inline long long OrderedBits(float v)
+{
+   int i;
+   memcpy(&i, &v, sizeof(float));
+   return (i < 0 ? (long long)(int(0x80000000) - i) : (long long)i);
+}
+
+inline long long UlpDistance(float a, float b)
+{
+   long long d = OrderedBits(a) - OrderedBits(b);
+   return (d < 0 ? -d : d);
+}
+
+struct Options
+{
+   bool write;
+   std::string dir;
+   std::string filter;
+   bool verbose;
+   bool batch;
+   int ulps;
+   float abs;
+   
+   Options()
+      : write(false), verbose(false), batch(false), ulps(-1), abs(-1.0f)
+   {
+   }
+};
+
+// Returns the number of values out of tolerance
+size_t Compare(const Options &opts, const Case &c, const Grid &grid, const std::vector<float> &ref, const std::vector<float> &cur, long long &maxUlps, float &maxAbs)
+{
+   Tolerance tolerance = c.tolerance();
+   if (opts.ulps >= 0)
+   {
+      tolerance.ulps = opts.ulps;
+   }
+   if (opts.abs >= 0.0f)
+   {
+      tolerance.abs = opts.abs;
+   }
+   
+   size_t failed = 0;
+   maxUlps = 0;
+   maxAbs = 0.0f;
+   
+   for (size_t i=0; i<cur.size(); ++i)
+   {
+      float a = ref[i];
+      float b = cur[i];
+      
+      if (memcmp(&a, &b, sizeof(float)) == 0)
+      {
+         continue;
+      }
+      
+      bool ok = false;
+      
+      if (a != a || b != b)
+      {
+         // NaN only matches NaN
+         ok = (a != a && b != b);
+         if (!ok)
+         {
+            maxUlps = -1;
+         }
+      }
+      else
+      {
+         long long ulps = UlpDistance(a, b);
+         float diff = fabsf(a - b);
+         
+         if (maxUlps >= 0 && ulps > maxUlps)
+         {
+            maxUlps = ulps;
+         }
+         if (diff > maxAbs)
+         {
+            maxAbs = diff;
+         }
+         
+         ok = (ulps <= tolerance.ulps || diff <= tolerance.abs);
+      }
+      
+      if (!ok)
+      {
+         if (opts.verbose && failed < 10)
+         {
+            size_t p = i / c.components();
+            const Vec3 &P = grid.points[p];
+            fprintf(stderr, "  point %lu (%g, %g, %g)[%lu]: expected %.9g, got %.9g\n",
+                    (unsigned long) p, P.x, P.y, P.z, (unsigned long) (i % c.components()), a, b);
+         }
+         ++failed;
+      }
+   }
+   
+   return failed;
+}
+
+void Usage()
+{
+   fprintf(stderr, "Usage: noiseregress (-write <dir> | -compare <dir>) [-filter str] [-exact] [-ulps n] [-abs x] [-verbose] [-batch]\n");
+}
+
+int main(int argc, char **argv)
+{
+   Options opts;
+   bool hasMode = false;
+   
+   for (int i=1; i<argc; ++i)
+   {
+      bool hasValue = (i + 1 < argc);
+      
+      if ((!strcmp(argv[i], "-write") || !strcmp(argv[i], "-compare")) && hasValue && !hasMode)
+      {
+         opts.write = (argv[i][1] == 'w');
+         opts.dir = argv[++i];
+         hasMode = true;
+      }
+      else if (!strcmp(argv[i], "-filter") && hasValue)
+      {
+         opts.filter = argv[++i];
+      }
+      else if (!strcmp(argv[i], "-exact"))
+      {
+         opts.ulps = 0;
+         opts.abs = 0.0f;
+      }
+      else if (!strcmp(argv[i], "-ulps") && hasValue)
+      {
+         opts.ulps = atoi(argv[++i]);
+      }
+      else if (!strcmp(argv[i], "-abs") && hasValue)
+      {
+         opts.abs = float(atof(argv[++i]));
+      }
+      else if (!strcmp(argv[i], "-verbose"))
+      {
+         opts.verbose = true;
+      }
+      else if (!strcmp(argv[i], "-batch"))
+      {
+         opts.batch = true;
+      }
+      else
+      {
+         Usage();
+         return 1;
+      }
+   }
+   
+   if (!hasMode)
+   {
+      Usage();
+      return 1;
+   }
+   
+   if (opts.write && !MakeDirs(opts.dir))
+   {
+      fprintf(stderr, "Could not create output directory '%s'\n", opts.dir.c_str());
+      return 1;
+   }
+   
+   std::vector<Grid> grids(2);
+   // small coordinates, offset so that points don't lie on lattice boundaries
+   MakeGrid("near", Vec3(-1.487f, -1.473f, -1.459f), 0.25f, 12, grids[0]);
+   // large coordinates, where single precision rounding matters most
+   MakeGrid("far", Vec3(1021.3f, -517.7f, 263.9f), 0.71f, 8, grids[1]);
+   
+   std::vector<Case*> cases;
+   BuildCases(cases);
+   
+   int failures = 0;
+   int count = 0;
+   
+   for (size_t i=0; i<cases.size(); ++i)
+   {
+      Case &c = *(cases[i]);
+      
+      if (opts.filter.length() > 0 && c.name().find(opts.filter) == std::string::npos)
+      {
+         continue;
+      }
+      
+      for (size_t j=0; j<grids.size(); ++j)
+      {
+         const Grid &grid = grids[j];
+         std::string path = RefPath(opts.dir, c, grid);
+         std::vector<float> cur(grid.points.size() * c.components());
+         
+         if (opts.batch)
+         {
+            size_t n = grid.points.size();
+            std::vector<float> soa(3 * n);
+            
+            for (size_t k=0; k<n; ++k)
+            {
+               soa[k] = grid.points[k].x;
+               soa[n + k] = grid.points[k].y;
+               soa[2 * n + k] = grid.points[k].z;
+            }
+            
+            c.sample(n, &soa[0], &soa[n], &soa[2 * n], &cur[0]);
+         }
+         else
+         {
+            for (size_t k=0; k<grid.points.size(); ++k)
+            {
+               c.sample(grid.points[k], &cur[k * c.components()]);
+            }
+         }
+         
+         ++count;
+         
+         if (opts.write)
+         {
+            if (!WriteRef(path, c.components(), cur))
+            {
+               fprintf(stderr, "Could not write '%s'\n", path.c_str());
+               ++failures;
+            }
+            continue;
+         }
+         
+         std::vector<float> ref;
+         
+         if (!ReadRef(path, c.components(), ref) || ref.size() != cur.size())
+         {
+            fprintf(stdout, "MISSING %s [%s]: invalid or missing reference '%s'\n", c.name().c_str(), grid.name.c_str(), path.c_str());
+            ++failures;
+            continue;
+         }
+         
+         long long maxUlps = 0;
+         float maxAbs = 0.0f;
+         size_t failed = Compare(opts, c, grid, ref, cur, maxUlps, maxAbs);
+         
+         if (maxUlps < 0)
+         {
+            fprintf(stdout, "%s %s [%s]: %lu/%lu values out of tolerance, NaN mismatch, max abs error %g\n",
+                    (failed > 0 ? "FAIL" : "PASS"), c.name().c_str(), grid.name.c_str(), (unsigned long) failed, (unsigned long) cur.size(), maxAbs);
+         }
+         else
+         {
+            fprintf(stdout, "%s %s [%s]: %lu/%lu values out of tolerance, max %lld ulp(s), max abs error %g\n",
+                    (failed > 0 ? "FAIL" : "PASS"), c.name().c_str(), grid.name.c_str(), (unsigned long) failed, (unsigned long) cur.size(), maxUlps, maxAbs);
+         }
+         
+         if (failed > 0)
+         {
+            ++failures;
+         }
+      }
+   }
+   
+   for (size_t i=0; i<cases.size(); ++i)
+   {
+      delete cases[i];
+   }
+   
+   if (opts.write)
+   {
+      fprintf(stdout, "Wrote %d reference buffer(s) to '%s', %d error(s)\n", count - failures, opts.dir.c_str(), failures);
+   }
+   else
+   {
+      fprintf(stdout, "%d/%d comparison(s) passed\n", count - failures, count);
+   }
+   
+   return (failures > 0 ? 1 : 0);
+}
@@ -0,0 +1,1586 @@
+/*
+MIT License
+
+Copyright (c) 2016 Gaetan Guidet
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Offline noise baker.
+//
+// Evaluates a fractal, voronoi or distort_point parameter set over a grid of
+// points with the shaders' kernels and writes a tiled OpenEXR image
+// (optionally mip-mapped) or raw floats.
+//
+// The image is produced one row of tiles at a time: the tiles of a row are
+// evaluated by a work-stealing thread pool, then the row is written and
+// downsampled into the next mip level. Only one row of tiles per level is
+// kept in memory, so very large bakes don't need the full image.
+//
+// Usage: noisebake -node <fractal|voronoi|distort_point> -output <path> [options]
+//   -res <w> <h>          image resolution (default 1024 1024)
+//   -uv                   P = (u, v, 0), u and v in [0, 1] (default)
+//   -plane <o> <U> <V>    P = o + u * U + v * V (9 floats)
+//   -box <min> <max>      3D grid over a box (6 floats), see -depth
+//   -depth <d>            number of z slices of a -box bake (raw only)
+//   -set <name> <value>   node parameter, by shader name (enums by label)
+//   -tile <n>             tile size, a power of 2 (default 64)
+//   -mipmap               also write the mip levels (2x2 box filter)
+//   -threads <n>          worker threads (default: all cores)
+//   -format <exr|raw>     output format (default: from the extension, exr)
+//
+// Pixel centers are sampled, v goes up (row 0 is v = 1). Points use the
+// node's Pref-like input: auto_octaves derives the filter width from the
+// pixel footprint.
+//
+// Raw output holds little-endian float32 values, channels interleaved,
+// rows from top to bottom, slices one after another. Mip level l (l > 0) is
+// written next to the output as <name>.<l><ext>.
+//
+// EXR output is uncompressed, one FLOAT channel per component ("Y" for
+// fractal and voronoi, "R", "G" and "B" for distort_point).
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "kernels/fractal.h"
+#include "kernels/distort_point.h"
+#include "kernels/voronoi.h"
+#include "kernels/permutation.h"
+#include "kernels/atomic.h"
+
+#ifdef _WIN32
+#  include <windows.h>
+#  include <process.h>
+#else
+#  include <pthread.h>
+#  include <unistd.h>
+#  include <sys/time.h>
+#endif
+
+// Threads
+
+class Thread
+{
+public:
+
+   typedef void (*Func)(void*);
+   
+   Thread()
+      : _func(0), _arg(0), _started(false)
+   {
+   }
+   
+   bool start(Func func, void *arg)
+   {
+      _func = func;
+      _arg = arg;
+#ifdef _WIN32
+      _handle = (HANDLE) _beginthreadex(NULL, 0, &Thread::Entry, this, 0, NULL);
+      _started = (_handle != 0);
+#else
+      _started = (pthread_create(&_handle, NULL, &Thread::Entry, this) == 0);
+#endif
+      return _started;
+   }
+   
+   void join()
+   {
+      if (_started)
+      {
+#ifdef _WIN32
+         WaitForSingleObject(_handle, INFINITE);
+         CloseHandle(_handle);
+#else
+         pthread_join(_handle, NULL);
+#endif
+         _started = false;
+      }
+   }
+   
+   static int HardwareConcurrency()
+   {
+#ifdef _WIN32
+      SYSTEM_INFO info;
+      GetSystemInfo(&info);
+      return int(info.dwNumberOfProcessors);
+#else
+      long n = sysconf(_SC_NPROCESSORS_ONLN);
+      return (n > 0 ? int(n) : 1);
+#endif
+   }
+
+private:
+
+#ifdef _WIN32
+   static unsigned __stdcall Entry(void *self)
+   {
+      ((Thread*) self)->_func(((Thread*) self)->_arg);
+      return 0;
+   }
+   
+   HANDLE _handle;
+#else
+   static void* Entry(void *self)
+   {
+      ((Thread*) self)->_func(((Thread*) self)->_arg);
+      return NULL;
+   }
+   
+   pthread_t _handle;
+#endif
+
+   Func _func;
+   void *_arg;
+   bool _started;
+};
+
+double Now()
+{
+#ifdef _WIN32
+   LARGE_INTEGER freq, count;
+   QueryPerformanceFrequency(&freq);
+   QueryPerformanceCounter(&count);
+   return double(count.QuadPart) / double(freq.QuadPart);
+#else
+   struct timeval tv;
+   gettimeofday(&tv, NULL);
+   return double(tv.tv_sec) + 1.0e-6 * double(tv.tv_usec);
+#endif
+}
+
+// Work-stealing pool
+//
+// Each run's tasks are split in contiguous ranges, one per worker. Workers
+// pop tasks from the back of their own queue and, once it is empty, steal
+// from the front of the others' so that neighbouring tiles stay on the same
+// worker as long as possible. Tasks don't spawn other tasks: a worker exits
+// when all queues are empty.
+
+class Task
+{
+public:
+
+   virtual ~Task()
+   {
+   }
+   
+   // worker is in [0, WorkStealingPool::workers())
+   virtual void run(int index, int worker) = 0;
+};
+
+class WorkStealingPool
+{
+public:
+
+   WorkStealingPool(int workers)
+      : _queues(std::max(1, workers))
+      , _task(0)
+   {
+   }
+   
+   int workers() const
+   {
+      return int(_queues.size());
+   }
+   
+   void run(Task &task, int count)
+   {
+      int n = workers();
+      
+      _task = &task;
+      
+      for (int w=0; w<n; ++w)
+      {
+         _queues[w].begin = int((long long) count * w / n);
+         _queues[w].end = int((long long) count * (w + 1) / n);
+      }
+      
+      if (n == 1)
+      {
+         work(0);
+         return;
+      }
+      
+      std::vector<Thread> threads(n);
+      std::vector<Worker> workers(n);
+      
+      for (int w=0; w<n; ++w)
+      {
+         workers[w].pool = this;
+         workers[w].index = w;
+         if (!threads[w].start(&WorkStealingPool::Entry, &workers[w]))
+         {
+            // run on the calling thread, others will steal its tasks
+            Entry(&workers[w]);
+         }
+      }
+      
+      for (int w=0; w<n; ++w)
+      {
+         threads[w].join();
+      }
+   }
+
+private:
+
+   // [begin, end) task indices
+   struct Queue
+   {
+      SpinLock lock;
+      int begin;
+      int end;
+      
+      Queue()
+         : begin(0), end(0)
+      {
+      }
+      
+      Queue(const Queue&)
+         : begin(0), end(0)
+      {
+      }
+      
+      Queue& operator=(const Queue&)
+      {
+         return *this;
+      }
+   };
+   
+   struct Worker
+   {
+      WorkStealingPool *pool;
+      int index;
+   };
+   
+   static void Entry(void *arg)
+   {
+      Worker *worker = (Worker*) arg;
+      worker->pool->work(worker->index);
+   }
+   
+   void work(int w)
+   {
+      int n = workers();
+      
+      for (;;)
+      {
+         int index = -1;
+         
+         {
+            ScopedSpinLock guard(_queues[w].lock);
+            if (_queues[w].end > _queues[w].begin)
+            {
+               index = --_queues[w].end;
+            }
+         }
+         
+         for (int i=1; index < 0 && i<n; ++i)
+         {
+            Queue &victim = _queues[(w + i) % n];
+            ScopedSpinLock guard(victim.lock);
+            if (victim.end > victim.begin)
+            {
+               index = victim.begin++;
+            }
+         }
+         
+         if (index < 0)
+         {
+            return;
+         }
+         
+         _task->run(index, w);
+      }
+   }
+   
+   std::vector<Queue> _queues;
+   Task *_task;
+};
+
+// Node parameters
+
+enum ParamType
+{
+   PT_float = 0,
+   PT_int,
+   PT_bool,
+   PT_enum
+};
+
+struct Param
+{
+   const char *name;
+   ParamType type;
+   void *value;
+   // PT_enum labels, NULL terminated
+   const char **labels;
+};
+
+static const char *NoiseTypeLabels[] = {"value", "perlin", "simplex", "flow", "simplex4d", NULL};
+static const char *NoiseQualityLabels[] = {"fast", "standard", "best", NULL};
+static const char *NoiseHashLabels[] = {"legacy", "xxhash", NULL};
+static const char *DistanceFuncLabels[] = {"euclidian", "manhattan", "chebyshev", NULL};
+static const char *OutputModeLabels[] = {"constant", "f1", "f2", "f3", "f4", "f1+f2", "f2-f1", "f1*f2", "weighted", NULL};
+
+inline Param MakeParam(const char *name, float &value)
+{
+   Param p = {name, PT_float, &value, NULL};
+   return p;
+}
+
+inline Param MakeParam(const char *name, int &value)
+{
+   Param p = {name, PT_int, &value, NULL};
+   return p;
+}
+
+inline Param MakeParam(const char *name, bool &value)
+{
+   Param p = {name, PT_bool, &value, NULL};
+   return p;
+}
+
+// value must be an enum
+template <typename T>
+inline Param MakeEnumParam(const char *name, T &value, const char **labels)
+{
+   Param p = {name, PT_enum, &value, labels};
+   return p;
+}
+
+bool SetParam(const std::vector<Param> &params, const char *name, const char *str)
+{
+   for (size_t i=0; i<params.size(); ++i)
+   {
+      const Param &p = params[i];
+      
+      if (strcmp(p.name, name))
+      {
+         continue;
+      }
+      
+      char *end = 0;
+      
+      switch (p.type)
+      {
+      case PT_float:
+         *((float*) p.value) = float(strtod(str, &end));
+         return (end != str && *end == '\0');
+      case PT_int:
+         *((int*) p.value) = int(strtol(str, &end, 10));
+         return (end != str && *end == '\0');
+      case PT_bool:
+         if (!strcmp(str, "true") || !strcmp(str, "on") || !strcmp(str, "1"))
+         {
+            *((bool*) p.value) = true;
+            return true;
+         }
+         if (!strcmp(str, "false") || !strcmp(str, "off") || !strcmp(str, "0"))
+         {
+            *((bool*) p.value) = false;
+            return true;
+         }
+         return false;
+      case PT_enum:
+         for (int j=0; p.labels[j] != NULL; ++j)
+         {
+            if (!strcmp(p.labels[j], str))
+            {
+               *((int*) p.value) = j;
+               return true;
+            }
+         }
+         return false;
+      default:
+         return false;
+      }
+   }
+   
+   return false;
+}
+
+// Baked nodes
+
+class Source
+{
+public:
+
+   virtual ~Source()
+   {
+   }
+   
+   virtual bool setup(int workers, float filterWidth) = 0;
+   
+   virtual int channels() const = 0;
+   
+   // EXR channel names, in output order
+   virtual const char* channelName(int c) const = 0;
+   
+   // channels() values per point, interleaved
+   virtual void eval(int worker, size_t n, const float *x, const float *y, const float *z, float *out) = 0;
+   
+   const std::vector<Param>& params() const
+   {
+      return _params;
+   }
+
+protected:
+
+   std::vector<Param> _params;
+};
+
+// Permutation table for a simplex or flow noise seed, 0 for the reference one
+inline const PermutationTable* AcquireNoisePermutation(NoiseType type, int simplexSeed, int flowSeed)
+{
+   int seed = ((type == NT_simplex || type == NT_simplex4d) ? simplexSeed : (type == NT_flow ? flowSeed : 0));
+   return (seed != 0 ? AcquirePermutationTable(seed) : 0);
+}
+
+class FractalSource : public Source
+{
+public:
+
+   // fractal shader defaults
+   FractalSource()
+      : _type(NT_simplex)
+      , _simplexSeed(0)
+      , _flowSeed(0)
+      , _autoOctaves(false)
+      , _autoOctavesScale(1.0f)
+      , _filterWidth(0.0f)
+      , _evaluator(0)
+   {
+      FractalValues &v = _values;
+      v.amplitude = 1.0f;
+      v.frequency = 1.0f;
+      v.octaves = 6.0f;
+      v.persistence = 0.5f;
+      v.lacunarity = 2.0f;
+      v.amplitude_threshold = 0.0f;
+      v.value_seed = 0;
+      v.value_quality = NQ_std;
+      v.perlin_seed = 0;
+      v.perlin_quality = NQ_std;
+      v.lattice_hash = NH_legacy;
+      v.flow_power = 0.25f;
+      v.flow_time = 0.0f;
+      v.time = 0.0f;
+      v.permutation = 0;
+      v.turbulent = false;
+      v.turbulence_offset = -0.5f;
+      v.turbulence_scale = 2.0f;
+      v.ridged = false;
+      v.ridge_offset = 1.0f;
+      v.ridge_gain = 2.0f;
+      v.ridge_exponent = 0.0f;
+      v.dampen_output = true;
+      v.remap_output = true;
+      v.fractal_min = -1.0f;
+      v.fractal_max = 1.0f;
+      v.output_min = 0.0f;
+      v.output_max = 1.0f;
+      v.clamp_output = true;
+      
+      _params.push_back(MakeParam("amplitude", v.amplitude));
+      _params.push_back(MakeParam("frequency", v.frequency));
+      _params.push_back(MakeParam("octaves", v.octaves));
+      _params.push_back(MakeParam("persistence", v.persistence));
+      _params.push_back(MakeParam("lacunarity", v.lacunarity));
+      _params.push_back(MakeEnumParam("base_noise", _type, NoiseTypeLabels));
+      _params.push_back(MakeParam("value_seed", v.value_seed));
+      _params.push_back(MakeEnumParam("value_quality", v.value_quality, NoiseQualityLabels));
+      _params.push_back(MakeParam("perlin_seed", v.perlin_seed));
+      _params.push_back(MakeEnumParam("perlin_quality", v.perlin_quality, NoiseQualityLabels));
+      _params.push_back(MakeEnumParam("lattice_hash", v.lattice_hash, NoiseHashLabels));
+      _params.push_back(MakeParam("simplex_seed", _simplexSeed));
+      _params.push_back(MakeParam("flow_seed", _flowSeed));
+      _params.push_back(MakeParam("flow_power", v.flow_power));
+      _params.push_back(MakeParam("flow_time", v.flow_time));
+      _params.push_back(MakeParam("time", v.time));
+      _params.push_back(MakeParam("turbulent", v.turbulent));
+      _params.push_back(MakeParam("turbulence_offset", v.turbulence_offset));
+      _params.push_back(MakeParam("turbulence_scale", v.turbulence_scale));
+      _params.push_back(MakeParam("ridged", v.ridged));
+      _params.push_back(MakeParam("ridge_offset", v.ridge_offset));
+      _params.push_back(MakeParam("ridge_gain", v.ridge_gain));
+      _params.push_back(MakeParam("ridge_exponent", v.ridge_exponent));
+      _params.push_back(MakeParam("dampen_output", v.dampen_output));
+      _params.push_back(MakeParam("remap_output", v.remap_output));
+      _params.push_back(MakeParam("fractal_min", v.fractal_min));
+      _params.push_back(MakeParam("fractal_max", v.fractal_max));
+      _params.push_back(MakeParam("output_min", v.output_min));
+      _params.push_back(MakeParam("output_max", v.output_max));
+      _params.push_back(MakeParam("clamp_output", v.clamp_output));
+      _params.push_back(MakeParam("auto_octaves", _autoOctaves));
+      _params.push_back(MakeParam("auto_octaves_scale", _autoOctavesScale));
+      _params.push_back(MakeParam("amplitude_threshold", v.amplitude_threshold));
+   }
+   
+   virtual ~FractalSource()
+   {
+      delete _evaluator;
+      ReleasePermutationTable(_values.permutation);
+   }
+   
+   virtual bool setup(int, float filterWidth)
+   {
+      _values.permutation = AcquireNoisePermutation(_type, _simplexSeed, _flowSeed);
+      _filterWidth = (_autoOctaves ? _autoOctavesScale * filterWidth : 0.0f);
+      _evaluator = CreateEvaluator(_type, ModifierIndex(_values.turbulent, _values.ridged));
+      _evaluator->setup(_values);
+      return true;
+   }
+   
+   virtual int channels() const
+   {
+      return 1;
+   }
+   
+   virtual const char* channelName(int) const
+   {
+      return "Y";
+   }
+   
+   virtual void eval(int, size_t n, const float *x, const float *y, const float *z, float *out)
+   {
+      EvalFractalBatch(*_evaluator, _values, n, x, y, z, out, _filterWidth);
+   }
+
+private:
+
+   FractalValues _values;
+   NoiseType _type;
+   int _simplexSeed;
+   int _flowSeed;
+   bool _autoOctaves;
+   float _autoOctavesScale;
+   float _filterWidth;
+   FractalEvaluator *_evaluator;
+};
+
+class VoronoiSource : public Source
+{
+public:
+
+   // voronoi shader defaults
+   VoronoiSource()
+   {
+      _values.displacement = 0.5f;
+      _values.frequency = 1.0f;
+      _values.seed = 0;
+      _values.distance_func = DF_euclidian;
+      _values.output_mode = OM_constant;
+      _values.weights[0] = -1.0f;
+      _values.weights[1] = 1.0f;
+      _values.weights[2] = 0.0f;
+      _values.weights[3] = 0.0f;
+      
+      _params.push_back(MakeParam("displacement", _values.displacement));
+      _params.push_back(MakeParam("frequency", _values.frequency));
+      _params.push_back(MakeEnumParam("distance_func", _values.distance_func, DistanceFuncLabels));
+      _params.push_back(MakeEnumParam("output_mode", _values.output_mode, OutputModeLabels));
+      _params.push_back(MakeParam("weight1", _values.weights[0]));
+      _params.push_back(MakeParam("weight2", _values.weights[1]));
+      _params.push_back(MakeParam("weight3", _values.weights[2]));
+      _params.push_back(MakeParam("weight4", _values.weights[3]));
+      _params.push_back(MakeParam("seed", _values.seed));
+   }
+   
+   virtual ~VoronoiSource()
+   {
+      for (size_t i=0; i<_caches.size(); ++i)
+      {
+         delete _caches[i];
+      }
+   }
+   
+   virtual bool setup(int workers, float)
+   {
+      // one feature point cache per worker, as per shading thread
+      _caches.resize(workers, 0);
+      for (int i=0; i<workers; ++i)
+      {
+         _caches[i] = new FeatureCache();
+      }
+      return true;
+   }
+   
+   virtual int channels() const
+   {
+      return 1;
+   }
+   
+   virtual const char* channelName(int) const
+   {
+      return "Y";
+   }
+   
+   virtual void eval(int worker, size_t n, const float *x, const float *y, const float *z, float *out)
+   {
+      EvalVoronoiBatch(*(_caches[worker]), _values, n, x, y, z, out);
+   }
+
+private:
+
+   VoronoiValues _values;
+   std::vector<FeatureCache*> _caches;
+};
+
+class DistortPointSource : public Source
+{
+public:
+
+   // distort_point shader defaults
+   DistortPointSource()
+      : _type(NT_simplex)
+      , _simplexSeed(0)
+      , _flowSeed(0)
+      , _autoOctaves(false)
+      , _autoOctavesScale(1.0f)
+   {
+      _values.frequency = 1.0f;
+      _values.power = 1.0f;
+      _values.roughness = 3;
+      _values.filter_width = 0.0f;
+      _values.value_seed = 0;
+      _values.perlin_seed = 0;
+      _values.lattice_hash = NH_legacy;
+      _values.flow_power = 0.25f;
+      _values.flow_time = 0.0f;
+      _values.time = 0.0f;
+      _values.permutation = 0;
+      
+      _params.push_back(MakeParam("frequency", _values.frequency));
+      _params.push_back(MakeParam("power", _values.power));
+      _params.push_back(MakeParam("roughness", _values.roughness));
+      _params.push_back(MakeEnumParam("base_noise", _type, NoiseTypeLabels));
+      _params.push_back(MakeParam("value_seed", _values.value_seed));
+      _params.push_back(MakeParam("perlin_seed", _values.perlin_seed));
+      _params.push_back(MakeEnumParam("lattice_hash", _values.lattice_hash, NoiseHashLabels));
+      _params.push_back(MakeParam("simplex_seed", _simplexSeed));
+      _params.push_back(MakeParam("flow_seed", _flowSeed));
+      _params.push_back(MakeParam("flow_power", _values.flow_power));
+      _params.push_back(MakeParam("flow_time", _values.flow_time));
+      _params.push_back(MakeParam("time", _values.time));
+      _params.push_back(MakeParam("auto_octaves", _autoOctaves));
+      _params.push_back(MakeParam("auto_octaves_scale", _autoOctavesScale));
+   }
+   
+   virtual ~DistortPointSource()
+   {
+      ReleasePermutationTable(_values.permutation);
+   }
+   
+   virtual bool setup(int, float filterWidth)
+   {
+      _values.permutation = AcquireNoisePermutation(_type, _simplexSeed, _flowSeed);
+      _values.filter_width = (_autoOctaves ? _autoOctavesScale * filterWidth : 0.0f);
+      return true;
+   }
+   
+   virtual int channels() const
+   {
+      return 3;
+   }
+   
+   virtual const char* channelName(int c) const
+   {
+      static const char *Names[] = {"R", "G", "B"};
+      return Names[c];
+   }
+   
+   virtual void eval(int, size_t n, const float *x, const float *y, const float *z, float *out)
+   {
+      float dx[NOISE_BATCH_TILE_SIZE];
+      float dy[NOISE_BATCH_TILE_SIZE];
+      float dz[NOISE_BATCH_TILE_SIZE];
+      
+      for (size_t start=0; start<n; start+=NOISE_BATCH_TILE_SIZE)
+      {
+         size_t count = std::min<size_t>(n - start, NOISE_BATCH_TILE_SIZE);
+         
+         EvalDistortPointBatch(_type, _values, count, x + start, y + start, z + start, dx, dy, dz);
+         
+         for (size_t i=0; i<count; ++i, out+=3)
+         {
+            out[0] = dx[i];
+            out[1] = dy[i];
+            out[2] = dz[i];
+         }
+      }
+   }
+
+private:
+
+   DistortPointValues _values;
+   NoiseType _type;
+   int _simplexSeed;
+   int _flowSeed;
+   bool _autoOctaves;
+   float _autoOctavesScale;
+};
+
+// Output
+
+// Level l of a mip chain, sizes rounded down
+inline int LevelSize(int size, int level)
+{
+   return std::max(1, size >> level);
+}
+
+inline int NumLevels(int width, int height)
+{
+   int n = 1;
+   while ((std::max(width, height) >> n) > 0)
+   {
+      ++n;
+   }
+   return n;
+}
+
+class ImageWriter
+{
+public:
+
+   virtual ~ImageWriter()
+   {
+   }
+   
+   // rows full rows of the level, starting at row y, channels interleaved
+   virtual bool write(int level, int y, int rows, const float *data) = 0;
+   
+   virtual bool close() = 0;
+};
+
+// Little-endian encoding
+class ByteBuffer
+{
+public:
+
+   void u8(unsigned char v)
+   {
+      _data.push_back(v);
+   }
+   
+   void u32(uint32_t v)
+   {
+      for (int i=0; i<4; ++i)
+      {
+         _data.push_back((unsigned char) ((v >> (8 * i)) & 0xff));
+      }
+   }
+   
+   void u64(uint64_t v)
+   {
+      for (int i=0; i<8; ++i)
+      {
+         _data.push_back((unsigned char) ((v >> (8 * i)) & 0xff));
+      }
+   }
+   
+   void i32(int v)
+   {
+      u32((uint32_t) v);
+   }
+   
+   void f32(float v)
+   {
+      uint32_t bits;
+      memcpy(&bits, &v, sizeof(float));
+      u32(bits);
+   }
+   
+   void str(const char *s)
+   {
+      _data.insert(_data.end(), s, s + strlen(s) + 1);
+   }
+   
+   void append(const ByteBuffer &other)
+   {
+      _data.insert(_data.end(), other._data.begin(), other._data.end());
+   }
+   
+   size_t size() const
+   {
+      return _data.size();
+   }
+   
+   void clear()
+   {
+      _data.clear();
+   }
+   
+   bool write(FILE *f) const
+   {
+      return (_data.empty() || fwrite(&_data[0], 1, _data.size(), f) == _data.size());
+   }
+
+private:
+
+   std::vector<unsigned char> _data;
+};
+
+// One file per mip level, rows are written in order
+class RawWriter : public ImageWriter
+{
+public:
+
+   RawWriter(int channels)
+      : _channels(channels)
+   {
+   }
+   
+   virtual ~RawWriter()
+   {
+      close();
+   }
+   
+   bool open(const std::string &path, int width, int levels)
+   {
+      size_t dot = path.rfind('.');
+      size_t slash = path.find_last_of("/\\");
+      if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+      {
+         dot = path.length();
+      }
+      
+      for (int l=0; l<levels; ++l)
+      {
+         std::string lpath = path;
+         if (l > 0)
+         {
+            char suffix[32];
+            sprintf(suffix, ".%d", l);
+            lpath = path.substr(0, dot) + suffix + path.substr(dot);
+         }
+         FILE *f = fopen(lpath.c_str(), "wb");
+         if (!f)
+         {
+            fprintf(stderr, "Could not open '%s' for writing\n", lpath.c_str());
+            return false;
+         }
+         _files.push_back(f);
+         _widths.push_back(LevelSize(width, l));
+      }
+      
+      return true;
+   }
+   
+   virtual bool write(int level, int, int rows, const float *data)
+   {
+      ByteBuffer buffer;
+      size_t count = size_t(rows) * _widths[level] * _channels;
+      
+      for (size_t i=0; i<count; ++i)
+      {
+         buffer.f32(data[i]);
+      }
+      
+      return buffer.write(_files[level]);
+   }
+   
+   virtual bool close()
+   {
+      bool ok = true;
+      for (size_t i=0; i<_files.size(); ++i)
+      {
+         ok = (fclose(_files[i]) == 0) && ok;
+      }
+      _files.clear();
+      return ok;
+   }
+
+private:
+
+   int _channels;
+   std::vector<FILE*> _files;
+   std::vector<int> _widths;
+};
+
+// Single part tiled OpenEXR, uncompressed FLOAT channels.
+//
+// Tiles are written as their row completes, in any level order (RANDOM_Y
+// line order), the offset table is filled when closing.
+class EXRWriter : public ImageWriter
+{
+public:
+
+   EXRWriter(const Source &source)
+      : _source(source)
+      , _file(0)
+      , _pos(0)
+      , _tableStart(0)
+   {
+   }
+   
+   virtual ~EXRWriter()
+   {
+      close();
+   }
+   
+   bool open(const std::string &path, int width, int height, int tileSize, bool mipmap)
+   {
+      _width = width;
+      _height = height;
+      _tileSize = tileSize;
+      _levels = (mipmap ? NumLevels(width, height) : 1);
+      
+      _file = fopen(path.c_str(), "wb");
+      if (!_file)
+      {
+         fprintf(stderr, "Could not open '%s' for writing\n", path.c_str());
+         return false;
+      }
+      
+      int channels = _source.channels();
+      // channels are stored sorted by name
+      _order.resize(channels);
+      for (int c=0; c<channels; ++c)
+      {
+         _order[c] = c;
+      }
+      for (int i=1; i<channels; ++i)
+      {
+         for (int j=i; j>0 && strcmp(_source.channelName(_order[j]), _source.channelName(_order[j-1])) < 0; --j)
+         {
+            std::swap(_order[j], _order[j-1]);
+         }
+      }
+      
+      ByteBuffer header;
+      ByteBuffer value;
+      
+      header.u32(20000630);
+      // version 2, single part tiled
+      header.u32(2 | 0x200);
+      
+      for (int c=0; c<channels; ++c)
+      {
+         value.str(_source.channelName(_order[c]));
+         // FLOAT
+         value.i32(2);
+         // pLinear and reserved
+         value.u32(0);
+         value.i32(1);
+         value.i32(1);
+      }
+      value.u8(0);
+      attribute(header, "channels", "chlist", value);
+      
+      // NO_COMPRESSION
+      value.u8(0);
+      attribute(header, "compression", "compression", value);
+      
+      value.i32(0);
+      value.i32(0);
+      value.i32(width - 1);
+      value.i32(height - 1);
+      attribute(header, "dataWindow", "box2i", value);
+      
+      value.i32(0);
+      value.i32(0);
+      value.i32(width - 1);
+      value.i32(height - 1);
+      attribute(header, "displayWindow", "box2i", value);
+      
+      // RANDOM_Y
+      value.u8(2);
+      attribute(header, "lineOrder", "lineOrder", value);
+      
+      value.f32(1.0f);
+      attribute(header, "pixelAspectRatio", "float", value);
+      
+      value.f32(0.0f);
+      value.f32(0.0f);
+      attribute(header, "screenWindowCenter", "v2f", value);
+      
+      value.f32(1.0f);
+      attribute(header, "screenWindowWidth", "float", value);
+      
+      value.u32(tileSize);
+      value.u32(tileSize);
+      // ONE_LEVEL or MIPMAP_LEVELS, ROUND_DOWN
+      value.u8(mipmap ? 1 : 0);
+      attribute(header, "tiles", "tiledesc", value);
+      
+      header.u8(0);
+      
+      _tableStart = header.size();
+      
+      size_t tiles = 0;
+      for (int l=0; l<_levels; ++l)
+      {
+         _levelFirstTile.push_back(tiles);
+         tiles += size_t(tilesX(l)) * tilesY(l);
+      }
+      _offsets.assign(tiles, 0);
+      
+      // placeholder table
+      for (size_t i=0; i<tiles; ++i)
+      {
+         header.u64(0);
+      }
+      
+      _pos = header.size();
+      
+      return header.write(_file);
+   }
+   
+   virtual bool write(int level, int y, int rows, const float *data)
+   {
+      int width = LevelSize(_width, level);
+      int channels = _source.channels();
+      int ty = y / _tileSize;
+      ByteBuffer chunk;
+      
+      for (int tx=0; tx<tilesX(level); ++tx)
+      {
+         int x0 = tx * _tileSize;
+         int tw = std::min(_tileSize, width - x0);
+         
+         chunk.clear();
+         chunk.i32(tx);
+         chunk.i32(ty);
+         chunk.i32(level);
+         chunk.i32(level);
+         chunk.i32(tw * rows * channels * 4);
+         
+         for (int r=0; r<rows; ++r)
+         {
+            const float *row = data + (size_t(r) * width + x0) * channels;
+            
+            for (int c=0; c<channels; ++c)
+            {
+               for (int x=0; x<tw; ++x)
+               {
+                  chunk.f32(row[x * channels + _order[c]]);
+               }
+            }
+         }
+         
+         _offsets[_levelFirstTile[level] + size_t(ty) * tilesX(level) + tx] = _pos;
+         
+         if (!chunk.write(_file))
+         {
+            return false;
+         }
+         
+         _pos += chunk.size();
+      }
+      
+      return true;
+   }
+   
+   virtual bool close()
+   {
+      if (!_file)
+      {
+         return true;
+      }
+      
+      ByteBuffer table;
+      for (size_t i=0; i<_offsets.size(); ++i)
+      {
+         table.u64(_offsets[i]);
+      }
+      
+      bool ok = (fseek(_file, long(_tableStart), SEEK_SET) == 0 && table.write(_file));
+      ok = (fclose(_file) == 0) && ok;
+      _file = 0;
+      
+      return ok;
+   }
+
+private:
+
+   static void attribute(ByteBuffer &header, const char *name, const char *type, ByteBuffer &value)
+   {
+      header.str(name);
+      header.str(type);
+      header.i32(int(value.size()));
+      header.append(value);
+      value.clear();
+   }
+   
+   int tilesX(int level) const
+   {
+      return (LevelSize(_width, level) + _tileSize - 1) / _tileSize;
+   }
+   
+   int tilesY(int level) const
+   {
+      return (LevelSize(_height, level) + _tileSize - 1) / _tileSize;
+   }
+   
+   const Source &_source;
+   FILE *_file;
+   int _width;
+   int _height;
+   int _tileSize;
+   int _levels;
+   std::vector<int> _order;
+   std::vector<size_t> _levelFirstTile;
+   std::vector<uint64_t> _offsets;
+   uint64_t _pos;
+   size_t _tableStart;
+};
+
+// Baking
+
+struct Options
+{
+   std::string node;
+   std::string output;
+   std::string format;
+   int width;
+   int height;
+   int depth;
+   // P = origin + u * U + v * V + w * W, u, v and w in [0, 1]
+   Vec3 origin;
+   Vec3 U;
+   Vec3 V;
+   Vec3 W;
+   int tileSize;
+   bool mipmap;
+   int threads;
+   
+   Options()
+      : width(1024), height(1024), depth(1)
+      , origin(0.0f, 0.0f, 0.0f), U(1.0f, 0.0f, 0.0f), V(0.0f, 1.0f, 0.0f), W(0.0f, 0.0f, 0.0f)
+      , tileSize(64), mipmap(false), threads(0)
+   {
+   }
+};
+
+// Evaluates the tiles of one row of tiles of level 0 into a strip
+class TileRowTask : public Task
+{
+public:
+
+   TileRowTask(const Options &opts, Source &source, int workers)
+      : _opts(opts)
+      , _source(source)
+      , _channels(source.channels())
+      , _x(workers * opts.tileSize)
+      , _y(workers * opts.tileSize)
+      , _z(workers * opts.tileSize)
+   {
+   }
+   
+   void bind(float *strip, int y0, int rows, float w)
+   {
+      _strip = strip;
+      _y0 = y0;
+      _rows = rows;
+      _w = w;
+   }
+   
+   virtual void run(int tx, int worker)
+   {
+      int T = _opts.tileSize;
+      int x0 = tx * T;
+      int tw = std::min(T, _opts.width - x0);
+      float *px = &_x[worker * T];
+      float *py = &_y[worker * T];
+      float *pz = &_z[worker * T];
+      
+      for (int r=0; r<_rows; ++r)
+      {
+         float v = 1.0f - (float(_y0 + r) + 0.5f) / float(_opts.height);
+         Vec3 Prow = _opts.origin + v * _opts.V + _w * _opts.W;
+         
+         for (int x=0; x<tw; ++x)
+         {
+            float u = (float(x0 + x) + 0.5f) / float(_opts.width);
+            Vec3 P = Prow + u * _opts.U;
+            px[x] = P.x;
+            py[x] = P.y;
+            pz[x] = P.z;
+         }
+         
+         _source.eval(worker, tw, px, py, pz, _strip + (size_t(r) * _opts.width + x0) * _channels);
+      }
+   }
+
+private:
+
+   const Options &_opts;
+   Source &_source;
+   int _channels;
+   std::vector<float> _x;
+   std::vector<float> _y;
+   std::vector<float> _z;
+   float *_strip;
+   int _y0;
+   int _rows;
+   float _w;
+};
+
+// One row of tiles per level: rows are written when their row of tiles is
+// complete, then averaged 2x2 into the next level's strip
+class MipChain
+{
+public:
+
+   MipChain(ImageWriter &writer, int width, int height, int channels, int tileSize, int levels)
+      : _writer(writer)
+      , _channels(channels)
+      , _tileSize(tileSize)
+      , _levels(levels)
+   {
+      for (int l=0; l<levels; ++l)
+      {
+         Level level;
+         level.width = LevelSize(width, l);
+         level.height = LevelSize(height, l);
+         level.strip.resize(size_t(level.width) * tileSize * channels);
+         _strips.push_back(level);
+      }
+   }
+   
+   float* strip()
+   {
+      return &_strips[0].strip[0];
+   }
+   
+   // rows of level 0 starting at y are in strip()
+   bool flush(int y, int rows)
+   {
+      return flush(0, y, rows);
+   }
+   
+   size_t bytes() const
+   {
+      size_t total = 0;
+      for (size_t l=0; l<_strips.size(); ++l)
+      {
+         total += _strips[l].strip.size() * sizeof(float);
+      }
+      return total;
+   }
+
+private:
+
+   struct Level
+   {
+      int width;
+      int height;
+      std::vector<float> strip;
+   };
+   
+   bool flush(int l, int y, int rows)
+   {
+      const Level &src = _strips[l];
+      
+      if (!_writer.write(l, y, rows, &src.strip[0]))
+      {
+         return false;
+      }
+      
+      if (l + 1 >= _levels)
+      {
+         return true;
+      }
+      
+      Level &dst = _strips[l + 1];
+      int T = _tileSize;
+      
+      // level l + 1 rows whose top source row is in this strip
+      for (int dy=(y + 1) / 2; 2 * dy < y + rows && dy < dst.height; ++dy)
+      {
+         const float *r0 = &src.strip[size_t(2 * dy - y) * src.width * _channels];
+         const float *r1 = &src.strip[size_t(std::min(2 * dy + 1, src.height - 1) - y) * src.width * _channels];
+         float *out = &dst.strip[size_t(dy % T) * dst.width * _channels];
+         
+         for (int dx=0; dx<dst.width; ++dx)
+         {
+            int x0 = 2 * dx * _channels;
+            int x1 = std::min(2 * dx + 1, src.width - 1) * _channels;
+            
+            for (int c=0; c<_channels; ++c)
+            {
+               *out++ = 0.25f * (r0[x0 + c] + r0[x1 + c] + r1[x0 + c] + r1[x1 + c]);
+            }
+         }
+         
+         if (dy % T == T - 1 || dy == dst.height - 1)
+         {
+            int first = dy - (dy % T);
+            if (!flush(l + 1, first, dy - first + 1))
+            {
+               return false;
+            }
+         }
+      }
+      
+      return true;
+   }
+   
+   ImageWriter &_writer;
+   int _channels;
+   int _tileSize;
+   int _levels;
+   std::vector<Level> _strips;
+};
+
+// Bakes all slices, returns false on write errors
+bool Bake(const Options &opts, Source &source, ImageWriter &writer, WorkStealingPool &pool)
+{
+   int T = opts.tileSize;
+   int levels = (opts.mipmap ? NumLevels(opts.width, opts.height) : 1);
+   int tilesX = (opts.width + T - 1) / T;
+   int tilesY = (opts.height + T - 1) / T;
+   
+   MipChain chain(writer, opts.width, opts.height, source.channels(), T, levels);
+   TileRowTask task(opts, source, pool.workers());
+   
+   fprintf(stderr, "%d x %d x %d, %d level(s), %d worker(s), %.2f MB of strips\n",
+           opts.width, opts.height, opts.depth, levels, pool.workers(), double(chain.bytes()) / (1024.0 * 1024.0));
+   
+   for (int z=0; z<opts.depth; ++z)
+   {
+      float w = (float(z) + 0.5f) / float(opts.depth);
+      
+      for (int ty=0; ty<tilesY; ++ty)
+      {
+         int y0 = ty * T;
+         int rows = std::min(T, opts.height - y0);
+         
+         task.bind(chain.strip(), y0, rows, w);
+         pool.run(task, tilesX);
+         
+         if (!chain.flush(y0, rows))
+         {
+            return false;
+         }
+      }
+      
+      if (opts.depth > 1)
+      {
+         fprintf(stderr, "slice %d/%d\n", z + 1, opts.depth);
+      }
+   }
+   
+   return true;
+}
+
+void Usage()
+{
+   fprintf(stderr, "Usage: noisebake -node <fractal|voronoi|distort_point> -output <path> [-res w h] [-uv | -plane o U V | -box min max] [-depth d]\n"
+                   "                 [-set name value]... [-tile n] [-mipmap] [-threads n] [-format exr|raw]\n");
+}
+
+bool ParseFloats(int argc, char **argv, int &i, int count, float *out)
+{
+   if (i + count >= argc)
+   {
+      return false;
+   }
+   for (int j=0; j<count; ++j)
+   {
+      char *end = 0;
+      const char *str = argv[++i];
+      out[j] = float(strtod(str, &end));
+      if (end == str || *end != '\0')
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+int main(int argc, char **argv)
+{
+   Options opts;
+   std::vector<std::pair<std::string, std::string> > sets;
+   
+   for (int i=1; i<argc; ++i)
+   {
+      bool hasValue = (i + 1 < argc);
+      float f[9];
+      
+      if (!strcmp(argv[i], "-node") && hasValue)
+      {
+         opts.node = argv[++i];
+      }
+      else if (!strcmp(argv[i], "-output") && hasValue)
+      {
+         opts.output = argv[++i];
+      }
+      else if (!strcmp(argv[i], "-format") && hasValue)
+      {
+         opts.format = argv[++i];
+      }
+      else if (!strcmp(argv[i], "-res") && i + 2 < argc)
+      {
+         opts.width = atoi(argv[++i]);
+         opts.height = atoi(argv[++i]);
+      }
+      else if (!strcmp(argv[i], "-depth") && hasValue)
+      {
+         opts.depth = atoi(argv[++i]);
+      }
+      else if (!strcmp(argv[i], "-uv"))
+      {
+         opts.origin = Vec3(0.0f, 0.0f, 0.0f);
+         opts.U = Vec3(1.0f, 0.0f, 0.0f);
+         opts.V = Vec3(0.0f, 1.0f, 0.0f);
+         opts.W = Vec3(0.0f, 0.0f, 0.0f);
+      }
+      else if (!strcmp(argv[i], "-plane") && ParseFloats(argc, argv, i, 9, f))
+      {
+         opts.origin = Vec3(f[0], f[1], f[2]);
+         opts.U = Vec3(f[3], f[4], f[5]);
+         opts.V = Vec3(f[6], f[7], f[8]);
+         opts.W = Vec3(0.0f, 0.0f, 0.0f);
+      }
+      else if (!strcmp(argv[i], "-box") && ParseFloats(argc, argv, i, 6, f))
+      {
+         opts.origin = Vec3(f[0], f[1], f[2]);
+         opts.U = Vec3(f[3] - f[0], 0.0f, 0.0f);
+         opts.V = Vec3(0.0f, f[4] - f[1], 0.0f);
+         opts.W = Vec3(0.0f, 0.0f, f[5] - f[2]);
+      }
+      else if (!strcmp(argv[i], "-set") && i + 2 < argc)
+      {
+         sets.push_back(std::make_pair(std::string(argv[i+1]), std::string(argv[i+2])));
+         i += 2;
+      }
+      else if (!strcmp(argv[i], "-tile") && hasValue)
+      {
+         opts.tileSize = atoi(argv[++i]);
+      }
+      else if (!strcmp(argv[i], "-mipmap"))
+      {
+         opts.mipmap = true;
+      }
+      else if (!strcmp(argv[i], "-threads") && hasValue)
+      {
+         opts.threads = atoi(argv[++i]);
+      }
+      else
+      {
+         Usage();
+         return 1;
+      }
+   }
+   
+   if (opts.format.length() == 0)
+   {
+      size_t n = opts.output.length();
+      opts.format = (n > 4 && opts.output.substr(n - 4) == ".raw" ? "raw" : "exr");
+   }
+   
+   if (opts.output.length() == 0 || opts.width <= 0 || opts.height <= 0 || opts.depth <= 0 ||
+       opts.tileSize < 2 || (opts.tileSize & (opts.tileSize - 1)) != 0 ||
+       (opts.format != "exr" && opts.format != "raw"))
+   {
+      Usage();
+      return 1;
+   }
+   
+   if (opts.depth > 1 && (opts.format != "raw" || opts.mipmap))
+   {
+      fprintf(stderr, "Multiple slices can only be written as raw, without mip levels\n");
+      return 1;
+   }
+   
+   Source *source = 0;
+   
+   if (opts.node == "fractal")
+   {
+      source = new FractalSource();
+   }
+   else if (opts.node == "voronoi")
+   {
+      source = new VoronoiSource();
+   }
+   else if (opts.node == "distort_point")
+   {
+      source = new DistortPointSource();
+   }
+   else
+   {
+      Usage();
+      return 1;
+   }
+   
+   for (size_t i=0; i<sets.size(); ++i)
+   {
+      if (!SetParam(source->params(), sets[i].first.c_str(), sets[i].second.c_str()))
+      {
+         fprintf(stderr, "Invalid %s parameter '%s' or value '%s'\n", opts.node.c_str(), sets[i].first.c_str(), sets[i].second.c_str());
+         delete source;
+         return 1;
+      }
+   }
+   
+   WorkStealingPool pool(opts.threads > 0 ? opts.threads : Thread::HardwareConcurrency());
+   
+   // pixel footprint, for auto_octaves
+   float filterWidth = std::max(Length(opts.U) / float(opts.width), Length(opts.V) / float(opts.height));
+   if (opts.depth > 1)
+   {
+      filterWidth = std::max(filterWidth, Length(opts.W) / float(opts.depth));
+   }
+   
+   source->setup(pool.workers(), filterWidth);
+   
+   ImageWriter *writer = 0;
+   bool ok = false;
+   
+   if (opts.format == "raw")
+   {
+      RawWriter *raw = new RawWriter(source->channels());
+      writer = raw;
+      ok = raw->open(opts.output, opts.width, (opts.mipmap ? NumLevels(opts.width, opts.height) : 1));
+   }
+   else
+   {
+      EXRWriter *exr = new EXRWriter(*source);
+      writer = exr;
+      ok = exr->open(opts.output, opts.width, opts.height, opts.tileSize, opts.mipmap);
+   }
+   
+   double start = Now();
+   
+   ok = ok && Bake(opts, *source, *writer, pool);
+   ok = writer->close() && ok;
+   
+   if (ok)
+   {
+      double elapsed = Now() - start;
+      double pixels = double(opts.width) * opts.height * opts.depth;
+      fprintf(stderr, "Wrote '%s' in %.2f s (%.2f Mpixels/s)\n", opts.output.c_str(), elapsed, (elapsed > 0.0 ? 1.0e-6 * pixels / elapsed : 0.0));
+   }
+   else
+   {
+      fprintf(stderr, "Failed writing '%s'\n", opts.output.c_str());
+   }
+   
+   delete writer;
+   delete source;
+   
+   return (ok ? 0 : 1);
+}